@@ -3,6 +3,7 @@
 #include <core/common.h>
 #include <core/kpi/Node2.hpp>
 #include <librii/gfx/PixelOcclusion.hpp>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -32,6 +33,13 @@ struct Texture : public virtual kpi::IObject {
   }
   virtual u32 getEncodedSize(bool mip) const = 0;
   virtual void decode(std::vector<u8>& out, bool mip) const = 0;
+  //! @brief Decoded data, which may be shared with other users of an identical
+  //! image instead of decoded again.
+  virtual std::shared_ptr<const std::vector<u8>> decodeShared(bool mip) const {
+    auto out = std::make_shared<std::vector<u8>>();
+    decode(*out, mip);
+    return out;
+  }
 
   virtual u32 getImageCount() const = 0;
   virtual void setImageCount(u32 c) = 0;
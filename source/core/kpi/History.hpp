@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Memento.hpp"
+#include <cstddef>
 #include <memory>
 #include <vector>
 
@@ -8,13 +9,28 @@ namespace kpi {
 
 class History {
 public:
+  //! Record the document, comparing every object against the last record
   void commit(const IMementoOriginator& doc) {
-    if (history_cursor >= 0)
+    markTreeDirty(doc);
+    commitTracked(doc);
+  }
+  //! Record the document, trusting that only objects flagged with
+  //! IObject::markDirty() changed since the last commit or rollback. Everything
+  //! else shares its record with the last memento without being compared.
+  void commitTracked(const IMementoOriginator& doc) {
+    if (history_cursor >= 0) {
       root_history.erase(root_history.begin() + history_cursor + 1,
                          root_history.end());
+      superseded_bytes.erase(superseded_bytes.begin() + history_cursor + 1,
+                             superseded_bytes.end());
+    }
+    SupersededBytes superseded;
     root_history.push_back(setNext(
-        doc, root_history.empty() ? nullptr : root_history.back().get()));
+        doc, root_history.empty() ? nullptr : root_history.back().get(),
+        &superseded));
+    superseded_bytes.push_back(superseded);
     ++history_cursor;
+    evict();
   }
   void undo(IMementoOriginator& doc) {
     if (history_cursor <= 0)
@@ -31,11 +47,47 @@ public:
   std::size_t cursor() const { return history_cursor; }
   std::size_t size() const { return root_history.size(); }
 
+  //! Memory held by past (and redo) states, beyond that of the current one.
+  //! Falls as old records are compressed in the background.
+  std::size_t memoryUsage() const {
+    std::size_t total = 0;
+    for (std::size_t i = 1; i < superseded_bytes.size(); ++i)
+      total += *superseded_bytes[i];
+    return total;
+  }
+  std::size_t memoryBudget() const { return memory_budget; }
+  //! Forget the oldest states until memoryUsage() fits. The current state is
+  //! always kept.
+  void setMemoryBudget(std::size_t bytes) {
+    memory_budget = bytes;
+    evict();
+  }
+
 private:
   // At the roots, we don't need persistence
   // We don't ever expose history to anyone -- only the current document
   std::vector<std::shared_ptr<const IMemento>> root_history;
+  // Bytes of records in the previous state that each state replaced. Those
+  // are freed once every state before it is gone.
+  std::vector<SupersededBytes> superseded_bytes;
   signed history_cursor = -1;
+  std::size_t memory_budget = std::size_t(1) << 30;
+
+  void evict() {
+    if (history_cursor <= 0)
+      return;
+    std::size_t usage = memoryUsage();
+    std::size_t drop = 0;
+    while (drop < static_cast<std::size_t>(history_cursor) &&
+           usage > memory_budget)
+      usage -= *superseded_bytes[++drop];
+    if (drop == 0)
+      return;
+    root_history.erase(root_history.begin(), root_history.begin() + drop);
+    superseded_bytes.erase(superseded_bytes.begin(),
+                           superseded_bytes.begin() + drop);
+    history_cursor -= drop;
+  }
 
   void rollbackTo(IMementoOriginator& doc, unsigned position) {
     rollback(doc, *root_history[position].get());
@@ -4,12 +4,36 @@
 namespace kpi {
 
 std::shared_ptr<const IMemento> setNext(const IMementoOriginator& node,
-                                        const IMemento* record) {
-  return node.next(record);
+                                        const IMemento* record,
+                                        SupersededBytes* superseded) {
+  gSupersededBytes = std::make_shared<std::atomic<std::size_t>>(0);
+  std::shared_ptr<const IMemento> next = node.next(record);
+  if (superseded != nullptr)
+    *superseded = std::move(gSupersededBytes);
+  gSupersededBytes.reset();
+  return next;
 }
 
 void rollback(IMementoOriginator& node, const IMemento& record) {
   node.from(record);
 }
 
+static void markTreeDirty(const INode& node) {
+  node.mDirty = true;
+  for (std::size_t i = 0; i < node.numFolders(); ++i) {
+    const ICollection* folder = node.folderAt(i);
+    for (std::size_t j = 0; j < folder->size(); ++j) {
+      const IObject* obj = folder->atObject(j);
+      obj->mDirty = true;
+      if (const auto* child = dynamic_cast<const INode*>(obj))
+        markTreeDirty(*child);
+    }
+  }
+}
+
+void markTreeDirty(const IMementoOriginator& node) {
+  if (const auto* root = dynamic_cast<const INode*>(&node))
+    markTreeDirty(*root);
+}
+
 } // namespace kpi
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
 #include <map>
 #include <memory>
 #include <set>
@@ -12,10 +14,21 @@ struct IMemento;
 struct INode;
 struct IMementoOriginator;
 
+//! Bytes held by the records one setNext dropped from the last memento. Shared
+//! so that records compacted in the background can lower it when done.
+using SupersededBytes = std::shared_ptr<std::atomic<std::size_t>>;
+
 // Permute a persistent immutable document record, sharing memory where possible
+//
+// `superseded` receives a counter of the memory of records in `record` that
+// were replaced. Records compacted in the background lower it later.
 std::shared_ptr<const IMemento> setNext(const IMementoOriginator& node,
-                                        const IMemento* record);
+                                        const IMemento* record,
+                                        SupersededBytes* superseded = nullptr);
 // Restore a transient document node to a recorded state.
 void rollback(IMementoOriginator& node, const IMemento& record);
+// Flag a node and everything below it as edited, so the next setNext compares
+// every object instead of trusting the dirty flags.
+void markTreeDirty(const IMementoOriginator& node);
 
 } // namespace kpi
@@ -3,9 +3,12 @@
 #pragma once
 
 #include <algorithm>              // std::find_if
+#include <atomic>                 // std::atomic
 #include <core/common.h>          // u32
+#include <core/kpi/Memento.hpp>   // SupersededBytes
 #include <cstddef>                // std::size_t
 #include <llvm/ADT/SmallVector.h> // llvm::SmallVector
+#include <memory>                 // std::shared_ptr
 #include <string_view>            // std::string_view
 #include <type_traits>            // std::is_same_v
 #include <vector>                 // std::vector
@@ -18,14 +21,33 @@ struct INode;
 // INode -- Owner of folders
 // IObject -- Folder item
 struct IObject {
+  IObject() = default;
+  // Copies link to the same place but start out dirty
+  IObject(const IObject& rhs)
+      : collectionOf(rhs.collectionOf), childOf(rhs.childOf) {}
+  IObject& operator=(const IObject& rhs) {
+    collectionOf = rhs.collectionOf;
+    childOf = rhs.childOf;
+    markDirty();
+    return *this;
+  }
   virtual ~IObject() = default;
 
   virtual std::string getName() const { return "TODO"; }
 
+  //! Flag this object, and the nodes above it, as edited since the last commit
+  void markDirty();
+
   // For now, at least, all objects exist in collections
   ICollection* collectionOf = nullptr;
   // The owner of the collection
   INode* childOf = nullptr;
+
+  // History bookkeeping (see History::commitTracked). An object that is not
+  // dirty still matches mRecord, the memento record it was last committed as
+  // or restored from. The record is only ever compared by identity.
+  mutable bool mDirty = true;
+  mutable std::shared_ptr<const void> mRecord;
 };
 
 struct ICollection {
@@ -173,6 +195,24 @@ struct INode : public ITypeFolderManager,
   // virtual std::unique_ptr<INode> clone() const = 0;
 };
 
+inline void IObject::markDirty() {
+  for (IObject* it = this; it != nullptr; it = it->childOf)
+    it->mDirty = true;
+}
+
+//! Flag an object, reached through any of its interfaces, as edited
+//!
+//! @return False if `obj` is not an IObject, so nothing could be flagged.
+template <typename T> bool markDirty(T& obj) {
+  if constexpr (std::is_polymorphic_v<T>) {
+    if (auto* it = dynamic_cast<IObject*>(&obj)) {
+      it->markDirty();
+      return true;
+    }
+  }
+  return false;
+}
+
 template <typename T> class ConstCollectionRange {
 public:
   bool empty() const { return low == nullptr || low->size() == 0; }
@@ -180,6 +220,9 @@ public:
   const T* at(std::size_t i) const {
     return low == nullptr ? nullptr : reinterpret_cast<const T*>(low->at(i));
   }
+  const IObject* objectAt(std::size_t i) const {
+    return low == nullptr ? nullptr : low->atObject(i);
+  }
   ConstCollectionRange() : low(nullptr) {}
   ConstCollectionRange(const ICollection* src) : low(src) {}
   ConstCollectionRange(const ConstCollectionRange& src) : low(src.low) {
@@ -237,6 +280,9 @@ public:
   const T* at(std::size_t i) const {
     return low != nullptr ? reinterpret_cast<T*>(low->at(i)) : nullptr;
   }
+  const IObject* objectAt(std::size_t i) const {
+    return low != nullptr ? low->atObject(i) : nullptr;
+  }
   void resize(std::size_t sz) { low->resize(sz); }
   T& add() {
     assert(low != nullptr);
@@ -399,12 +445,39 @@ template <typename T> using MementoIfy = typename _MementoIfy<T>::_type;
 template <typename T>
 using ConstPersistentVec = std::vector<std::shared_ptr<const MementoIfy<T>>>;
 
+// Records other than node mementos may also provide:
+//   bool operator==(const T&) const -- compare against the live object
+//   void restore(T&) const          -- instead of assigning to the object
+//   void compact(const SupersededBytes&) const
+//                                   -- called once the record is only held by
+//                                      older history, e.g. to compress it. Any
+//                                      memory saved later is subtracted from
+//                                      the counter.
+//   std::size_t memoryUsage() const -- otherwise sizeof is assumed
+
+// Counter for the current setNext
+inline thread_local SupersededBytes gSupersededBytes;
+
+template <typename R> std::size_t recordMemoryUsage(const R& record) {
+  if constexpr (requires { record.memoryUsage(); })
+    return record.memoryUsage();
+  else
+    return sizeof(R);
+}
+
+template <typename R> void supersede(const R& record) {
+  // Counted first, so compaction can only lower the total
+  *gSupersededBytes += recordMemoryUsage(record);
+  if constexpr (requires { record.compact(gSupersededBytes); })
+    record.compact(gSupersededBytes);
+}
+
 template <typename T, typename U> bool should_set(const T* out, const U* in) {
   assert(in);
   if (out == nullptr)
     return true;
 
-  if constexpr (std::is_same_v<std::remove_const<T>, std::remove_const<U>>) {
+  if constexpr (requires { *out == *in; }) {
     if (*out == *in)
       return false;
   }
@@ -422,24 +495,39 @@ std::shared_ptr<R> set_m(const T* last, const U& in) {
 }
 
 // Create a composite memento
+//
+// Records of unchanged objects are shared with the last memento. Objects that
+// are not dirty and still match their record are not compared at all.
 template <typename InT, typename OutT, typename OldT>
 void nextFolder(OutT& out, const InT& in, const OldT* old) {
   using record_t = MementoIfy<typename OutT::value_type::element_type>;
-  if (old != nullptr) {
-    auto& last = *old;
-    out.resize(in.size());
-    for (int i = 0; i < in.size(); ++i) {
-      if (i < last.size() && should_set(last[i].get(), &in[i])) {
-        out[i] = set_m<record_t>(last[i].get(), in[i]);
-      } else {
-        out[i] = std::make_shared<const record_t>(in[i]);
-      }
+  out.resize(in.size());
+  for (std::size_t i = 0; i < in.size(); ++i) {
+    const IObject* obj = in.objectAt(i);
+    const auto* last =
+        old != nullptr && i < old->size() ? (*old)[i].get() : nullptr;
+    if (last != nullptr && obj != nullptr && !obj->mDirty &&
+        obj->mRecord.get() == last) {
+      out[i] = (*old)[i];
+      continue;
     }
-  } else {
-    out.resize(in.size());
-    for (int i = 0; i < in.size(); ++i) {
+    if (last == nullptr) {
       out[i] = std::make_shared<const record_t>(in[i]);
+    } else if (should_set(last, &in[i])) {
+      out[i] = set_m<record_t>(last, in[i]);
+    } else {
+      out[i] = (*old)[i];
+    }
+    if (obj != nullptr) {
+      obj->mRecord = out[i];
+      obj->mDirty = false;
     }
+    if (last != nullptr && out[i].get() != last)
+      supersede(*last);
+  }
+  if (old != nullptr) {
+    for (std::size_t i = in.size(); i < old->size(); ++i)
+      supersede(*(*old)[i]);
   }
 }
 
@@ -456,7 +544,10 @@ public:
 
 template <typename CType, typename MType>
 void set_concrete_element(CType& out, const MType& memento) {
-  out = memento;
+  if constexpr (requires { memento.restore(out); })
+    memento.restore(out);
+  else
+    out = memento;
   if constexpr (has_notify_observers<CType>::value)
     out.notifyObservers();
 }
@@ -469,14 +560,21 @@ void fromFolder(OutT&& out /*rvalue range*/, const InT& in) {
     if (should_set(&out[i], in[i].get())) {
       set_concrete_element(out[i], *in[i].get());
     }
+    if (const IObject* obj = out.objectAt(i)) {
+      obj->mRecord = in[i];
+      obj->mDirty = false;
+    }
   }
   if (in.size() < out.size()) {
     out.resize(in.size());
   } else if (in.size() > out.size()) {
     const auto added = in.size() - out.size();
     out.resize(in.size());
-    for (int i = in.size() - added; i <= in.size(); ++i) {
-      out[i] = *in[i];
+    for (int i = in.size() - added; i < in.size(); ++i) {
+      if constexpr (requires { in[i]->restore(out[i]); })
+        in[i]->restore(out[i]);
+      else
+        out[i] = *in[i];
       // Observers are not notified here.
       // Rationale: New objects likely do not have observers.
     }
@@ -39,13 +39,22 @@ struct IPropertyView {
 
 private:
   bool bCommitPosted = false;
+  // Every edit since the last commit flagged what it changed
+  bool bCommitTracked = true;
 
 public:
-  void postUpdate() { bCommitPosted = true; }
+  void postUpdate(bool tracked = false) {
+    bCommitPosted = true;
+    bCommitTracked = bCommitTracked && tracked;
+  }
   void consumeUpdate(kpi::History& history, kpi::INode& doc) {
     assert(bCommitPosted);
-    history.commit(doc);
+    if (bCommitTracked)
+      history.commitTracked(doc);
+    else
+      history.commit(doc);
     bCommitPosted = false;
+    bCommitTracked = true;
   }
   void handleUpdates(kpi::History& history, kpi::INode& doc) {
     if (bCommitPosted && !ImGui::IsAnyMouseDown())
@@ -71,16 +80,20 @@ public:
     if (before == after)
       return;
 
+    bool tracked = true;
     for (T* it : mAffected) {
       if (!(get(*it) == after)) {
         set(*it, after);
+        tracked = kpi::markDirty(*it) && tracked;
       }
     }
 
     if (ImGui::IsAnyMouseDown()) {
       // Not all property updates come from clicks. But for those that do,
       // postpone a commit until mouse up.
-      mView.postUpdate();
+      mView.postUpdate(tracked);
+    } else if (tracked) {
+      mHistory.commitTracked(mTransientRoot);
     } else {
       commit("Property Update");
     }
@@ -6,19 +6,9 @@
 #include <optional>
 #include <plate/Platform.hpp>
 
+//! Memory-mapped where possible; see oishii::DataProvider::fromFile
 inline std::optional<oishii::DataProvider> OishiiReadFile(std::string path) {
-  std::ifstream file(std::string(path), std::ios::binary | std::ios::ate);
-  if (!file)
-    return std::nullopt;
-
-  std::vector<u8> vec(file.tellg());
-  file.seekg(0, std::ios::beg);
-
-  if (!file.read(reinterpret_cast<char*>(vec.data()), vec.size())) {
-    return std::nullopt;
-  }
-
-  return oishii::DataProvider{std::move(vec), path};
+  return oishii::DataProvider::fromFile(path);
 }
 
 inline oishii::DataProvider OishiiReadFile(std::string display_path,
@@ -28,6 +18,12 @@ inline oishii::DataProvider OishiiReadFile(std::string display_path,
   return oishii::DataProvider{std::move(vec), display_path};
 }
 
+//! Reads `data` in place; it must outlive the provider
+inline oishii::DataProvider OishiiReadView(std::string display_path,
+                                           std::span<const u8> data) {
+  return oishii::DataProvider{data, nullptr, display_path};
+}
+
 inline void OishiiFlushWriter(oishii::Writer& writer, std::string_view path) {
   // On the Web target, this will download a file to the user's browser
   plate::Platform::writeFile({writer.getDataBlockStart(), writer.getBufSize()},
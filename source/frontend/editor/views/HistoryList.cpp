@@ -1,4 +1,5 @@
 #include "HistoryList.hpp"
+#include <algorithm>                      // for std::max
 #include <core/common.h>                  // for u32
 #include <core/util/gui.hpp>              // for ImGui::Button
 #include <vendor/fa5/IconsFontAwesome5.h> // for ICON_FA_SAVE
@@ -54,6 +55,15 @@ void HistoryList::draw_() {
     mHost.redo(mRoot);
   }
 
+  // Undo steps are dropped, oldest first, past this much memory
+  constexpr std::size_t MiB = 1024 * 1024;
+  int budget = static_cast<int>(mHost.memoryBudget() / MiB);
+  ImGui::Text("Undo memory: %.1f MiB"_j,
+              static_cast<double>(mHost.memoryUsage()) / MiB);
+  if (ImGui::InputInt("Undo memory limit (MiB)"_j, &budget, 64, 256)) {
+    mHost.setMemoryBudget(static_cast<std::size_t>(std::max(budget, 0)) * MiB);
+  }
+
   ImGui::BeginChild("Record List"_j);
   for (std::size_t i = 0; i < mHost.size(); ++i) {
     ImGui::Text("(%s) History #%u"_j, i == mHost.cursor() ? "X" : " ",
@@ -15,28 +15,63 @@ std::optional<Archive> ReadArchive(std::span<const u8> buf,
     return std::nullopt;
   }
 
-  std::vector<u8> decoded(expanded);
-  auto err = librii::szs::decode(decoded, buf);
-  if (err) {
+  // Shared by every file in the archive
+  auto decoded = std::make_shared<std::vector<u8>>(expanded);
+  librii::szs::StreamDecoder stream(*decoded, buf);
+
+  // Validate the header and node table before expanding the (much larger) file
+  // data, so that invalid files are rejected early.
+  if (auto err = stream.decodeUntil(32)) {
+    llvm::consumeError(std::move(err));
     DebugReport("Failed to decode SZS\n");
     errcode = "Invalid .szs file";
     return std::nullopt;
   }
 
-  if (decoded.size() < 4 || decoded[0] != 0x55 || decoded[1] != 0xaa ||
-      decoded[2] != 0x38 || decoded[3] != 0x2d) {
+  const u32 nodes_end =
+      librii::U8::GetU8NodeTableEnd(stream.available(), expanded);
+  if (nodes_end == 0) {
     DebugReport("Not a valid archive\n");
     errcode = "Not a U8 archive";
     return std::nullopt;
   }
 
+  if (auto err = stream.decodeUntil(nodes_end)) {
+    llvm::consumeError(std::move(err));
+    DebugReport("Failed to decode SZS\n");
+    errcode = "Invalid .szs file";
+    return std::nullopt;
+  }
+
   librii::U8::U8Archive arc;
-  if (!librii::U8::LoadU8Archive(arc, decoded)) {
+  u32 file_data_offset = 0;
+  if (!librii::U8::LoadU8ArchiveNodes(arc, stream.available(),
+                                      file_data_offset) ||
+      arc.nodes.empty()) {
     DebugReport("Failed to read archive\n");
     errcode = "Invalid U8 archive";
     return std::nullopt;
   }
 
+  for (auto& node : arc.nodes) {
+    if (!node.is_folder &&
+        u64(file_data_offset) + node.file.offset + node.file.size > expanded) {
+      DebugReport("File extends past the end of the archive\n");
+      errcode = "Invalid U8 archive";
+      return std::nullopt;
+    }
+  }
+
+  if (auto err = stream.decodeAll()) {
+    llvm::consumeError(std::move(err));
+    DebugReport("Failed to decode SZS\n");
+    errcode = "Invalid .szs file";
+    return std::nullopt;
+  }
+
+  const auto file_data =
+      std::span<const u8>(*decoded).subspan(file_data_offset);
+
   Archive n_arc;
 
   struct Pair {
@@ -45,8 +80,6 @@ std::optional<Archive> ReadArchive(std::span<const u8> buf,
   };
   std::vector<Pair> n_path;
 
-  assert(arc.nodes.size());
-
   n_path.push_back(
       Pair{.folder = &n_arc, .sibling_next = arc.nodes[0].folder.sibling_next});
   for (int i = 1; i < arc.nodes.size(); ++i) {
@@ -62,12 +95,10 @@ std::optional<Archive> ReadArchive(std::span<const u8> buf,
       auto& parent = n_path[n_path.size() - 2];
       parent.folder->folders.emplace(node.name, std::move(tmp));
     } else {
-      const u32 start_pos = node.file.offset;
-      const u32 end_pos = node.file.offset + node.file.size;
-      assert(node.file.offset + node.file.size <= arc.file_data.size());
-      std::vector<u8> vec(arc.file_data.data() + start_pos,
-                          arc.file_data.data() + end_pos);
-      n_path.back().folder->files.emplace(node.name, std::move(vec));
+      n_path.back().folder->files.emplace(
+          node.name,
+          ArchiveFile(decoded,
+                      file_data.subspan(node.file.offset, node.file.size)));
     }
 
     while (!n_path.empty() && i + 1 == n_path.back().sibling_next)
@@ -110,7 +141,8 @@ static void ProcessArcs(const Archive* arc, std::string_view name,
           u8.file_data.size(); // Note: relative->abs translation handled later
       node.file.size = f.size();
       u8.nodes.push_back(node);
-      u8.file_data.insert(u8.file_data.end(), f.begin(), f.end());
+      u8.file_data.insert(u8.file_data.end(), f.view().begin(),
+                          f.view().end());
     }
   }
 
@@ -124,12 +156,13 @@ std::vector<u8> WriteArchive(const Archive& arc) {
   ProcessArcs(&arc, ".", u8);
 
   auto u8_buf = librii::U8::SaveU8Archive(u8);
-  auto szs_buf = librii::szs::encodeFast(u8_buf);
+  auto szs_buf = librii::szs::encodeParallel(u8_buf, librii::szs::Algo::Lazy);
 
   return szs_buf;
 }
 
-std::optional<std::vector<u8>> FindFile(const Archive& arc, std::string path) {
+std::optional<std::span<const u8>> FindFile(const Archive& arc,
+                                            std::string path) {
   std::filesystem::path _path = path;
   _path = _path.lexically_normal();
 
@@ -147,7 +180,7 @@ std::optional<std::vector<u8>> FindFile(const Archive& arc, std::string path) {
       if (it != cur_arc->files.end()) {
         // TODO: This will ignore everything else in the path and accept invalid
         // item e.g. source/file.txt/invalid/other would ignore invalid/other
-        return it->second;
+        return it->second.view();
       }
     }
   }
@@ -160,7 +193,7 @@ FindFileWithOverloads(const Archive& arc, std::vector<std::string> paths) {
   for (auto& path : paths) {
     auto found = FindFile(arc, path);
     if (found.has_value()) {
-      return ResolveQuery{.file_data = std::move(*found),
+      return ResolveQuery{.file_data = *found,
                           .resolved_path = path};
     }
   }
@@ -8,9 +8,32 @@
 #include <string>
 #include <vector>
 
+//! Contents of a file in an Archive.
+//!
+//! Files read by ReadArchive are views into the archive's single decoded
+//! buffer, which they keep alive. Contents are immutable: to change a file,
+//! assign it a new ArchiveFile, which does not affect files sharing the old
+//! storage.
+class ArchiveFile {
+public:
+  ArchiveFile() = default;
+  ArchiveFile(std::vector<u8> data)
+      : mStorage(std::make_shared<std::vector<u8>>(std::move(data))),
+        mView(*mStorage) {}
+  ArchiveFile(std::shared_ptr<std::vector<u8>> blob, std::span<const u8> view)
+      : mStorage(std::move(blob)), mView(view) {}
+
+  std::span<const u8> view() const { return mView; }
+  std::size_t size() const { return mView.size(); }
+
+private:
+  std::shared_ptr<std::vector<u8>> mStorage;
+  std::span<const u8> mView;
+};
+
 struct Archive {
   std::map<std::string, std::shared_ptr<Archive>> folders;
-  std::map<std::string, std::vector<u8>> files;
+  std::map<std::string, ArchiveFile> files;
 };
 
 //! Read a .szs/.carc file to a generic Archive
@@ -24,10 +47,13 @@ FindFile(arc, "pictures/dogs/1.png");
 
 return arc.folders.find("pictures")?.folders.find("dogs")?.files.find("1.png");
 */
-std::optional<std::vector<u8>> FindFile(const Archive& arc, std::string path);
+//!
+//! The returned view is valid for as long as the file is not modified.
+std::optional<std::span<const u8>> FindFile(const Archive& arc,
+                                            std::string path);
 
 struct ResolveQuery {
-  std::vector<u8> file_data;
+  std::span<const u8> file_data;
   std::string resolved_path;
 };
 
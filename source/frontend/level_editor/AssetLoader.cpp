@@ -0,0 +1,72 @@
+#include "AssetLoader.hpp"
+
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <rsl/ParallelFor.hpp>
+
+namespace riistudio::lvl {
+
+AssetLoader::~AssetLoader() {
+  // Jobs capture state owned by the caller; none may outlive the loader
+  for (auto& job : mJobs)
+    job.work.wait();
+}
+
+void AssetLoader::add(std::string name, std::function<void()> work,
+                      std::function<void()> finish) {
+  // The pool's jobs must be copyable and must not throw: the task is shared,
+  // and stores anything `work` throws in the future
+  auto task = std::make_shared<std::packaged_task<void()>>(std::move(work));
+  mJobs.push_back({.name = std::move(name),
+                   .work = task->get_future(),
+                   .finish = std::move(finish)});
+  ++mTotal;
+  rsl::SubmitSharedJob([task] { (*task)(); });
+}
+
+void AssetLoader::poll(std::string& errc) {
+  for (size_t i = 0; i < mJobs.size();) {
+    if (mJobs[i].work.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready) {
+      ++i;
+      continue;
+    }
+    // Removed first, so a job that failed is not polled again
+    Job job = std::move(mJobs[i]);
+    mJobs.erase(mJobs.begin() + i);
+    ++mDone;
+    try {
+      // Rethrows anything thrown by `work`
+      job.work.get();
+    } catch (const std::exception& e) {
+      errc = job.name + ": " + e.what();
+      continue;
+    } catch (...) {
+      errc = job.name + ": Unknown error";
+      continue;
+    }
+    if (job.finish)
+      job.finish();
+  }
+  if (mJobs.empty())
+    mDone = mTotal = 0;
+}
+
+void AssetLoader::finishAll(std::string& errc) {
+  for (auto& job : mJobs)
+    job.work.wait();
+  poll(errc);
+}
+
+std::string AssetLoader::pendingNames() const {
+  std::string result;
+  for (const auto& job : mJobs) {
+    if (!result.empty())
+      result += ", ";
+    result += job.name;
+  }
+  return result;
+}
+
+} // namespace riistudio::lvl
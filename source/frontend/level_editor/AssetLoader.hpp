@@ -0,0 +1,52 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+namespace riistudio::lvl {
+
+//! Loads independent assets concurrently.
+//!
+//! Each job's `work` runs on the shared thread pool (rsl::SubmitSharedJob)
+//! and must not touch UI or GL state; its `finish` step is run on the main
+//! thread by poll() once `work` is done. A job whose `work` throws is dropped
+//! without running `finish`. Destroying the loader waits for outstanding work.
+class AssetLoader {
+public:
+  AssetLoader() = default;
+  AssetLoader(const AssetLoader&) = delete;
+  AssetLoader& operator=(const AssetLoader&) = delete;
+  ~AssetLoader();
+
+  void add(std::string name, std::function<void()> work,
+           std::function<void()> finish);
+
+  //! Finish every job whose work is done, in any order
+  //!
+  //! @param errc Set to the name and error of a job whose work threw
+  void poll(std::string& errc);
+  //! Block until every job has finished
+  void finishAll(std::string& errc);
+
+  bool busy() const { return !mJobs.empty(); }
+  //! Fraction of jobs finished since the loader was last idle
+  float progress() const {
+    return mTotal == 0 ? 1.0f : static_cast<float>(mDone) / mTotal;
+  }
+  //! Names of the jobs still pending, for display
+  std::string pendingNames() const;
+
+private:
+  struct Job {
+    std::string name;
+    std::future<void> work;
+    std::function<void()> finish;
+  };
+  std::vector<Job> mJobs;
+  std::size_t mDone = 0;
+  std::size_t mTotal = 0;
+};
+
+} // namespace riistudio::lvl
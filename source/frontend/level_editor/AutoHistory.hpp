@@ -1,6 +1,10 @@
 #pragma once
 
 #include <core/common.h>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace riistudio::lvl {
@@ -25,8 +29,96 @@ inline void RedoHistory(size_t& cursor, std::vector<T>& chain) {
   ++cursor;
 }
 
+//! Specialize with `static constexpr std::tuple sections{&T::a, &T::b, ...}`,
+//! listing members of T that history stores (and shares) separately. Every
+//! part of T must be covered.
+template <typename T> struct HistorySections;
+
+namespace detail {
+
+template <typename M> struct MemberType;
+template <typename C, typename V> struct MemberType<V C::*> {
+  using type = V;
+};
+
+template <typename Tuple> struct SnapshotOf;
+template <typename... Ms> struct SnapshotOf<std::tuple<Ms...>> {
+  using type =
+      std::tuple<std::shared_ptr<const typename MemberType<Ms>::type>...>;
+};
+
+} // namespace detail
+
+//! @brief A copy of T whose sections are shared with other snapshots.
+//!
+//! Committing only copies the sections that differ from the previous
+//! snapshot; the rest are shared by pointer.
+template <typename T> class SectionedSnapshot {
+  static constexpr auto& Sections = HistorySections<T>::sections;
+  static constexpr std::size_t NumSections =
+      std::tuple_size_v<std::remove_cvref_t<decltype(Sections)>>;
+  using Storage = typename detail::SnapshotOf<
+      std::remove_cvref_t<decltype(Sections)>>::type;
+
+public:
+  //! Snapshot `live`, sharing unchanged sections with `prev`
+  static SectionedSnapshot capture(const T& live,
+                                   const SectionedSnapshot* prev = nullptr) {
+    SectionedSnapshot result;
+    forEachSection([&]<std::size_t I>() {
+      const auto& section = live.*std::get<I>(Sections);
+      using Section = std::remove_cvref_t<decltype(section)>;
+      if (prev != nullptr && *std::get<I>(prev->mStorage) == section) {
+        std::get<I>(result.mStorage) = std::get<I>(prev->mStorage);
+      } else {
+        std::get<I>(result.mStorage) = std::make_shared<const Section>(section);
+      }
+    });
+    return result;
+  }
+
+  //! Copy back into `live`, skipping sections that already match
+  void restore(T& live) const {
+    forEachSection([&]<std::size_t I>() {
+      auto& section = live.*std::get<I>(Sections);
+      if (!(section == *std::get<I>(mStorage)))
+        section = *std::get<I>(mStorage);
+    });
+  }
+
+  //! Stops at the first section that differs
+  bool matches(const T& live) const {
+    bool result = true;
+    forEachSection([&]<std::size_t I>() {
+      result = result && live.*std::get<I>(Sections) == *std::get<I>(mStorage);
+    });
+    return result;
+  }
+
+  //! Sections not shared with `other`
+  std::size_t numUnshared(const SectionedSnapshot& other) const {
+    std::size_t result = 0;
+    forEachSection([&]<std::size_t I>() {
+      result += std::get<I>(mStorage) != std::get<I>(other.mStorage);
+    });
+    return result;
+  }
+
+private:
+  template <typename F> static void forEachSection(F&& f) {
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      (f.template operator()<I>(), ...);
+    }
+    (std::make_index_sequence<NumSections>{});
+  }
+
+  Storage mStorage;
+};
+
 template <typename T> struct AutoHistory {
-  std::vector<T> mKmpHistory;
+  using Snapshot = SectionedSnapshot<T>;
+
+  std::vector<Snapshot> mKmpHistory;
   size_t history_cursor = 0;
   bool commit_posted = false;
 
@@ -47,7 +139,7 @@ template <typename T> struct AutoHistory {
     }
 
     // Revert it
-    kmp = mKmpHistory.back();
+    mKmpHistory.back().restore(kmp);
 
     DebugReport("Restored KMP to backup state\n");
 
@@ -59,23 +151,25 @@ template <typename T> struct AutoHistory {
   void update(T& kmp) {
     if (mKmpHistory.empty()) {
       assert(kmp == kmp && "Initial state is invalid");
-      mKmpHistory.push_back(kmp);
+      mKmpHistory.push_back(Snapshot::capture(kmp));
       return;
-	}
+    }
 
     if (restoreInvalidState(kmp) != RestoreStatus::AlreadyValid)
       return;
 
     assert(kmp == kmp && "Kmp is in an invalid state");
 
-    if (!commit_posted && kmp != mKmpHistory[history_cursor]) {
+    if (!commit_posted && !mKmpHistory[history_cursor].matches(kmp)) {
       commit_posted = true;
     }
 
     if (commit_posted && !ImGui::IsAnyMouseDown()) {
       CommitHistory(history_cursor, mKmpHistory);
-      mKmpHistory.push_back(kmp);
-      assert(mKmpHistory.back() == kmp);
+      // Only the sections that changed are copied
+      mKmpHistory.push_back(
+          Snapshot::capture(kmp, &mKmpHistory[history_cursor - 1]));
+      assert(mKmpHistory.back().matches(kmp));
       commit_posted = false;
     }
 
@@ -83,10 +177,10 @@ template <typename T> struct AutoHistory {
     if (ImGui::GetIO().KeyCtrl) {
       if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Z))) {
         UndoHistory(history_cursor, mKmpHistory);
-        kmp = mKmpHistory[history_cursor];
+        mKmpHistory[history_cursor].restore(kmp);
       } else if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Y))) {
         RedoHistory(history_cursor, mKmpHistory);
-        kmp = mKmpHistory[history_cursor];
+        mKmpHistory[history_cursor].restore(kmp);
       }
     }
   }
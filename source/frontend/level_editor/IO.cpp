@@ -3,6 +3,7 @@
 #include <core/common.h>
 #include <core/kpi/Plugins.hpp> // kpi::LightIOTransaction
 #include <core/util/oishii.hpp>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -16,13 +17,13 @@
 
 namespace riistudio::lvl {
 
+//! Reads a file of an Archive in place, without copying it
 struct Reader {
   oishii::DataProvider mData;
   oishii::BinaryReader mReader;
 
-  Reader(std::string path, const std::vector<u8>& data)
-      : mData(OishiiReadFile(path, data.data(), data.size())),
-        mReader(mData.slice()) {}
+  Reader(std::string path, std::span<const u8> data)
+      : mData(OishiiReadView(path, data)), mReader(mData.slice()) {}
 };
 
 struct SimpleTransaction {
@@ -37,9 +38,14 @@ struct SimpleTransaction {
   kpi::LightIOTransaction trans;
 };
 
-std::unique_ptr<g3d::Collection> ReadBRRES(const std::vector<u8>& buf,
+std::unique_ptr<g3d::Collection> ReadBRRES(std::span<const u8> buf,
                                            std::string path,
                                            NeedResave need_resave) {
+  // The g3d reader goes through the kpi plugin singletons and oishii's
+  // console state, so level assets loaded together parse one BRRES at a time
+  static std::mutex sReadMutex;
+  std::scoped_lock lock(sReadMutex);
+
   auto result = std::make_unique<g3d::Collection>();
 
   SimpleTransaction trans;
@@ -57,7 +63,7 @@ std::unique_ptr<g3d::Collection> ReadBRRES(const std::vector<u8>& buf,
   return result;
 }
 
-std::unique_ptr<librii::kmp::CourseMap> ReadKMP(const std::vector<u8>& buf,
+std::unique_ptr<librii::kmp::CourseMap> ReadKMP(std::span<const u8> buf,
                                                 std::string path) {
   auto result = std::make_unique<librii::kmp::CourseMap>();
 
@@ -76,7 +82,7 @@ std::vector<u8> WriteKMP(const librii::kmp::CourseMap& map) {
 }
 
 std::unique_ptr<librii::kcol::KCollisionData>
-ReadKCL(const std::vector<u8>& buf, std::string path) {
+ReadKCL(std::span<const u8> buf, std::string path) {
   auto result = std::make_unique<librii::kcol::KCollisionData>();
 
   Reader reader(path, buf);
@@ -3,21 +3,24 @@
 #include <plugins/g3d/collection.hpp>
 #include <librii/kcol/Model.hpp>
 #include <librii/kmp/CourseMap.hpp>
+#include <span>
 
 namespace riistudio::lvl {
 
 enum class NeedResave { Default, AllowUnwritable };
 
+//! Safe to call from any thread. Calls are serialized: the g3d reader is not
+//! known to be reentrant.
 std::unique_ptr<g3d::Collection>
-ReadBRRES(const std::vector<u8>& buf, std::string path,
+ReadBRRES(std::span<const u8> buf, std::string path,
           NeedResave need_resave = NeedResave::AllowUnwritable);
 
-std::unique_ptr<librii::kmp::CourseMap> ReadKMP(const std::vector<u8>& buf,
+std::unique_ptr<librii::kmp::CourseMap> ReadKMP(std::span<const u8> buf,
                                                 std::string path);
 
 std::vector<u8> WriteKMP(const librii::kmp::CourseMap& map);
 
 std::unique_ptr<librii::kcol::KCollisionData>
-ReadKCL(const std::vector<u8>& buf, std::string path);
+ReadKCL(std::span<const u8> buf, std::string path);
 
 } // namespace riistudio::lvl
@@ -104,6 +104,51 @@ void DrawRenderOptions(RenderOptions& opt) {
   opt.xlu_mode = imcxx::Combo("Translucency", opt.xlu_mode, "Fast\0Fancy\0");
   ImGui::SliderFloat("Collision Alpha", &opt.kcl_alpha, 0.0f, 1.0f);
 }
+// Triangles of every mesh, in bind pose
+static std::vector<std::array<glm::vec3, 3>>
+GatherModelTriangles(const g3d::Collection& collection) {
+  using librii::gx::PrimitiveType;
+  using librii::gx::VertexAttribute;
+
+  std::vector<std::array<glm::vec3, 3>> tris;
+  for (const auto& mdl : collection.getModels()) {
+    for (const auto& mesh : mdl.getMeshes()) {
+      for (const auto& mp : mesh.getMeshData().mMatrixPrimitives) {
+        for (const auto& prim : mp.mPrimitives) {
+          const auto& v = prim.mVertices;
+          const auto pos = [&](size_t i) {
+            return mesh.getPos(mdl, v[i][VertexAttribute::Position]);
+          };
+          switch (prim.mType) {
+          case PrimitiveType::Triangles:
+            for (size_t i = 0; i + 2 < v.size(); i += 3)
+              tris.push_back({pos(i), pos(i + 1), pos(i + 2)});
+            break;
+          case PrimitiveType::TriangleStrip:
+            for (size_t i = 0; i + 2 < v.size(); ++i)
+              tris.push_back({pos(i), pos(i + 1), pos(i + 2)});
+            break;
+          case PrimitiveType::TriangleFan:
+            for (size_t i = 1; i + 1 < v.size(); ++i)
+              tris.push_back({pos(0), pos(i), pos(i + 1)});
+            break;
+          case PrimitiveType::Quads:
+          case PrimitiveType::Quads2:
+            for (size_t i = 0; i + 3 < v.size(); i += 4) {
+              tris.push_back({pos(i), pos(i + 1), pos(i + 2)});
+              tris.push_back({pos(i), pos(i + 2), pos(i + 3)});
+            }
+            break;
+          default:
+            break;
+          }
+        }
+      }
+    }
+  }
+  return tris;
+}
+
 void LevelEditorWindow::openFile(std::span<const u8> buf, std::string path) {
   // Read .szs
   {
@@ -120,69 +165,116 @@ void LevelEditorWindow::openFile(std::span<const u8> buf, std::string path) {
 
   setName("Level Editor: " + path);
 
+  // Sub-files are parsed concurrently. Their data are views into
+  // mLevel.root_archive, which outlives mLoader.
+
   // Read course_model.brres
-  {
-    auto course_model_brres = FindFileWithOverloads(
-        mLevel.root_archive, {"course_d_model.brres", "course_model.brres"});
-    if (course_model_brres.has_value()) {
-      mCourseModel = ReadBRRES(course_model_brres->file_data,
-                               course_model_brres->resolved_path);
-    }
+  mModelPicker.clear();
+  if (auto course_model_brres = FindFileWithOverloads(
+          mLevel.root_archive, {"course_d_model.brres", "course_model.brres"});
+      course_model_brres.has_value()) {
+    struct Loaded {
+      std::unique_ptr<g3d::Collection> model;
+      TrianglePicker picker;
+    };
+    auto loaded = std::make_shared<Loaded>();
+    mLoader.add(
+        course_model_brres->resolved_path,
+        [loaded, file = *course_model_brres] {
+          loaded->model = ReadBRRES(file.file_data, file.resolved_path);
+          if (loaded->model)
+            loaded->picker.build(GatherModelTriangles(*loaded->model));
+        },
+        [this, loaded] {
+          mCourseModel = std::move(loaded->model);
+          mModelPicker = std::move(loaded->picker);
+        });
   }
 
   // Read vrcorn_model.brres
-  {
-    auto vrcorn_model_brres = FindFileWithOverloads(
-        mLevel.root_archive, {"vrcorn_d_model.brres", "vrcorn_model.brres"});
-    if (vrcorn_model_brres.has_value()) {
-      mVrcornModel = ReadBRRES(vrcorn_model_brres->file_data,
-                               vrcorn_model_brres->resolved_path);
-    }
+  if (auto vrcorn_model_brres = FindFileWithOverloads(
+          mLevel.root_archive, {"vrcorn_d_model.brres", "vrcorn_model.brres"});
+      vrcorn_model_brres.has_value()) {
+    auto loaded = std::make_shared<std::unique_ptr<g3d::Collection>>();
+    mLoader.add(
+        vrcorn_model_brres->resolved_path,
+        [loaded, file = *vrcorn_model_brres] {
+          *loaded = ReadBRRES(file.file_data, file.resolved_path);
+        },
+        [this, loaded] { mVrcornModel = std::move(*loaded); });
   }
 
   // Read map_model.brres
-  {
-    auto map_model =
-        FindFileWithOverloads(mLevel.root_archive, {"map_model.brres"});
-    if (map_model.has_value()) {
-      mMapModel = ReadBRRES(map_model->file_data, map_model->resolved_path);
-    }
+  if (auto map_model =
+          FindFileWithOverloads(mLevel.root_archive, {"map_model.brres"});
+      map_model.has_value()) {
+    auto loaded = std::make_shared<std::unique_ptr<g3d::Collection>>();
+    mLoader.add(
+        map_model->resolved_path,
+        [loaded, file = *map_model] {
+          *loaded = ReadBRRES(file.file_data, file.resolved_path);
+        },
+        [this, loaded] { mMapModel = std::move(*loaded); });
   }
 
   // Read course.kcl
-  {
-    auto course_kcl =
-        FindFileWithOverloads(mLevel.root_archive, {"course.kcl"});
-    if (course_kcl.has_value()) {
-      mCourseKcl = ReadKCL(course_kcl->file_data, course_kcl->resolved_path);
-    }
-  }
-
-  // Init course.kcl
-  if (mCourseKcl) {
-    mTriangleRenderer.init(*mCourseKcl);
-    disp_opts.init(*mCourseKcl);
+  mKclPicker.clear();
+  if (auto course_kcl =
+          FindFileWithOverloads(mLevel.root_archive, {"course.kcl"});
+      course_kcl.has_value()) {
+    struct Loaded {
+      std::unique_ptr<librii::kcol::KCollisionData> kcl;
+      std::vector<Triangle> tris;
+      TrianglePicker picker;
+    };
+    auto loaded = std::make_shared<Loaded>();
+    mLoader.add(
+        course_kcl->resolved_path,
+        [loaded, file = *course_kcl] {
+          loaded->kcl = ReadKCL(file.file_data, file.resolved_path);
+          if (!loaded->kcl)
+            return;
+          loaded->tris = ToTriangles(*loaded->kcl);
+          std::vector<std::array<glm::vec3, 3>> verts;
+          verts.reserve(loaded->tris.size());
+          for (const auto& tri : loaded->tris)
+            verts.push_back(tri.verts);
+          loaded->picker.build(std::move(verts));
+        },
+        [this, loaded] {
+          mCourseKcl = std::move(loaded->kcl);
+          if (!mCourseKcl)
+            return;
+          // Uploads to the GPU
+          mTriangleRenderer.init(std::move(loaded->tris));
+          disp_opts.init(*mCourseKcl);
+          mKclPicker = std::move(loaded->picker);
+        });
   }
 
   // Read course.kmp
-  {
-    auto course_kmp =
-        FindFileWithOverloads(mLevel.root_archive, {"course.kmp"});
-    if (course_kmp.has_value()) {
-      mKmp = ReadKMP(course_kmp->file_data, course_kmp->resolved_path);
-    }
-  }
-
-  // Init course.kmp
-  if (mKmp) {
-    mKmpHistory.init(*mKmp);
-
-    // Place the camera near the starting point, if it exists
-    auto& cam = mRenderSettings.mCameraController.mCamera;
-    if (!mKmp->mStartPoints.empty()) {
-      auto& start = mKmp->mStartPoints[0];
-      cam.mEye = start.position + glm::vec3(0.0f, 10'000.0f, 0.0f);
-    }
+  if (auto course_kmp =
+          FindFileWithOverloads(mLevel.root_archive, {"course.kmp"});
+      course_kmp.has_value()) {
+    auto loaded = std::make_shared<std::unique_ptr<librii::kmp::CourseMap>>();
+    mLoader.add(
+        course_kmp->resolved_path,
+        [loaded, file = *course_kmp] {
+          *loaded = ReadKMP(file.file_data, file.resolved_path);
+        },
+        [this, loaded] {
+          mKmp = std::move(*loaded);
+          if (!mKmp)
+            return;
+          mKmpHistory.init(*mKmp);
+
+          // Place the camera near the starting point, if it exists
+          auto& cam = mRenderSettings.mCameraController.mCamera;
+          if (!mKmp->mStartPoints.empty()) {
+            auto& start = mKmp->mStartPoints[0];
+            cam.mEye = start.position + glm::vec3(0.0f, 10'000.0f, 0.0f);
+          }
+        });
   }
 
   // Default camera values
@@ -215,9 +307,10 @@ GatherNodes(Archive& arc) {
       ImGui::TreePop();
     }
   }
-  for (auto& f : arc.files) {
-    if (ImGui::Selectable(f.first.c_str())) {
-      clicked = f;
+  for (auto& [name, file] : arc.files) {
+    if (ImGui::Selectable(name.c_str())) {
+      const auto data = file.view();
+      clicked.emplace(name, std::vector<u8>(data.begin(), data.end()));
     }
   }
 
@@ -1530,6 +1623,8 @@ void LevelEditorWindow::draw_() {
     return;
   }
 
+  mLoader.poll(mErrDisp);
+
   if (ImGui::BeginMenuBar()) {
     if (ImGui::Button("Save")) {
       saveFile("umm.szs");
@@ -1898,6 +1993,34 @@ void LevelEditorWindow::draw_() {
   ImGui::End();
 }
 
+void LevelEditorWindow::pickAt(const PickRay& ray, void* object_vector) {
+  // Objects win over the geometry they sit in
+  if (auto obj = mObjectPicker.pick(ray); obj && object_vector != nullptr) {
+    selection.clear();
+    select(object_vector, obj->index);
+    mPickStatus = "Picked object #" + std::to_string(obj->index);
+    return;
+  }
+
+  std::optional<PickHit> kcl;
+  if (disp_opts.show_kcl)
+    kcl = mKclPicker.pick(ray);
+  std::optional<PickHit> mdl;
+  if (disp_opts.show_brres)
+    mdl = mModelPicker.pick(ray);
+
+  if (kcl && (!mdl || kcl->distance <= mdl->distance)) {
+    const u16 attr = mTriangleRenderer.getTriangles()[kcl->index].attr;
+    mPickStatus = "Picked KCL triangle #" + std::to_string(kcl->index) +
+                  ": " + GetKCLType(attr).name + " (attribute " +
+                  std::to_string(attr) + ")";
+  } else if (mdl) {
+    mPickStatus = "Picked course model triangle #" + std::to_string(mdl->index);
+  } else {
+    mPickStatus.clear();
+  }
+}
+
 ImGuiID LevelEditorWindow::buildDock(ImGuiID root_id) {
   ImGuiID next = root_id;
   ImGuiID dock_right_id =
@@ -2059,6 +2182,11 @@ void LevelEditorWindow::drawScene(u32 width, u32 height) {
   DrawRenderOptions(disp_opts);
   auto report = MakeVersionReport(mCourseKcl.get());
   ImGui::Text("KCL: %s", report.course_kcl_version.c_str());
+  if (mLoader.busy()) {
+    const auto pending = "Loading " + mLoader.pendingNames();
+    ImGui::ProgressBar(mLoader.progress(), ImVec2(-1.0f, 0.0f),
+                       pending.c_str());
+  }
   //   ImGui::EndMenuBar();
   // }
 
@@ -2097,13 +2225,19 @@ void LevelEditorWindow::drawScene(u32 width, u32 height) {
     }
   }
 
+  // Cubes on the current page, for picking
+  std::vector<glm::mat4> pick_mtxs;
+  void* pick_owner = nullptr;
+
   if (mKmp != nullptr) {
     int i = 0;
     switch (mPage) {
     case Page::StartPoints:
+      pick_owner = &mKmp->mStartPoints;
       for (auto& pt : mKmp->mStartPoints) {
         glm::mat4 modelMtx = MatrixOfPoint(pt.position, pt.rotation, 1);
         PushCube(mSceneState, modelMtx, viewMtx, projMtx);
+        pick_mtxs.push_back(modelMtx);
 
         SelectedPath path{.vector_addr = &mKmp->mStartPoints,
                           .index = (size_t)i++};
@@ -2126,28 +2260,36 @@ void LevelEditorWindow::drawScene(u32 width, u32 height) {
       }
       break;
     case Page::Objects:
+      pick_owner = &mKmp->mGeoObjs;
       for (auto& pt : mKmp->mGeoObjs) {
         glm::mat4 modelMtx = MatrixOfPoint(pt.position, pt.rotation, 1);
         PushCube(mSceneState, modelMtx, viewMtx, projMtx);
+        pick_mtxs.push_back(modelMtx);
       }
       break;
     case Page::Areas:
+      pick_owner = &mKmp->mAreas;
       for (auto& pt : mKmp->mAreas) {
         glm::mat4 modelMtx =
             MatrixOfPoint(pt.getModel().mPosition, pt.getModel().mRotation, 1);
         PushCube(mSceneState, modelMtx, viewMtx, projMtx);
+        pick_mtxs.push_back(modelMtx);
       }
       break;
     case Page::Cameras:
+      pick_owner = &mKmp->mCameras;
       for (auto& pt : mKmp->mCameras) {
         glm::mat4 modelMtx = MatrixOfPoint(pt.mPosition, pt.mRotation, 1);
         PushCube(mSceneState, modelMtx, viewMtx, projMtx);
+        pick_mtxs.push_back(modelMtx);
       }
       break;
     case Page::Respawns:
+      pick_owner = &mKmp->mRespawnPoints;
       for (auto& pt : mKmp->mRespawnPoints) {
         glm::mat4 modelMtx = MatrixOfPoint(pt.position, pt.rotation, pt.range);
         PushCube(mSceneState, modelMtx, viewMtx, projMtx);
+        pick_mtxs.push_back(modelMtx);
 
         SelectedPath path{.vector_addr = &mKmp->mRespawnPoints,
                           .index = (size_t)i++};
@@ -2170,20 +2312,29 @@ void LevelEditorWindow::drawScene(u32 width, u32 height) {
       }
       break;
     case Page::Cannons:
+      pick_owner = &mKmp->mCannonPoints;
       for (auto& pt : mKmp->mCannonPoints) {
         glm::mat4 modelMtx =
             MatrixOfPoint(pt.getPosition(), pt.getRotation(), 1);
         PushCube(mSceneState, modelMtx, viewMtx, projMtx);
+        pick_mtxs.push_back(modelMtx);
       }
       break;
     case Page::MissionPoints:
+      pick_owner = &mKmp->mMissionPoints;
       for (auto& pt : mKmp->mMissionPoints) {
         glm::mat4 modelMtx = MatrixOfPoint(pt.position, pt.rotation, 1);
         PushCube(mSceneState, modelMtx, viewMtx, projMtx);
+        pick_mtxs.push_back(modelMtx);
       }
       break;
     }
   }
+  if (pick_owner != mObjectPickerOwner) {
+    mObjectPicker.clear();
+    mObjectPickerOwner = pick_owner;
+  }
+  mObjectPicker.update(pick_mtxs);
 
   if (disp_opts.show_kcl && mCourseKcl) {
     // Z sort
@@ -2246,6 +2397,29 @@ void LevelEditorWindow::drawScene(u32 width, u32 height) {
         mSelectedObjectTransformEdit.matrix != backup;
   }
 
+  if (!mPickStatus.empty()) {
+    ImGui::Text("%s", mPickStatus.c_str());
+  }
+
+  // The viewport image is drawn right after us, from the cursor onwards
+  const ImVec2 image_min = ImGui::GetCursorScreenPos();
+  const ImVec2 image_size = ImGui::GetContentRegionAvail();
+  const ImVec2 mouse = ImGui::GetMousePos();
+  const bool in_image = mouse.x >= image_min.x && mouse.y >= image_min.y &&
+                        mouse.x < image_min.x + image_size.x &&
+                        mouse.y < image_min.y + image_size.y;
+  if (in_image && ImGui::IsWindowHovered() && !ImGui::IsAnyItemHovered() &&
+      ImGui::IsMouseClicked(ImGuiMouseButton_Left) &&
+      !ImGui::GetIO().KeyAlt && !ImGuizmo::IsOver() && !ImGuizmo::IsUsing()) {
+    // The image shows the bottom-left of a (width x height) framebuffer
+    const glm::vec2 ndc{
+        (mouse.x - image_min.x) / static_cast<float>(width) * 2.0f - 1.0f,
+        (image_size.y - (mouse.y - image_min.y)) / static_cast<float>(height) *
+                2.0f -
+            1.0f};
+    pickAt(RayFromScreen(ndc, projMtx, viewMtx), pick_owner);
+  }
+
   if (mKmp != nullptr) {
     mKmpHistory.update(*mKmp);
   }
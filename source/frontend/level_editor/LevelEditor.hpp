@@ -13,8 +13,10 @@
 #include <string>
 
 #include <frontend/level_editor/Archive.hpp>
+#include <frontend/level_editor/AssetLoader.hpp>
 #include <frontend/level_editor/AutoHistory.hpp>
 #include <frontend/level_editor/DeltaTime.hpp>
+#include <frontend/level_editor/Picking.hpp>
 #include <frontend/level_editor/TriangleRenderer.hpp>
 
 namespace riistudio::lvl {
@@ -44,13 +46,7 @@ struct RenderOptions {
       .value = 0xffff'ffff // All flags in the scene
   };
   // Fancy -> enable per-triangle z-sorting
-  XluMode xlu_mode{
-#ifdef BUILD_DEBUG
-      XluMode::Fast // the std::sort is incredibly slow on debug builds
-#else
-      XluMode::Fancy
-#endif
-  };
+  XluMode xlu_mode = XluMode::Fancy;
 
   float kcl_alpha = 0.5f;
 
@@ -104,6 +100,16 @@ struct Selection {
   }
 };
 
+template <> struct HistorySections<librii::kmp::CourseMap> {
+  using T = librii::kmp::CourseMap;
+  static constexpr std::tuple sections{
+      &T::mRevision,      &T::mOpeningPanIndex, &T::mVideoPanIndex,
+      &T::mStartPoints,   &T::mEnemyPaths,      &T::mItemPaths,
+      &T::mCheckPaths,    &T::mPaths,           &T::mGeoObjs,
+      &T::mAreas,         &T::mCameras,         &T::mRespawnPoints,
+      &T::mCannonPoints,  &T::mStages,          &T::mMissionPoints};
+};
+
 class KmpHistory {
 public:
   void init(librii::kmp::CourseMap& map) { mLedger.update(map); }
@@ -129,6 +135,9 @@ public:
   ImGuiID buildDock(ImGuiID root_id) override;
 
   void drawScene(u32 width, u32 height);
+  // Select whatever is under the cursor. `object_vector` holds the cubes
+  // currently shown.
+  void pickAt(const PickRay& ray, void* object_vector);
 
   void DrawRespawnTable();
   void DrawStartPointTable();
@@ -162,6 +171,17 @@ public:
   std::unique_ptr<librii::kcol::KCollisionData> mCourseKcl;
   TriangleRenderer mTriangleRenderer;
 
+  // Mouse picking
+  TrianglePicker mKclPicker;
+  TrianglePicker mModelPicker;
+  ObjectPicker mObjectPicker;
+  void* mObjectPickerOwner = nullptr;
+  std::string mPickStatus;
+
+  // After mLevel, so outstanding loads finish before the archive they read is
+  // destroyed
+  AssetLoader mLoader;
+
   std::unique_ptr<librii::kmp::CourseMap> mKmp;
   KmpHistory mKmpHistory;
 
@@ -0,0 +1,90 @@
+#include "Picking.hpp"
+
+#include <glm/glm.hpp>
+
+namespace riistudio::lvl {
+
+using librii::math::AABB;
+
+PickRay RayFromScreen(const glm::vec2& ndc, const glm::mat4& projMtx,
+                      const glm::mat4& viewMtx) {
+  const glm::mat4 inv = glm::inverse(projMtx * viewMtx);
+  glm::vec4 near = inv * glm::vec4(ndc, -1.0f, 1.0f);
+  glm::vec4 far = inv * glm::vec4(ndc, 1.0f, 1.0f);
+  near /= near.w;
+  far /= far.w;
+  return {.origin = glm::vec3(near),
+          .direction = glm::normalize(glm::vec3(far - near))};
+}
+
+static AABB TriangleBounds(const std::array<glm::vec3, 3>& tri) {
+  return {.min = glm::min(glm::min(tri[0], tri[1]), tri[2]),
+          .max = glm::max(glm::max(tri[0], tri[1]), tri[2])};
+}
+
+void TrianglePicker::build(std::vector<std::array<glm::vec3, 3>> tris) {
+  mTris = std::move(tris);
+  std::vector<AABB> bounds(mTris.size());
+  for (size_t i = 0; i < mTris.size(); ++i)
+    bounds[i] = TriangleBounds(mTris[i]);
+  mBvh.build(bounds);
+}
+
+std::optional<PickHit> TrianglePicker::pick(const PickRay& ray) const {
+  auto hit = mBvh.rayCast(ray.origin, ray.direction, [&](u32 i, float) {
+    return librii::math::IntersectRayTriangle(ray.origin, ray.direction,
+                                              mTris[i]);
+  });
+  if (!hit)
+    return std::nullopt;
+  return PickHit{.index = hit->first, .distance = hit->second};
+}
+
+static AABB CubeBounds(const glm::mat4& mtx) {
+  // Center plus the absolute extent along each world axis
+  const glm::vec3 center(mtx[3]);
+  const glm::vec3 extent = glm::abs(glm::vec3(mtx[0])) +
+                           glm::abs(glm::vec3(mtx[1])) +
+                           glm::abs(glm::vec3(mtx[2]));
+  return {.min = center - extent, .max = center + extent};
+}
+
+void ObjectPicker::update(std::span<const glm::mat4> modelMtxs) {
+  if (modelMtxs.size() != mModelMtxs.size()) {
+    mModelMtxs.assign(modelMtxs.begin(), modelMtxs.end());
+    mInverseMtxs.resize(mModelMtxs.size());
+    std::vector<AABB> bounds(mModelMtxs.size());
+    for (size_t i = 0; i < mModelMtxs.size(); ++i) {
+      mInverseMtxs[i] = glm::inverse(mModelMtxs[i]);
+      bounds[i] = CubeBounds(mModelMtxs[i]);
+    }
+    mBvh.build(bounds, 1);
+    return;
+  }
+  for (size_t i = 0; i < modelMtxs.size(); ++i) {
+    if (modelMtxs[i] == mModelMtxs[i])
+      continue;
+    mModelMtxs[i] = modelMtxs[i];
+    mInverseMtxs[i] = glm::inverse(mModelMtxs[i]);
+    mBvh.update(static_cast<u32>(i), CubeBounds(mModelMtxs[i]));
+  }
+}
+
+std::optional<PickHit> ObjectPicker::pick(const PickRay& ray) const {
+  static const AABB unit_cube{.min = glm::vec3(-1.0f), .max = glm::vec3(1.0f)};
+
+  auto hit = mBvh.rayCast(
+      ray.origin, ray.direction, [&](u32 i, float t_max) {
+        // Affine, so distances along the local ray match the world ray
+        const glm::mat4& inv = mInverseMtxs[i];
+        const glm::vec3 origin(inv * glm::vec4(ray.origin, 1.0f));
+        const glm::vec3 dir(inv * glm::vec4(ray.direction, 0.0f));
+        return librii::math::IntersectRayAABB(unit_cube, origin, 1.0f / dir,
+                                              t_max);
+      });
+  if (!hit)
+    return std::nullopt;
+  return PickHit{.index = hit->first, .distance = hit->second};
+}
+
+} // namespace riistudio::lvl
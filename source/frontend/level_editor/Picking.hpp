@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <core/common.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <librii/math/bvh.hpp>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace riistudio::lvl {
+
+struct PickRay {
+  glm::vec3 origin;
+  glm::vec3 direction;
+};
+
+//! Ray through a point in normalized device coordinates ([-1, 1], y up),
+//! starting at the near plane.
+PickRay RayFromScreen(const glm::vec2& ndc, const glm::mat4& projMtx,
+                      const glm::mat4& viewMtx);
+
+struct PickHit {
+  u32 index = 0;
+  float distance = 0.0f; //!< In units of the ray direction
+};
+
+//! Picks from a static triangle soup (collision, course model)
+class TrianglePicker {
+public:
+  void build(std::vector<std::array<glm::vec3, 3>> tris);
+  void clear() { build({}); }
+
+  std::optional<PickHit> pick(const PickRay& ray) const;
+
+  std::span<const std::array<glm::vec3, 3>> triangles() const {
+    return mTris;
+  }
+
+private:
+  std::vector<std::array<glm::vec3, 3>> mTris;
+  librii::math::BVH mBvh;
+};
+
+//! Picks from objects drawn as cubes: [-1, 1]^3 transformed by a model matrix
+class ObjectPicker {
+public:
+  //! Only objects whose matrix changed are touched; the tree is rebuilt when
+  //! the number of objects does.
+  void update(std::span<const glm::mat4> modelMtxs);
+  void clear() { update({}); }
+
+  std::optional<PickHit> pick(const PickRay& ray) const;
+
+private:
+  std::vector<glm::mat4> mModelMtxs;
+  std::vector<glm::mat4> mInverseMtxs;
+  librii::math::BVH mBvh;
+};
+
+} // namespace riistudio::lvl
@@ -2,8 +2,12 @@
 
 #include "KclUtil.hpp"
 #include <core/3d/gl.hpp>
-#include <glm/gtx/norm.hpp> // glm::distance2
+#include <algorithm>
+#include <bit>
 #include <librii/gl/Compiler.hpp>
+#include <numeric>
+#include <rsl/ParallelFor.hpp>
+#include <thread>
 
 namespace riistudio::lvl {
 
@@ -149,15 +153,13 @@ void PushTriangles(riistudio::lib3d::SceneState& state, glm::mat4 modelMtx,
       ->Misc0[2] = 1.0f;
 }
 
-void TriangleRenderer::convertToTriangles(
-    const librii::kcol::KCollisionData& mCourseKcl) {
-  mKclTris.resize(mCourseKcl.prism_data.size());
-  for (size_t i = 0; i < mKclTris.size(); ++i) {
-    auto& prism = mCourseKcl.prism_data[i];
-
-    mKclTris[i] = {.attr = prism.attribute,
-                   .verts = librii::kcol::FromPrism(mCourseKcl, prism)};
+std::vector<Triangle> ToTriangles(const librii::kcol::KCollisionData& kcl) {
+  const auto verts = librii::kcol::FromPrisms(kcl);
+  std::vector<Triangle> tris(verts.size());
+  for (size_t i = 0; i < tris.size(); ++i) {
+    tris[i] = {.attr = kcl.prism_data[i].attribute, .verts = verts[i]};
   }
+  return tris;
 }
 
 void TriangleRenderer::buildVertexBuffer() {
@@ -179,77 +181,183 @@ void TriangleRenderer::buildVertexBuffer() {
                                  .format = GL_UNSIGNED_INT,
                                  .size = sizeof(u32)};
 
-  for (int i = 0; i < 3 * mKclTris.size(); ++i) {
-    tri_vbo->mIndices.push_back(static_cast<u32>(tri_vbo->mIndices.size()));
-    tri_vbo->pushData(/*binding_point=*/0, mKclTris[i / 3].verts[i % 3]);
-    tri_vbo->pushData(
-        /*binding_point=*/1,
-        glm::vec4(GetKCLColor(mKclTris[i / 3].attr), 1.0f));
-    tri_vbo->pushData(/*binding_point=*/2,
-                      static_cast<u32>(1 << (mKclTris[i / 3].attr & 31)));
+  // Colors only depend on the low bits of the attribute
+  std::array<glm::vec4, 32> colors;
+  for (u32 i = 0; i < colors.size(); ++i)
+    colors[i] = glm::vec4(GetKCLColor(i), 1.0f);
+
+  const size_t num_verts = 3 * mKclTris.size();
+  auto positions = tri_vbo->resizeData<glm::vec3>(0, num_verts);
+  auto vtx_colors = tri_vbo->resizeData<glm::vec4>(1, num_verts);
+  auto attr_ids = tri_vbo->resizeData<u32>(2, num_verts);
+  tri_vbo->mIndices.resize(num_verts);
+  for (size_t i = 0; i < num_verts; ++i) {
+    const auto& tri = mKclTris[i / 3];
+    tri_vbo->mIndices[i] = static_cast<u32>(i);
+    positions[i] = tri.verts[i % 3];
+    vtx_colors[i] = colors[tri.attr & 31];
+    attr_ids[i] = static_cast<u32>(1 << (tri.attr & 31));
   }
   tri_vbo->build();
 }
 
-void TriangleRenderer::init(const librii::kcol::KCollisionData& mCourseKcl) {
-  convertToTriangles(mCourseKcl);
+void TriangleRenderer::init(std::vector<Triangle> tris) {
+  mKclTris = std::move(tris);
   buildVertexBuffer();
+  mSortOrder.clear();
 }
 
-void TriangleRenderer::sortTriangles(const glm::mat4& viewMtx) {
-  struct index_tri {
-    u32 points[3];
+namespace {
 
-    const glm::vec3& get_point(librii::glhelper::VBOBuilder& tri_vbo,
-                               u32 i) const {
-      return reinterpret_cast<const glm::vec3&>(
-          tri_vbo.mPropogating[0].data[points[i] * sizeof(glm::vec3)]);
-    }
+// Maps floats to integers of the same order, so they can be radix sorted
+u32 DepthKey(float z) {
+  const u32 bits = std::bit_cast<u32>(z);
+  return bits ^ ((bits >> 31) != 0 ? 0xFFFF'FFFF : 0x8000'0000);
+}
 
-    float get_sphere_dist(librii::glhelper::VBOBuilder& tri_vbo, u32 i,
-                          const glm::vec3& eye) const {
-      // Don't sqrt
-      return glm::distance2(get_point(tri_vbo, i), eye);
-    }
+// Below this, threads cost more than they save
+constexpr size_t ParallelSortThreshold = 128 * 1024;
+
+// Stable LSD radix sort of `keys`, permuting `values` alongside
+void RadixSort(std::vector<u32>& keys, std::vector<u32>& values,
+               std::vector<u32>& tmp_keys, std::vector<u32>& tmp_values) {
+  const size_t n = keys.size();
+  tmp_keys.resize(n);
+  tmp_values.resize(n);
+
+  u32 num_chunks = 1;
+  if (n >= ParallelSortThreshold)
+    num_chunks = std::clamp(std::thread::hardware_concurrency(), 1u, 16u);
+  const size_t chunk_size = (n + num_chunks - 1) / num_chunks;
+
+  // Chunks run on the shared pool, so sorting every frame starts no threads
+  auto for_each_chunk = [&](auto&& f) {
+    rsl::ParallelFor(
+        num_chunks, 1,
+        [&](size_t first, size_t last) {
+          for (size_t c = first; c < last; ++c) {
+            const size_t begin = std::min(n, c * chunk_size);
+            f(static_cast<u32>(c), begin, std::min(n, begin + chunk_size));
+          }
+        },
+        num_chunks);
+  };
 
-    float get_min_sphere_dist(librii::glhelper::VBOBuilder& tri_vbo,
-                              const glm::vec3& view) const {
-      return std::min({get_sphere_dist(tri_vbo, 0, view),
-                       get_sphere_dist(tri_vbo, 1, view),
-                       get_sphere_dist(tri_vbo, 2, view)});
+  std::vector<std::array<u32, 256>> counts(num_chunks);
+  for (u32 shift = 0; shift < 32; shift += 8) {
+    for_each_chunk([&](u32 c, size_t begin, size_t end) {
+      auto& count = counts[c];
+      count.fill(0);
+      for (size_t i = begin; i < end; ++i)
+        ++count[(keys[i] >> shift) & 0xFF];
+    });
+
+    // Exclusive prefix sum, digit-major so each chunk scatters stably
+    size_t sum = 0;
+    bool all_same_digit = false;
+    for (u32 d = 0; d < 256; ++d) {
+      size_t digit_total = 0;
+      for (u32 c = 0; c < num_chunks; ++c) {
+        const u32 count = counts[c][d];
+        counts[c][d] = static_cast<u32>(sum);
+        sum += count;
+        digit_total += count;
+      }
+      all_same_digit |= digit_total == n;
     }
+    if (all_same_digit)
+      continue;
+
+    for_each_chunk([&](u32 c, size_t begin, size_t end) {
+      auto& offset = counts[c];
+      for (size_t i = begin; i < end; ++i) {
+        const u32 dst = offset[(keys[i] >> shift) & 0xFF]++;
+        tmp_keys[dst] = keys[i];
+        tmp_values[dst] = values[i];
+      }
+    });
+    keys.swap(tmp_keys);
+    values.swap(tmp_values);
+  }
+}
 
-    float get_plane_dist(librii::glhelper::VBOBuilder& tri_vbo, u32 i,
-                         const glm::mat4& view) const {
-      // We assume all points are closer, or all are further away
-      return (view * glm::vec4(get_point(tri_vbo, i), 1.0f)).z;
+// Sorts nearly-sorted data in place. Gives up after `max_moves` element moves,
+// leaving a permutation of the input.
+//
+// Returns {finished, changed}
+std::pair<bool, bool> InsertionSort(std::vector<u32>& keys,
+                                    std::vector<u32>& values,
+                                    size_t max_moves) {
+  size_t moves = 0;
+  for (size_t i = 1; i < keys.size(); ++i) {
+    const u32 key = keys[i];
+    if (keys[i - 1] <= key)
+      continue;
+    const u32 value = values[i];
+    size_t j = i;
+    for (; j > 0 && keys[j - 1] > key; --j) {
+      keys[j] = keys[j - 1];
+      values[j] = values[j - 1];
     }
+    keys[j] = key;
+    values[j] = value;
+    moves += i - j;
+    if (moves > max_moves)
+      return {false, true};
+  }
+  return {true, moves != 0};
+}
 
-    float get_min_plane_dist(librii::glhelper::VBOBuilder& tri_vbo,
-                             const glm::mat4& view) const {
-      return std::max({get_plane_dist(tri_vbo, 0, view),
-                       get_plane_dist(tri_vbo, 1, view),
-                       get_plane_dist(tri_vbo, 2, view)});
-    }
-  };
+} // namespace
 
-  index_tri* begin = reinterpret_cast<index_tri*>(tri_vbo->mIndices.data());
-  index_tri* end = begin + tri_vbo->mIndices.size() / 3;
+void TriangleRenderer::sortTriangles(const glm::mat4& viewMtx) {
+  if (tri_vbo == nullptr)
+    return;
+  // Only the depth row of the view matrix affects the order
+  const glm::vec4 depth_row{viewMtx[0][2], viewMtx[1][2], viewMtx[2][2],
+                            viewMtx[3][2]};
+  const size_t n = mKclTris.size();
+  const bool coherent = mSortOrder.size() == n;
+  if (coherent && mLastDepthRow == depth_row)
+    return;
+  mLastDepthRow = depth_row;
 
-  z_dist.resize(end - begin);
+  if (!coherent) {
+    mSortOrder.resize(n);
+    std::iota(mSortOrder.begin(), mSortOrder.end(), 0);
+  }
 
-  // Assumes no vertex merging, uses first vertex as a key
-  for (int i = 0; i < end - begin; ++i) {
-    auto first_vtx = begin[i].points[0];
-    z_dist[first_vtx / 3] = begin[i].get_min_plane_dist(*tri_vbo, viewMtx);
+  // Key on the nearest vertex, in the previous order
+  mSortKeys.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    const auto& verts = mKclTris[mSortOrder[i]].verts;
+    const auto z = [&](const glm::vec3& v) {
+      return glm::dot(glm::vec4(v, 1.0f), depth_row);
+    };
+    mSortKeys[i] = DepthKey(std::max({z(verts[0]), z(verts[1]), z(verts[2])}));
   }
 
-  auto comp = [&](const index_tri& lhs, const index_tri& rhs) {
-    return z_dist[lhs.points[0] / 3] > z_dist[rhs.points[0] / 3];
-  };
-  std::sort(begin, end, comp);
+  // Small camera moves barely change the previous order
+  bool changed = true;
+  bool sorted = false;
+  if (coherent) {
+    std::tie(sorted, changed) =
+        InsertionSort(mSortKeys, mSortOrder, n / 8 + 1024);
+  }
+  if (!sorted)
+    RadixSort(mSortKeys, mSortOrder, mSortScratchKeys, mSortScratchOrder);
+  if (!changed)
+    return;
 
-  std::reverse(begin, end);
+  // Ascending view-space z: back to front
+  auto& indices = tri_vbo->mIndices;
+  assert(indices.size() == 3 * n);
+  for (size_t i = 0; i < n; ++i) {
+    const u32 tri = mSortOrder[i];
+    indices[3 * i + 0] = 3 * tri + 0;
+    indices[3 * i + 1] = 3 * tri + 1;
+    indices[3 * i + 2] = 3 * tri + 2;
+  }
 
   tri_vbo->uploadIndexBuffer();
 }
@@ -4,6 +4,7 @@
 #include <core/common.h>
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 #include <librii/kcol/Model.hpp>
 #include <vector>
 
@@ -17,12 +18,19 @@ struct Triangle {
   std::array<glm::vec3, 3> verts;
 };
 
+// Expand the prisms of `kcl`. Safe to call from any thread.
+std::vector<Triangle> ToTriangles(const librii::kcol::KCollisionData& kcl);
+
 class TriangleRenderer {
 public:
   // Upload initial triangle data to GPU
-  void init(const librii::kcol::KCollisionData& mCourseKcl);
+  void init(const librii::kcol::KCollisionData& mCourseKcl) {
+    init(ToTriangles(mCourseKcl));
+  }
+  void init(std::vector<Triangle> tris);
 
-  // Z-Sort triangles on CPU, upload to GPU
+  // Z-Sort triangles on CPU, upload to GPU. Cheap when the view barely
+  // changed, free when it did not.
   void sortTriangles(const glm::mat4& viewMtx);
 
   // Add draw call to tree
@@ -30,18 +38,24 @@ public:
             const glm::mat4& viewMtx, const glm::mat4& projMtx, u32 attr_mask,
             float alpha);
 
-private:
-  // Take prism-form indexed vectors from `kcl`, and populate mKclTris
-  void convertToTriangles(const librii::kcol::KCollisionData& kcl);
+  const std::vector<Triangle>& getTriangles() const { return mKclTris; }
 
+private:
   // Populate tri_vbo by mKclTris
   void buildVertexBuffer();
 
   std::vector<Triangle> mKclTris;
   // KCL triangle vertex buffer
   std::unique_ptr<librii::glhelper::VBOBuilder> tri_vbo = nullptr;
-  // z_dist of every kcl triangle and the camera
-  std::vector<float> z_dist;
+
+  // Triangles, back to front as of the last sort
+  std::vector<u32> mSortOrder;
+  // Depth key of each entry of mSortOrder
+  std::vector<u32> mSortKeys;
+  std::vector<u32> mSortScratchKeys;
+  std::vector<u32> mSortScratchOrder;
+  // Third row of the view matrix used for the last sort
+  glm::vec4 mLastDepthRow{0.0f};
 };
 
 } // namespace riistudio::lvl
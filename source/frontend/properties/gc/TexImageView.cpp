@@ -50,8 +50,7 @@ void exportImage(const Texture& tex, u32 export_lod) {
   }
 #endif
 
-  std::vector<u8> data;
-  tex.decode(data, true);
+  const auto data = tex.decodeShared(true);
 
   u32 offset = 0;
   for (u32 i = 0; i < export_lod; ++i)
@@ -59,7 +58,7 @@ void exportImage(const Texture& tex, u32 export_lod) {
 
   librii::writeImageStbRGBA(path.c_str(), imgType, tex.getWidth() >> export_lod,
                             tex.getHeight() >> export_lod,
-                            data.data() + offset);
+                            data->data() + offset);
 }
 
 void importImage(Texture& tex, u32 import_lod) {
@@ -22,7 +22,6 @@ void IconDatabase::drawIcon(Key id, int wd, int ht) const {
 
 // TODO: Not threadsafe
 static std::array<u8, 128 * 128 * 4> scratch;
-static std::vector<u8> tmp;
 
 IconDatabase::Icon::Icon(lib3d::Texture& texture, u32 dimension) {
 #ifdef RII_GL
@@ -36,8 +35,8 @@ IconDatabase::Icon::Icon(lib3d::Texture& texture, u32 dimension) {
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
   assert(dimension <= 128);
-  texture.decode(tmp, false);
-  librii::image::resize(scratch.data(), dimension, dimension, tmp.data(),
+  const auto image = texture.decodeShared(false);
+  librii::image::resize(scratch.data(), dimension, dimension, image->data(),
                         texture.getWidth(), texture.getHeight(),
                         librii::image::Lanczos);
 
@@ -22,12 +22,12 @@ void ImagePreview::setFromImage(const lib3d::Texture& tex) {
   height = tex.getHeight();
   mNumMipMaps = tex.getMipmapCount();
   mLod = std::min(static_cast<u32>(mLod), mNumMipMaps);
-  tex.decode(mDecodeBuf, true);
+  const auto data = tex.decodeShared(true);
 
   if (mTexUploaded) {
     glDeleteTextures(1, &mGpuTexId);
   }
-  if (mDecodeBuf.size() && width && height) {
+  if (data->size() && width && height) {
     glGenTextures(1, &mGpuTexId);
   } else {
     mTexUploaded = false;
@@ -48,10 +48,9 @@ void ImagePreview::setFromImage(const lib3d::Texture& tex) {
   for (u32 i = 0; i <= tex.getMipmapCount(); ++i) {
     glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, tex.getWidth() >> i,
                  tex.getHeight() >> i, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-                 mDecodeBuf.data() + slide);
+                 data->data() + slide);
     slide += (tex.getWidth() >> i) * (tex.getHeight() >> i) * 4;
   }
-  mDecodeBuf.clear();
 #endif
 }
 
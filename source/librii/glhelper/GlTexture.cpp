@@ -14,8 +14,6 @@ GlTexture::~GlTexture() {
 
 std::optional<GlTexture> GlTexture::makeTexture(const riistudio::lib3d::Texture& tex) {
 #ifdef RII_GL
-  static std::vector<u8> data(1024 * 1024 * 4 * 2);
-
   u32 gl_id;
   glGenTextures(1, &gl_id);
   glBindTexture(GL_TEXTURE_2D, gl_id);
@@ -27,13 +25,13 @@ std::optional<GlTexture> GlTexture::makeTexture(const riistudio::lib3d::Texture&
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, tex.getMipmapCount());
-  tex.decode(data, true);
+  const auto data = tex.decodeShared(true);
 
   u32 slide = 0;
   for (u32 i = 0; i <= tex.getMipmapCount(); ++i) {
     glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, tex.getWidth() >> i,
                  tex.getHeight() >> i, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-                 data.data() + slide);
+                 data->data() + slide);
     slide += (tex.getWidth() >> i) * (tex.getHeight() >> i) * 4;
   }
 
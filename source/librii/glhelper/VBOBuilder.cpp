@@ -20,11 +20,15 @@ VBOBuilder::~VBOBuilder() {
 void VBOBuilder::build() {
   std::vector<std::pair<VAOEntry, u32>> mAttribStack; // desc : offset
 
+  std::size_t total_size = mData.size();
+  for (const auto& bind : mPropogating)
+    total_size += bind.second.data.size();
+  mData.reserve(total_size);
+
   for (const auto& bind : mPropogating) {
     mAttribStack.emplace_back(bind.second.descriptor, mData.size());
 
-    for (const u8 e : bind.second.data)
-      push(e);
+    mData.insert(mData.end(), bind.second.data.begin(), bind.second.data.end());
   }
 
   uploadIndexBuffer();
@@ -3,6 +3,7 @@
 #include <core/common.h>
 #include <map>
 #include <memory>
+#include <span>
 #include <tuple>
 #include <vector>
 
@@ -45,6 +46,14 @@ struct VBOBuilder {
     *reinterpret_cast<T*>(attrib_buf.data.data() + begin) = data;
   }
 
+  // Size an attribute for `count` elements at once, to be filled in place
+  template <typename T>
+  std::span<T> resizeData(u32 binding_point, std::size_t count) {
+    auto& attrib_buf = mPropogating[binding_point];
+    attrib_buf.data.resize(count * sizeof(T));
+    return {reinterpret_cast<T*>(attrib_buf.data.data()), count};
+  }
+
   void bind();
   void unbind();
   u32 getGlId() const { return VAO; }
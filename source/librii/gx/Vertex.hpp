@@ -1,8 +1,10 @@
 #pragma once
 
 #include <core/common.h>
+#include <librii/gx/VertexIndex.hpp>
 #include <oishii/reader/binary_reader.hxx>
 #include <oishii/writer/binary_writer.hxx>
+#include <span>
 #include <vendor/glm/vec3.hpp>
 
 namespace librii::gx {
@@ -264,6 +266,29 @@ inline gx::Color readComponents<gx::Color>(oishii::BinaryReader& reader,
   return readColorComponents(reader, type.color);
 }
 
+//! @brief Read a whole vertex array.
+//!
+//! Full-width f32 arrays are bulk-read and byte swapped in one pass.
+template <typename T>
+inline void readComponentArray(oishii::BinaryReader& reader,
+                               std::span<T> entries, gx::VertexBufferType type,
+                               std::size_t true_count, u32 divisor = 0) {
+  if constexpr (!std::is_same_v<T, gx::Color>) {
+    using value_t = typename T::value_type;
+    if (std::is_same_v<value_t, f32> &&
+        type.generic == gx::VertexBufferType::Generic::f32 &&
+        true_count == T::length() &&
+        sizeof(T) == T::length() * sizeof(value_t)) {
+      reader.readArray<f32>(
+          std::span<f32>(reinterpret_cast<f32*>(entries.data()),
+                         entries.size() * T::length()));
+      return;
+    }
+  }
+  for (auto& entry : entries)
+    entry = readComponents<T>(reader, type, true_count, divisor);
+}
+
 inline void writeColorComponents(oishii::Writer& writer,
                                  const librii::gx::Color& c,
                                  VertexBufferType::Color colort) {
@@ -349,6 +374,38 @@ inline void writeComponents<gx::Color>(oishii::Writer& writer,
   return writeColorComponents(writer, c, type.color);
 }
 
+//! @brief Write a whole vertex array.
+//!
+//! Full-width f32 arrays are already laid out as the file expects, so they go
+//! through a single bulk write instead of per-component dispatch.
+template <typename T>
+inline void writeComponentArray(oishii::Writer& writer,
+                                std::span<const T> entries,
+                                gx::VertexBufferType type,
+                                std::size_t true_count, u32 divisor = 0) {
+  if constexpr (!std::is_same_v<T, gx::Color>) {
+    using value_t = typename T::value_type;
+    if (std::is_same_v<value_t, f32> &&
+        type.generic == gx::VertexBufferType::Generic::f32 &&
+        true_count == T::length() &&
+        sizeof(T) == T::length() * sizeof(value_t)) {
+      writer.writeArray<f32>(std::span<const f32>(
+          reinterpret_cast<const f32*>(entries.data()),
+          entries.size() * T::length()));
+      return;
+    }
+  }
+  for (const auto& entry : entries)
+    writeComponents(writer, entry, type, true_count, divisor);
+}
+
+//! Spacing of the values a generic vertex buffer can store; 0 for f32
+inline f32 QuantizationStep(VertexBufferType::Generic type, u32 divisor) {
+  if (type == VertexBufferType::Generic::f32)
+    return 0.0f;
+  return 1.0f / static_cast<f32>(1 << divisor);
+}
+
 struct VQuantization {
   librii::gx::VertexComponentCount comp = librii::gx::VertexComponentCount(
       librii::gx::VertexComponentCount::Position::xyz);
@@ -371,6 +428,17 @@ using VBufferKind = VertexBufferKind;
 template <typename TB, VBufferKind kind> struct VertexBuffer {
   VQuantization mQuant;
   std::vector<TB> mData;
+  VertexIndex<TB> mIndex;
+
+  //! Index of an entry stored the same as `v`, appended if there is none
+  std::size_t findOrAdd(const TB& v) {
+    if constexpr (kind == VBufferKind::color) {
+      return mIndex.findOrAdd(mData, v);
+    } else {
+      return mIndex.findOrAdd(
+          mData, v, QuantizationStep(mQuant.type.generic, mQuant.divisor));
+    }
+  }
 
   int ComputeComponentCount() const {
     return computeComponentCount(kind, mQuant.comp);
@@ -387,6 +455,12 @@ template <typename TB, VBufferKind kind> struct VertexBuffer {
     result = readColorComponents(reader, mQuant.type.color);
   }
 
+  //! Fill mData (already sized to the entry count) from the stream.
+  void readData(oishii::BinaryReader& reader) {
+    readComponentArray<TB>(reader, mData, mQuant.type, ComputeComponentCount(),
+                           mQuant.divisor);
+  }
+
   template <int n, typename T, glm::qualifier q>
   void writeBufferEntryGeneric(oishii::Writer& writer,
                                const glm::vec<n, T, q>& v) const {
@@ -416,8 +490,8 @@ template <typename TB, VBufferKind kind> struct VertexBuffer {
         return false;
       }
 
-      for (const auto& d : mData)
-        writeBufferEntryGeneric(writer, d);
+      writeComponentArray<TB>(writer, mData, mQuant.type,
+                              ComputeComponentCount(), mQuant.divisor);
     } else if constexpr (kind == VBufferKind::normal) {
       if (mQuant.comp.normal !=
           librii::gx::VertexComponentCount::Normal::xyz) {
@@ -425,8 +499,8 @@ template <typename TB, VBufferKind kind> struct VertexBuffer {
         return false;
       }
 
-      for (const auto& d : mData)
-        writeBufferEntryGeneric(writer, d);
+      writeComponentArray<TB>(writer, mData, mQuant.type,
+                              ComputeComponentCount(), mQuant.divisor);
     } else if constexpr (kind == VBufferKind::color) {
       for (const auto& d : mData)
         writeBufferEntryColor(writer, d);
@@ -437,8 +511,8 @@ template <typename TB, VBufferKind kind> struct VertexBuffer {
         return false;
       }
 
-      for (const auto& d : mData)
-        writeBufferEntryGeneric(writer, d);
+      writeComponentArray<TB>(writer, mData, mQuant.type,
+                              ComputeComponentCount(), mQuant.divisor);
     }
 
 	return true;
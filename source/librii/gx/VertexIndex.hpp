@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <core/common.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <librii/gx/Color.hpp>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace librii::gx {
+
+//! @brief Finds vertex array entries by value, so importers can reuse an
+//! existing entry without scanning the whole array.
+//!
+//! The index is a cache: it catches up with entries appended by others, is
+//! rebuilt when the array shrank or a match turns out to have been edited,
+//! starts out empty when copied and compares equal to any other index.
+template <typename T> class VertexIndex {
+public:
+  VertexIndex() = default;
+  VertexIndex(const VertexIndex&) {}
+  VertexIndex& operator=(const VertexIndex&) {
+    clear();
+    return *this;
+  }
+  bool operator==(const VertexIndex&) const { return true; }
+
+  //! @brief Index of an entry matching `value`; appended if there is none.
+  //!
+  //! With a nonzero `step`, entries are matched after rounding each component
+  //! to a multiple of it: pass QuantizationStep() for fixed-point buffers,
+  //! which cannot tell such entries apart anyway, or a weld distance.
+  //! Otherwise only identical entries are reused.
+  std::size_t findOrAdd(std::vector<T>& entries, const T& value,
+                        f32 step = 0.0f) {
+    if (step != mStep || mIndexed > entries.size()) {
+      clear();
+      mStep = step;
+    }
+    catchUp(entries);
+
+    const Key key = keyOf(value);
+    if (auto it = mMap.find(key); it != mMap.end()) {
+      const u32 found = it->second;
+      if (keyOf(entries[found]) != key) {
+        // Edited in place since indexed
+        clear();
+        return findOrAdd(entries, value, step);
+      }
+      // Exact matching keeps std::find's semantics (NaN, signed zero)
+      if (step != 0.0f || entries[found] == value)
+        return found;
+    }
+
+    entries.push_back(value);
+    catchUp(entries);
+    return entries.size() - 1;
+  }
+
+  void clear() {
+    mMap.clear();
+    mIndexed = 0;
+  }
+
+private:
+  static constexpr std::size_t NumComponents() {
+    if constexpr (std::is_same_v<T, Color>)
+      return 4;
+    else
+      return T::length();
+  }
+  using Key = std::array<u32, NumComponents()>;
+
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const noexcept {
+      u64 h = 0xcbf29ce484222325;
+      for (u32 c : key)
+        h = (h ^ c) * 0x100000001b3;
+      return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+  };
+
+  Key keyOf(const T& value) const {
+    Key key;
+    if constexpr (std::is_same_v<T, Color>) {
+      key = {value.r, value.g, value.b, value.a};
+    } else {
+      for (std::size_t i = 0; i < key.size(); ++i) {
+        f32 c = value[i];
+        if (mStep != 0.0f)
+          c = std::roundf(c / mStep);
+        // Folds -0 into 0
+        key[i] = std::bit_cast<u32>(c + 0.0f);
+      }
+    }
+    return key;
+  }
+
+  void catchUp(const std::vector<T>& entries) {
+    for (; mIndexed < entries.size(); ++mIndexed)
+      mMap.try_emplace(keyOf(entries[mIndexed]), static_cast<u32>(mIndexed));
+  }
+
+  std::unordered_map<Key, u32, KeyHash> mMap;
+  //! Entries [0, mIndexed) are in mMap
+  std::size_t mIndexed = 0;
+  f32 mStep = 0.0f;
+};
+
+} // namespace librii::gx
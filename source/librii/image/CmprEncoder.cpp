@@ -5,10 +5,25 @@
 
 #include <core/common.h>
 
+#include "CmprEncoder.hpp"
+
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <limits>
 #include <string.h>
 
 #include <oishii/util/util.hxx>
+#include <rsl/ParallelFor.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LIBRII_CMPR_AVX2
+#define LIBRII_CMPR_SSE2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define LIBRII_CMPR_SSE2
+#endif
 
 namespace librii::image {
 
@@ -247,6 +262,142 @@ CMPR_close_info(const u8* data,    // source data
   }
 }
 
+//! A 4x4 block, one array per channel, so each channel of the block fits one
+//! or two vector registers of 16-bit lanes
+struct cmpr_block_t {
+  alignas(32) s16 r[CMPR_MAX_COL];
+  alignas(32) s16 g[CMPR_MAX_COL];
+  alignas(32) s16 b[CMPR_MAX_COL];
+  //! 1 for opaque pixels, else 0
+  alignas(32) s16 w[CMPR_MAX_COL];
+};
+
+static inline void CMPR_load_block(const u8* data, cmpr_block_t* block) {
+  for (u32 i = 0; i < CMPR_MAX_COL; i++, data += 4) {
+    block->r[i] = data[0];
+    block->g[i] = data[1];
+    block->b[i] = data[2];
+    block->w[i] = data[3] >> 7;
+  }
+}
+
+// The distances below are at most 3 * 255 per pixel and 16 * 3 * 255 per
+// block, so 16-bit lanes cannot overflow.
+
+#if defined(LIBRII_CMPR_AVX2)
+// All 16 pixels' distances to `pal`
+static inline __m256i CMPR_distance16(const cmpr_block_t& block,
+                                      const u8* pal) {
+  const auto channel = [](const s16* c, u8 p) {
+    return _mm256_abs_epi16(
+        _mm256_sub_epi16(_mm256_load_si256(reinterpret_cast<const __m256i*>(c)),
+                         _mm256_set1_epi16(p)));
+  };
+  return _mm256_add_epi16(
+      _mm256_add_epi16(channel(block.r, pal[0]), channel(block.g, pal[1])),
+      channel(block.b, pal[2]));
+}
+static inline u32 CMPR_sum16(__m256i v) {
+  const __m256i sums = _mm256_madd_epi16(v, _mm256_set1_epi16(1));
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(sums),
+                              _mm256_extracti128_si256(sums, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+#elif defined(LIBRII_CMPR_SSE2)
+// Pixels [first, first + 8)'s distances to `pal`
+static inline __m128i CMPR_distance8(const cmpr_block_t& block, u32 first,
+                                     const u8* pal) {
+  const auto channel = [first](const s16* c, u8 p) {
+    const __m128i d = _mm_sub_epi16(
+        _mm_load_si128(reinterpret_cast<const __m128i*>(c + first)),
+        _mm_set1_epi16(p));
+    return _mm_max_epi16(d, _mm_sub_epi16(_mm_setzero_si128(), d));
+  };
+  return _mm_add_epi16(
+      _mm_add_epi16(channel(block.r, pal[0]), channel(block.g, pal[1])),
+      channel(block.b, pal[2]));
+}
+static inline u32 CMPR_sum8(__m128i v) {
+  __m128i sum = _mm_madd_epi16(v, _mm_set1_epi16(1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+#else
+static inline s32 CMPR_distance(const cmpr_block_t& block, u32 i,
+                                const u8* pal) {
+  return abs(block.r[i] - pal[0]) + abs(block.g[i] - pal[1]) +
+         abs(block.b[i] - pal[2]);
+}
+#endif
+
+// Sum over the opaque pixels of the distance to the nearest palette color.
+// Equal to WIMGT's early-out loop whenever that loop's result is used.
+static inline u32 CMPR_error3(const cmpr_block_t& block, const u8* pal0,
+                              const u8* pal1, const u8* pal2) {
+#if defined(LIBRII_CMPR_AVX2)
+  const __m256i d = _mm256_min_epi16(
+      _mm256_min_epi16(CMPR_distance16(block, pal0),
+                       CMPR_distance16(block, pal1)),
+      CMPR_distance16(block, pal2));
+  return CMPR_sum16(_mm256_mullo_epi16(
+      d, _mm256_load_si256(reinterpret_cast<const __m256i*>(block.w))));
+#elif defined(LIBRII_CMPR_SSE2)
+  __m128i dist = _mm_setzero_si128();
+  for (u32 i = 0; i < CMPR_MAX_COL; i += 8) {
+    const __m128i d = _mm_min_epi16(
+        _mm_min_epi16(CMPR_distance8(block, i, pal0),
+                      CMPR_distance8(block, i, pal1)),
+        CMPR_distance8(block, i, pal2));
+    const __m128i w =
+        _mm_load_si128(reinterpret_cast<const __m128i*>(block.w + i));
+    dist = _mm_add_epi16(dist, _mm_mullo_epi16(d, w));
+  }
+  return CMPR_sum8(dist);
+#else
+  s32 dist = 0;
+  for (u32 i = 0; i < CMPR_MAX_COL; i++) {
+    const s32 d0 = CMPR_distance(block, i, pal0);
+    const s32 d1 = CMPR_distance(block, i, pal1);
+    const s32 d2 = CMPR_distance(block, i, pal2);
+    dist += std::min(std::min(d0, d1), d2) * block.w[i];
+  }
+  return dist;
+#endif
+}
+static inline u32 CMPR_error4(const cmpr_block_t& block, const u8* pal0,
+                              const u8* pal1, const u8* pal2, const u8* pal3) {
+#if defined(LIBRII_CMPR_AVX2)
+  return CMPR_sum16(_mm256_min_epi16(
+      _mm256_min_epi16(CMPR_distance16(block, pal0),
+                       CMPR_distance16(block, pal1)),
+      _mm256_min_epi16(CMPR_distance16(block, pal2),
+                       CMPR_distance16(block, pal3))));
+#elif defined(LIBRII_CMPR_SSE2)
+  __m128i dist = _mm_setzero_si128();
+  for (u32 i = 0; i < CMPR_MAX_COL; i += 8) {
+    dist = _mm_add_epi16(
+        dist, _mm_min_epi16(_mm_min_epi16(CMPR_distance8(block, i, pal0),
+                                          CMPR_distance8(block, i, pal1)),
+                            _mm_min_epi16(CMPR_distance8(block, i, pal2),
+                                          CMPR_distance8(block, i, pal3))));
+  }
+  return CMPR_sum8(dist);
+#else
+  s32 dist = 0;
+  for (u32 i = 0; i < CMPR_MAX_COL; i++) {
+    const s32 d0 = CMPR_distance(block, i, pal0);
+    const s32 d1 = CMPR_distance(block, i, pal1);
+    const s32 d2 = CMPR_distance(block, i, pal2);
+    const s32 d3 = CMPR_distance(block, i, pal3);
+    dist += std::min(std::min(d0, d1), std::min(d2, d3));
+  }
+  return dist;
+#endif
+}
+
 static inline void WIMGT_CMPR(const u8* data, cmpr_info_t* info) {
   assert(info);
   memset(info, 0, sizeof(*info));
@@ -296,6 +447,10 @@ static inline void WIMGT_CMPR(const u8* data, cmpr_info_t* info) {
 
   assert(opaque_count >= 3);
 
+  cmpr_block_t block;
+  CMPR_load_block(data, &block);
+
+  // Try every pair of the block's colors. Ties keep the first pair found.
   u32 best0 = 0, best1 = 0, max_dist = (u32)-1;
   if (info->opaque_count < CMPR_MAX_COL) {
     // we have transparent points -> 1 middle point
@@ -309,19 +464,7 @@ static inline void WIMGT_CMPR(const u8* data, cmpr_info_t* info) {
         pal2[1] = (pal0[1] + pal1[1]) / 2;
         pal2[2] = (pal0[2] + pal1[2]) / 2;
 
-        u32 dist = 0;
-        const u8* dat;
-        for (dat = data; dat < data_end && dist < max_dist; dat += 4) {
-          if (dat[3] & 0x80) {
-            const u32 d0 = calc_distance(dat, pal0);
-            const u32 d1 = calc_distance(dat, pal1);
-            const u32 d2 = calc_distance(dat, pal2);
-            if (d0 <= d1)
-              dist += d0 < d2 ? d0 : d2;
-            else
-              dist += d1 < d2 ? d1 : d2;
-          }
-        }
+        const u32 dist = CMPR_error3(block, pal0, pal1, pal2);
         if (max_dist > dist) {
           max_dist = dist;
           best0 = s0;
@@ -332,11 +475,9 @@ static inline void WIMGT_CMPR(const u8* data, cmpr_info_t* info) {
   } else {
     // no transparent points -> 2 middle point
 
-    u32 s0;
-    for (s0 = 0; s0 < n_sum; s0++) {
+    for (u32 s0 = 0; s0 < n_sum; s0++) {
       u8* pal0 = sum[s0].col;
-      u32 s1;
-      for (s1 = s0 + 1; s1 < n_sum; s1++) {
+      for (u32 s1 = s0 + 1; s1 < n_sum; s1++) {
         u8* pal1 = sum[s1].col;
         u8 pal2[4];
         pal2[0] = (2 * pal0[0] + pal1[0]) / 3;
@@ -347,25 +488,7 @@ static inline void WIMGT_CMPR(const u8* data, cmpr_info_t* info) {
         pal3[1] = (pal0[1] + 2 * pal1[1]) / 3;
         pal3[2] = (pal0[2] + 2 * pal1[2]) / 3;
 
-        u32 dist = 0;
-        const u8* dat;
-        for (dat = data; dat < data_end && dist < max_dist; dat += 4) {
-          const u32 d0 = calc_distance(dat, pal0);
-          const u32 d1 = calc_distance(dat, pal1);
-          const u32 d2 = calc_distance(dat, pal2);
-          const u32 d3 = calc_distance(dat, pal3);
-          if (d0 <= d1) {
-            if (d2 <= d3)
-              dist += d0 < d2 ? d0 : d2;
-            else
-              dist += d0 < d3 ? d0 : d3;
-          } else {
-            if (d2 <= d3)
-              dist += d1 <= d2 ? d1 : d2;
-            else
-              dist += d1 <= d3 ? d1 : d3;
-          }
-        }
+        const u32 dist = CMPR_error4(block, pal0, pal1, pal2, pal3);
         if (max_dist > dist) {
           max_dist = dist;
           best0 = s0;
@@ -378,6 +501,116 @@ static inline void WIMGT_CMPR(const u8* data, cmpr_info_t* info) {
   memcpy(info->p[0], sum[best0].col, 4);
   memcpy(info->p[1], sum[best1].col, 4);
 }
+
+// Endpoints spanning the opaque pixels along `axis`
+static inline void CMPR_axis_extremes(const cmpr_block_t& block,
+                                      const f32* axis, cmpr_info_t* info) {
+  f32 lo = std::numeric_limits<f32>::max();
+  f32 hi = -std::numeric_limits<f32>::max();
+  u32 lo_i = 0, hi_i = 0;
+  for (u32 i = 0; i < CMPR_MAX_COL; i++) {
+    if (!block.w[i])
+      continue;
+    const f32 t = block.r[i] * axis[0] + block.g[i] * axis[1] +
+                  block.b[i] * axis[2];
+    if (t < lo) {
+      lo = t;
+      lo_i = i;
+    }
+    if (t > hi) {
+      hi = t;
+      hi_i = i;
+    }
+  }
+  info->p[0][0] = block.r[hi_i];
+  info->p[0][1] = block.g[hi_i];
+  info->p[0][2] = block.b[hi_i];
+  info->p[0][3] = 0xff;
+  info->p[1][0] = block.r[lo_i];
+  info->p[1][1] = block.g[lo_i];
+  info->p[1][2] = block.b[lo_i];
+  info->p[1][3] = 0xff;
+}
+
+// Endpoints at the extreme opaque pixels along a diagonal of their bounding
+// box. The diagonal is chosen by the sign of the green and blue covariance
+// with red.
+static inline void CMPR_range_fit(const u8* data, cmpr_info_t* info) {
+  memset(info, 0, sizeof(*info));
+  cmpr_block_t block;
+  CMPR_load_block(data, &block);
+
+  s32 n = 0, sr = 0, sg = 0, sb = 0;
+  for (u32 i = 0; i < CMPR_MAX_COL; i++) {
+    n += block.w[i];
+    sr += block.r[i] * block.w[i];
+    sg += block.g[i] * block.w[i];
+    sb += block.b[i] * block.w[i];
+  }
+  info->opaque_count = n;
+  if (n == 0)
+    return;
+
+  s32 cov_rg = 0, cov_rb = 0;
+  for (u32 i = 0; i < CMPR_MAX_COL; i++) {
+    const s32 dr = (block.r[i] * n - sr) * block.w[i];
+    cov_rg += dr * (block.g[i] * n - sg);
+    cov_rb += dr * (block.b[i] * n - sb);
+  }
+  const f32 axis[3] = {1.0f, cov_rg < 0 ? -1.0f : 1.0f,
+                       cov_rb < 0 ? -1.0f : 1.0f};
+  CMPR_axis_extremes(block, axis, info);
+}
+
+// Endpoints at the extremes along the principal axis of the opaque pixels
+static inline void CMPR_principal_fit(const u8* data, cmpr_info_t* info) {
+  memset(info, 0, sizeof(*info));
+  cmpr_block_t block;
+  CMPR_load_block(data, &block);
+
+  f32 n = 0.0f, mean[3] = {};
+  for (u32 i = 0; i < CMPR_MAX_COL; i++) {
+    n += block.w[i];
+    mean[0] += block.r[i] * block.w[i];
+    mean[1] += block.g[i] * block.w[i];
+    mean[2] += block.b[i] * block.w[i];
+  }
+  info->opaque_count = static_cast<u32>(n);
+  if (n == 0.0f)
+    return;
+  for (f32& m : mean)
+    m /= n;
+
+  // Covariance: rr, rg, rb, gg, gb, bb
+  f32 cov[6] = {};
+  for (u32 i = 0; i < CMPR_MAX_COL; i++) {
+    const f32 r = (block.r[i] - mean[0]) * block.w[i];
+    const f32 g = (block.g[i] - mean[1]) * block.w[i];
+    const f32 b = (block.b[i] - mean[2]) * block.w[i];
+    cov[0] += r * r;
+    cov[1] += r * g;
+    cov[2] += r * b;
+    cov[3] += g * g;
+    cov[4] += g * b;
+    cov[5] += b * b;
+  }
+
+  // Power iteration; a few steps suffice to pick the extremes
+  f32 axis[3] = {1.0f, 1.0f, 1.0f};
+  for (int it = 0; it < 8; it++) {
+    const f32 x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+    const f32 y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+    const f32 z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+    const f32 len = std::max(std::max(fabsf(x), fabsf(y)), fabsf(z));
+    if (len == 0.0f)
+      break;
+    axis[0] = x / len;
+    axis[1] = y / len;
+    axis[2] = z / len;
+  }
+  CMPR_axis_extremes(block, axis, info);
+}
+
 struct Image_t;
 u32 CalcImageSize(u32 width,  // width of image in pixel
                   u32 height, // height of image in pixel
@@ -429,7 +662,25 @@ CalcImageBlock(u32 width, u32 height,
     *img_size = size;
 }
 
-void EncodeDXT1(u8* dest_img, const u8* source_img, u32 width, u32 height) {
+static void CMPR_encode_block(const u8* vector, u8* dest,
+                              CmprQuality quality) {
+  cmpr_info_t info;
+  switch (quality) {
+  case CmprQuality::RangeFit:
+    CMPR_range_fit(vector, &info);
+    break;
+  case CmprQuality::PrincipalAxis:
+    CMPR_principal_fit(vector, &info);
+    break;
+  case CmprQuality::Exhaustive:
+    WIMGT_CMPR(vector, &info);
+    break;
+  }
+  CMPR_close_info(vector, &info, dest);
+}
+
+void EncodeDXT1(u8* dest_img, const u8* source_img, u32 width, u32 height,
+                CmprQuality quality, u32 num_threads) {
   assert(dest_img);
   assert(source_img);
 
@@ -441,44 +692,49 @@ void EncodeDXT1(u8* dest_img, const u8* source_img, u32 width, u32 height) {
   CalcImageBlock(width, height, bits_per_pixel, block_width, block_height,
                  &h_blocks, &v_blocks, &img_size);
 
-  u8* dest = dest_img;
-  const u8* src1 = source_img;
-
   const u32 block_size = block_width * 4;
 
-  const u32 xwidth = ((width + 0x1f) & ~0x1f);
-  const u32 line_size = xwidth * 4;
+  // Source rows span whole blocks. (Rounding up to 32 pixels, as WIMGT did,
+  // read the wrong rows of narrower images.)
+  const u32 line_size = h_blocks * block_width * 4;
   const u32 delta[] = {0, 16, 4 * line_size, 4 * line_size + 16};
 
-  while (v_blocks-- > 0) {
-    const u8* src2 = src1;
-    u32 hblk = h_blocks;
-    while (hblk-- > 0) {
-      for (u32 subb = 0; subb < 4; subb++) {
-        //---- first collect the data of the 16 pixel
-
-        u8 vector[16 * 4], *vect = vector;
-        const u8* src3 = src2 + delta[subb];
-        for (u32 i = 0; i < 4; i++) {
-          memcpy(vect, src3, 16);
-          vect += 16;
-          src3 += line_size;
+  // Rows of 8x8 blocks are independent
+  const u32 row_size = h_blocks * 4 * 8;
+  constexpr u32 BlocksPerTask = 512;
+  const u32 rows_per_task =
+      std::max(1u, BlocksPerTask / std::max(h_blocks, 1u));
+  rsl::ParallelFor(
+      v_blocks, rows_per_task,
+      [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; row++) {
+          u8* dest = dest_img + row * row_size;
+          const u8* src2 = source_img + row * line_size * block_height;
+          for (u32 hblk = 0; hblk < h_blocks; hblk++) {
+            for (u32 subb = 0; subb < 4; subb++) {
+              //---- first collect the data of the 16 pixel
+
+              u8 vector[16 * 4], *vect = vector;
+              const u8* src3 = src2 + delta[subb];
+              for (u32 i = 0; i < 4; i++) {
+                memcpy(vect, src3, 16);
+                vect += 16;
+                src3 += line_size;
+              }
+              assert(vect == vector + sizeof(vector));
+
+              //--- analyze data
+
+              CMPR_encode_block(vector, dest, quality);
+              dest += 8;
+            }
+            src2 += block_size;
+          }
         }
-        assert(vect == vector + sizeof(vector));
-
-        //--- analyze data
-
-        cmpr_info_t info;
-        WIMGT_CMPR(vector, &info);
-        CMPR_close_info(vector, &info, dest);
-        dest += 8;
-      }
-      src2 += block_size;
-    }
-    src1 += line_size * block_height;
-  }
+      },
+      num_threads);
 
-  assert(dest == dest_img + img_size);
+  assert(v_blocks * row_size == img_size);
   // assert(src1 <= dest_img->data + dest_img->data_size);
 }
 
@@ -4,6 +4,17 @@
 
 namespace librii::image {
 
+//! How hard the CMPR encoder searches for each block's two endpoint colors
+enum class CmprQuality {
+  //! The block's extreme pixels along a diagonal of its bounding box, picked
+  //! by the signs of the green and blue covariance with red
+  RangeFit,
+  //! The block's extremes along its principal axis
+  PrincipalAxis,
+  //! The best pair of the block's own colors (WIMGT). The historical output.
+  Exhaustive,
+};
+
 //! @brief Encode a RGBA32 buffer to GC DXT1.
 //!
 //! @param[in] dest   Pointer to the output buffer. Must be appropriately sized.
@@ -12,7 +23,12 @@ namespace librii::image {
 //! (width * height * 4)
 //! @param[in] width  Width of the image.
 //! @param[in] height Height of the image.
+//! @param[in] quality Endpoint search; see CmprQuality.
+//! @param[in] num_threads Rows of blocks are split across this many workers
+//! (0: one per hardware thread). The output does not depend on it.
 //!
-void EncodeDXT1(u8* dest, const u8* source, u32 width, u32 height);
+void EncodeDXT1(u8* dest, const u8* source, u32 width, u32 height,
+                CmprQuality quality = CmprQuality::Exhaustive,
+                u32 num_threads = 0);
 
 } // namespace librii::image
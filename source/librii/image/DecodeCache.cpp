@@ -0,0 +1,93 @@
+#include "DecodeCache.hpp"
+
+#include <librii/image/ImagePlatform.hpp>
+#include <llvm/Support/xxhash.h>
+
+namespace librii::image {
+
+DecodeCache DecodeCache::sInstance;
+
+std::size_t DecodeCache::KeyHash::operator()(const Key& key) const noexcept {
+  u64 h = key.hash;
+  for (u32 v : {static_cast<u32>(key.format), key.width, key.height,
+                key.mipMapCount})
+    h = (h ^ v) * 0x100000001b3;
+  return static_cast<std::size_t>(h ^ (h >> 32));
+}
+
+DecodeCache::Image DecodeCache::decode(const u8* data, u32 width, u32 height,
+                                       gx::TextureFormat format,
+                                       u32 mipMapCount) {
+  if (gx::IsPaletteFormat(format))
+    return nullptr;
+
+  const auto encoded_size = getEncodedSize(width, height, format, mipMapCount);
+  const Key key{
+      .hash = llvm::xxHash64(llvm::ArrayRef<u8>(data, encoded_size)),
+      .size = static_cast<u32>(encoded_size),
+      .format = format,
+      .width = width,
+      .height = height,
+      .mipMapCount = mipMapCount,
+  };
+  {
+    std::scoped_lock lock(mMutex);
+    if (auto it = mLookup.find(key); it != mLookup.end()) {
+      mEntries.splice(mEntries.begin(), mEntries, it->second);
+      return it->second->second;
+    }
+  }
+
+  // Decoded unlocked; racing decodes of one image just do the work twice
+  u32 decoded_size = 0;
+  for (u32 i = 0; i <= mipMapCount; ++i)
+    decoded_size += (width >> i) * (height >> i) * 4;
+  auto image = std::make_shared<std::vector<u8>>(decoded_size);
+  transform(image->data(), width, height, format,
+            gx::TextureFormat::Extension_RawRGBA32, data, width, height,
+            mipMapCount);
+
+  std::scoped_lock lock(mMutex);
+  if (auto it = mLookup.find(key); it != mLookup.end())
+    return it->second->second;
+  mEntries.emplace_front(key, image);
+  mLookup.emplace(key, mEntries.begin());
+  mMemoryUsage += image->size();
+  evict();
+  return image;
+}
+
+void DecodeCache::setMemoryBudget(std::size_t bytes) {
+  std::scoped_lock lock(mMutex);
+  mMemoryBudget = bytes;
+  evict();
+}
+
+std::size_t DecodeCache::memoryBudget() const {
+  std::scoped_lock lock(mMutex);
+  return mMemoryBudget;
+}
+
+std::size_t DecodeCache::memoryUsage() const {
+  std::scoped_lock lock(mMutex);
+  return mMemoryUsage;
+}
+
+void DecodeCache::clear() {
+  std::scoped_lock lock(mMutex);
+  mEntries.clear();
+  mLookup.clear();
+  mMemoryUsage = 0;
+}
+
+void DecodeCache::evict() {
+  // The newest image is kept, however large
+  while (mMemoryUsage > mMemoryBudget && mEntries.size() > 1) {
+    auto& [key, image] = mEntries.back();
+    mMemoryUsage -= image->size();
+    mLookup.erase(key);
+    mEntries.pop_back();
+  }
+}
+
+} // namespace librii::image
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <core/common.h>
+#include <librii/gx/Texture.hpp>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace librii::image {
+
+//! @brief Least recently used cache of decoded textures, shared by everything
+//! that previews or uploads them.
+//!
+//! Images are keyed by a 64-bit hash and the size of their encoded data,
+//! their format, dimensions and number of mip levels, so unchanged textures
+//! are never decoded twice while cached. Thread safe.
+class DecodeCache {
+public:
+  using Image = std::shared_ptr<const std::vector<u8>>;
+
+  //! @brief Decode a texture to 8-bit RGBA, mip levels following the base
+  //! image.
+  //!
+  //! @param[in] data        Encoded data, sized getEncodedSize(width, height,
+  //! format, mipMapCount).
+  //! @param[in] mipMapCount Number of levels past the base to decode.
+  //!
+  //! @return The decoded image; nullptr for palette formats.
+  Image decode(const u8* data, u32 width, u32 height, gx::TextureFormat format,
+               u32 mipMapCount);
+
+  //! Limit on the size of cached images. Images still held by callers are
+  //! not counted once evicted.
+  void setMemoryBudget(std::size_t bytes);
+  std::size_t memoryBudget() const;
+  std::size_t memoryUsage() const;
+  void clear();
+
+  static DecodeCache& get() { return sInstance; }
+
+private:
+  struct Key {
+    //! xxHash64 of the encoded data, on every target
+    u64 hash;
+    u32 size;
+    gx::TextureFormat format;
+    u32 width;
+    u32 height;
+    u32 mipMapCount;
+
+    bool operator==(const Key&) const = default;
+  };
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const noexcept;
+  };
+  using Entry = std::pair<Key, Image>;
+
+  void evict();
+
+  mutable std::mutex mMutex;
+  //! Most recently used first
+  std::list<Entry> mEntries;
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> mLookup;
+  std::size_t mMemoryUsage = 0;
+  std::size_t mMemoryBudget = 256 * 1024 * 1024;
+
+  static DecodeCache sInstance;
+};
+
+} // namespace librii::image
@@ -1,12 +1,29 @@
 #include "ImagePlatform.hpp"
 
 #include "CmprEncoder.hpp"
+#include <algorithm>
+#include <cstring>
 #include <librii/gx.h>
+#include <rsl/ParallelFor.hpp>
 #include <span>
 #include <vendor/avir/avir.h>
 #include <vendor/avir/lancir.h>
 #include <vendor/dolemu/TextureDecoder/TextureDecoder.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LIBRII_IMAGE_AVX2
+#define LIBRII_IMAGE_SSSE3
+#define LIBRII_IMAGE_SSE2
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define LIBRII_IMAGE_SSSE3
+#define LIBRII_IMAGE_SSE2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define LIBRII_IMAGE_SSE2
+#endif
+
 namespace librii::image {
 
 std::pair<u32, u32> getBlockedDimensions(u32 width, u32 height,
@@ -33,226 +50,320 @@ void decode(u8* dst, const u8* src, int width, int height,
                     static_cast<TLUTFormat>(tlutformat));
 }
 
-struct rgba {
-  u8 r;
-  u8 g;
-  u8 b;
-  u8 a;
+//! @brief Intensity of a pixel: 0.299 R + 0.587 G + 0.144 B, truncated.
+//!
+//! Evaluated in double precision in the same order as the original encoders,
+//! so results match them bit for bit, except that bright colors (which exceed
+//! 255 with these weights) saturate instead of wrapping around.
+static inline u8 luminosity(const u8* c) {
+  const double l = static_cast<double>(c[0]) * 0.299 +
+                   static_cast<double>(c[1]) * 0.587 +
+                   static_cast<double>(c[2]) * 0.144;
+  return static_cast<u8>(std::min(l, 255.0));
+}
+
+#ifdef LIBRII_IMAGE_SSE2
+//! Splits 4 RGBA pixels into 32-bit lanes of one channel each
+struct Channels4 {
+  __m128i r, g, b, a;
+
+  explicit Channels4(const u8* src) {
+    const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i mask = _mm_set1_epi32(0xff);
+    r = _mm_and_si128(px, mask);
+    g = _mm_and_si128(_mm_srli_epi32(px, 8), mask);
+    b = _mm_and_si128(_mm_srli_epi32(px, 16), mask);
+    a = _mm_srli_epi32(px, 24);
+  }
 };
 
-constexpr u8 luminosity(const rgba& rgba) {
-  return static_cast<float>(rgba.r) * 0.299 +
-         static_cast<float>(rgba.g) * 0.587 +
-         static_cast<float>(rgba.b) * 0.144;
+//! luminosity() of 4 pixels, as 32-bit lanes
+static inline __m128i Luminosity4(const Channels4& c) {
+#ifdef LIBRII_IMAGE_AVX2
+  const __m256d l = _mm256_add_pd(
+      _mm256_add_pd(
+          _mm256_mul_pd(_mm256_cvtepi32_pd(c.r), _mm256_set1_pd(0.299)),
+          _mm256_mul_pd(_mm256_cvtepi32_pd(c.g), _mm256_set1_pd(0.587))),
+      _mm256_mul_pd(_mm256_cvtepi32_pd(c.b), _mm256_set1_pd(0.144)));
+  return _mm256_cvttpd_epi32(_mm256_min_pd(l, _mm256_set1_pd(255.0)));
+#else
+  // Two pixels per double vector
+  auto half = [](__m128i r, __m128i g, __m128i b) {
+    const __m128d l = _mm_add_pd(
+        _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(r), _mm_set1_pd(0.299)),
+                   _mm_mul_pd(_mm_cvtepi32_pd(g), _mm_set1_pd(0.587))),
+        _mm_mul_pd(_mm_cvtepi32_pd(b), _mm_set1_pd(0.144)));
+    return _mm_cvttpd_epi32(_mm_min_pd(l, _mm_set1_pd(255.0)));
+  };
+  auto high = [](__m128i v) { return _mm_unpackhi_epi64(v, v); };
+  return _mm_unpacklo_epi64(half(c.r, c.g, c.b),
+                            half(high(c.r), high(c.g), high(c.b)));
+#endif
 }
 
-void encodeI4(u8* dst, const u32* src, u32 width, u32 height) {
-  for (int y = 0; y < height; y += 8) {
-    for (int x = 0; x < width; x += 8) {
-      // Encode the 8x8 block
-      // There are 8 rows (4 bits wide) and 4 columns
-
-      for (int row = 0; row < 8; ++row) {
-        for (int column = 0; column < 4; ++column) {
-          struct rgba_x2 {
-            rgba _0;
-            rgba _1;
-          };
-          rgba_x2 rgba = *(rgba_x2*)&src[(y + row) * width + x + column * 2];
-          u32 i0 = luminosity(rgba._0);
-          u32 i1 = luminosity(rgba._1);
-
-          u8 i0i1 = (i0 & 0b11'11'00'00) | ((i1 >> 4) & 0b11'11);
-          dst[column] = i0i1;
-        }
-        dst += 4;
-      }
-    }
+//! Narrows 32-bit lanes holding bytes to 4 bytes
+static inline u32 PackBytes4(__m128i v) {
+  v = _mm_packs_epi32(v, v);
+  return static_cast<u32>(_mm_cvtsi128_si32(_mm_packus_epi16(v, v)));
+}
+
+//! Narrows 32-bit lanes holding u16 values to 4 big-endian u16s
+static inline void StoreBE16x4(u8* dst, __m128i v) {
+  // Sign-extend so the signed saturating pack keeps every bit
+  v = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+  v = _mm_packs_epi32(v, v);
+  v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), v);
+}
+#endif
+
+//! Intensities of `count` RGBA pixels; `count` is a multiple of 4
+static inline void LuminosityRow(const u8* src, u8* dst, u32 count) {
+#ifdef LIBRII_IMAGE_SSE2
+  for (u32 i = 0; i < count; i += 4) {
+    const u32 l = PackBytes4(Luminosity4(Channels4(src + i * 4)));
+    memcpy(dst + i, &l, 4);
   }
+#else
+  for (u32 i = 0; i < count; ++i)
+    dst[i] = luminosity(src + i * 4);
+#endif
+}
+
+//! @brief Encode an image a row of tiles at a time, spreading rows across the
+//! shared thread pool for large images.
+//!
+//! `encode_row(dst, y)` writes the row of tiles starting at pixel row `y`.
+//! `num_threads` of 1 keeps the work on the calling thread.
+template <typename F>
+static void EncodeTileRows(u8* dst, u32 width, u32 height, u32 tile_w,
+                           u32 tile_h, u32 tile_size, u32 num_threads,
+                           F encode_row) {
+  const u32 tiles_x = (width + tile_w - 1) / tile_w;
+  const u32 tiles_y = (height + tile_h - 1) / tile_h;
+  const u32 row_size = tiles_x * tile_size;
+
+  constexpr u32 TilesPerTask = 2048;
+  const u32 rows_per_task = std::max(1u, TilesPerTask / std::max(tiles_x, 1u));
+  rsl::ParallelFor(
+      tiles_y, rows_per_task,
+      [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t)
+          encode_row(dst + t * row_size, t * tile_h);
+      },
+      num_threads);
 }
-void encodeI8(u8* dst, const u32* src, u32 width, u32 height) {
-  for (int y = 0; y < height; y += 4) {
-    for (int x = 0; x < width; x += 8) {
-      // Encode the 4x8 block
-      // There are 4 rows (8 bits wide) and 4 columns
-      // Same block size as I4
-
-      for (int row = 0; row < 4; ++row) {
-        for (int column = 0; column < 8; ++column) {
-          rgba _rgba = *(rgba*)&src[(y + row) * width + x + column];
-          dst[column] = luminosity(_rgba);
+
+void encodeI4(u8* dst, const u32* src4, u32 width, u32 height, u32 threads) {
+  const u8* src = reinterpret_cast<const u8*>(src4);
+  // 8x8 tiles: 8 rows of 8 pixels, two to a byte
+  EncodeTileRows(dst, width, height, 8, 8, 32, threads, [&](u8* out, u32 y) {
+    for (u32 x = 0; x < width; x += 8) {
+      for (u32 row = 0; row < 8; ++row) {
+        u8 l[8];
+        LuminosityRow(src + ((y + row) * width + x) * 4, l, 8);
+        for (u32 column = 0; column < 4; ++column) {
+          out[column] =
+              (l[column * 2] & 0b11'11'00'00) | (l[column * 2 + 1] >> 4);
         }
-        dst += 8;
+        out += 4;
       }
     }
-  }
+  });
 }
-void encodeIA4(u8* dst, const u32* src, u32 width, u32 height) {
-  for (int y = 0; y < height; y += 4) {
-    for (int x = 0; x < width; x += 8) {
-      // Encode the 4x8 block
-      // There are 4 rows (8 bits wide) and 4 columns
-      // Same block size as I4
-
-      for (int row = 0; row < 4; ++row) {
-        for (int column = 0; column < 8; ++column) {
-          rgba _rgba = *(rgba*)&src[(y + row) * width + x + column];
-          dst[column] = (luminosity(_rgba) & 0b11'11'00'00) | (_rgba.a >> 4);
-        }
-        dst += 8;
+void encodeI8(u8* dst, const u32* src4, u32 width, u32 height, u32 threads) {
+  const u8* src = reinterpret_cast<const u8*>(src4);
+  // 8x4 tiles
+  EncodeTileRows(dst, width, height, 8, 4, 32, threads, [&](u8* out, u32 y) {
+    for (u32 x = 0; x < width; x += 8) {
+      for (u32 row = 0; row < 4; ++row) {
+        LuminosityRow(src + ((y + row) * width + x) * 4, out, 8);
+        out += 8;
       }
     }
-  }
+  });
 }
-void encodeIA8(u8* dst, const u32* src, u32 width, u32 height) {
-  for (int y = 0; y < height; y += 4) {
-    for (int x = 0; x < width; x += 4) {
-
-      for (int row = 0; row < 4; ++row) {
-        for (int column = 0; column < 4; ++column) {
-          rgba c = *(rgba*)&src[(y + row) * width + x + column];
-          dst[column * 2] = luminosity(c) << 8;
-          dst[column * 2 + 1] = c.a;
+void encodeIA4(u8* dst, const u32* src4, u32 width, u32 height, u32 threads) {
+  const u8* src = reinterpret_cast<const u8*>(src4);
+  // 8x4 tiles
+  EncodeTileRows(dst, width, height, 8, 4, 32, threads, [&](u8* out, u32 y) {
+    for (u32 x = 0; x < width; x += 8) {
+      for (u32 row = 0; row < 4; ++row) {
+        const u8* line = src + ((y + row) * width + x) * 4;
+        LuminosityRow(line, out, 8);
+        for (u32 column = 0; column < 8; ++column) {
+          const u8 alpha = line[column * 4 + 3];
+          out[column] = (out[column] & 0b11'11'00'00) | (alpha >> 4);
         }
-        dst += 8;
+        out += 8;
       }
     }
-  }
+  });
 }
-
-void encodeRGB565(u8* dst, const u32* src, u32 width, u32 height) {
-  for (int y = 0; y < height; y += 4) {
-    for (int x = 0; x < width; x += 4) {
-
-      for (int row = 0; row < 4; ++row) {
-        for (int column = 0; column < 4; ++column) {
-          rgba c = *(rgba*)&src[(y + row) * width + x + column];
-          u16 packed =
-              ((c.r & 0xf8) << 8) | ((c.g & 0xfc) << 3) | ((c.b & 0xf8) >> 3);
-          dst[column * 2] = packed >> 8;
-          dst[column * 2 + 1] = packed & 0xFF;
+void encodeIA8(u8* dst, const u32* src4, u32 width, u32 height, u32 threads) {
+  const u8* src = reinterpret_cast<const u8*>(src4);
+  // 4x4 tiles of alpha, intensity pairs
+  EncodeTileRows(dst, width, height, 4, 4, 32, threads, [&](u8* out, u32 y) {
+    for (u32 x = 0; x < width; x += 4) {
+      for (u32 row = 0; row < 4; ++row) {
+        const u8* line = src + ((y + row) * width + x) * 4;
+        u8 l[4];
+        LuminosityRow(line, l, 4);
+        for (u32 column = 0; column < 4; ++column) {
+          out[column * 2] = line[column * 4 + 3];
+          out[column * 2 + 1] = l[column];
         }
-        dst += 8;
+        out += 8;
       }
     }
-  }
+  });
 }
 
-void encodeRGB5A3(u8* dst, const u32* src, u32 width, u32 height) {
-  for (int y = 0; y < height; y += 4) {
-    for (int x = 0; x < width; x += 4) {
-
-      for (int row = 0; row < 4; ++row) {
-        for (int column = 0; column < 4; ++column) {
-          rgba c = *(rgba*)&src[(y + row) * width + x + column];
-          u16 packed = 0;
-          if (c.a < 0xe0)
-            packed = ((c.a & 0xe0) << 7) | ((c.r & 0xf0) << 4) | (c.g & 0xf0) |
-                     ((c.b & 0xf0) >> 4);
-          else
-            packed = 0x8000 | ((c.r & 0xf8) << 7) | ((c.g & 0xf8) << 2) |
-                     ((c.b & 0xf8) >> 3);
-          dst[column * 2] = packed >> 8;
-          dst[column * 2 + 1] = packed & 0xFF;
+void encodeRGB565(u8* dst, const u32* src4, u32 width, u32 height,
+                  u32 threads) {
+  const u8* src = reinterpret_cast<const u8*>(src4);
+  EncodeTileRows(dst, width, height, 4, 4, 32, threads, [&](u8* out, u32 y) {
+    for (u32 x = 0; x < width; x += 4) {
+      for (u32 row = 0; row < 4; ++row) {
+        const u8* line = src + ((y + row) * width + x) * 4;
+#ifdef LIBRII_IMAGE_SSE2
+        const Channels4 c(line);
+        const __m128i packed = _mm_or_si128(
+            _mm_or_si128(
+                _mm_slli_epi32(_mm_and_si128(c.r, _mm_set1_epi32(0xf8)), 8),
+                _mm_slli_epi32(_mm_and_si128(c.g, _mm_set1_epi32(0xfc)), 3)),
+            _mm_srli_epi32(c.b, 3));
+        StoreBE16x4(out, packed);
+#else
+        for (u32 column = 0; column < 4; ++column) {
+          const u8* c = line + column * 4;
+          const u16 packed =
+              ((c[0] & 0xf8) << 8) | ((c[1] & 0xfc) << 3) | (c[2] >> 3);
+          out[column * 2] = packed >> 8;
+          out[column * 2 + 1] = packed & 0xFF;
         }
-        dst += 8;
+#endif
+        out += 8;
       }
     }
-  }
+  });
 }
 
-void encodeRGBA8(u8* dst, const u32* src4, u32 width, u32 height) {
-#if 0
-  for (int y = 0; y < height; y += 4) {
-    for (int x = 0; x < width; x += 4) {
-
-      for (int row = 0; row < 2; ++row) {
-        for (int column = 0; column < 4; ++column) {
-          rgba c = *(rgba*)&src[(y + row) * width + x + column];
-          rgba c2 = *(rgba*)&src[(y + row) * width + x + column + 16];
-          dst[column * 4] = c.a;
-          dst[column * 4 + 1] = c2.g;
-          dst[column * 4 + 2] = c2.b;
-          dst[column * 4 + 3] = c.r;
+void encodeRGB5A3(u8* dst, const u32* src4, u32 width, u32 height,
+                  u32 threads) {
+  const u8* src = reinterpret_cast<const u8*>(src4);
+  EncodeTileRows(dst, width, height, 4, 4, 32, threads, [&](u8* out, u32 y) {
+    for (u32 x = 0; x < width; x += 4) {
+      for (u32 row = 0; row < 4; ++row) {
+        const u8* line = src + ((y + row) * width + x) * 4;
+#ifdef LIBRII_IMAGE_SSE2
+        const Channels4 c(line);
+        auto bits = [](__m128i v, int mask, int shift) {
+          v = _mm_and_si128(v, _mm_set1_epi32(mask));
+          return shift >= 0 ? _mm_slli_epi32(v, shift)
+                            : _mm_srli_epi32(v, -shift);
+        };
+        const __m128i translucent = _mm_or_si128(
+            _mm_or_si128(bits(c.a, 0xe0, 7), bits(c.r, 0xf0, 4)),
+            _mm_or_si128(bits(c.g, 0xf0, 0), bits(c.b, 0xf0, -4)));
+        const __m128i opaque = _mm_or_si128(
+            _mm_or_si128(_mm_set1_epi32(0x8000), bits(c.r, 0xf8, 7)),
+            _mm_or_si128(bits(c.g, 0xf8, 2), bits(c.b, 0xf8, -3)));
+        const __m128i is_translucent =
+            _mm_cmplt_epi32(c.a, _mm_set1_epi32(0xe0));
+        StoreBE16x4(out,
+                    _mm_or_si128(_mm_and_si128(is_translucent, translucent),
+                                 _mm_andnot_si128(is_translucent, opaque)));
+#else
+        for (u32 column = 0; column < 4; ++column) {
+          const u8* c = line + column * 4;
+          const u16 translucent = ((c[3] & 0xe0) << 7) | ((c[0] & 0xf0) << 4) |
+                                  (c[1] & 0xf0) | ((c[2] & 0xf0) >> 4);
+          const u16 opaque = 0x8000 | ((c[0] & 0xf8) << 7) |
+                             ((c[1] & 0xf8) << 2) | ((c[2] & 0xf8) >> 3);
+          const u16 packed = c[3] < 0xe0 ? translucent : opaque;
+          out[column * 2] = packed >> 8;
+          out[column * 2 + 1] = packed & 0xFF;
         }
-        dst += 64;
+#endif
+        out += 8;
       }
     }
-  }
-#endif
+  });
+}
+
+void encodeRGBA8(u8* dst, const u32* src4, u32 width, u32 height, u32 threads) {
   // From MP
   const u8* src = reinterpret_cast<const u8*>(src4);
-  for (uint16_t block = 0; block < height; block += 4) {
-    for (uint16_t i = 0; i < width; i += 4) {
-
-      for (uint32_t c = 0; c < 4; c++) {
-        uint32_t blockWid = (((block + c) * width) + i) << 2;
-
-        *dst++ = src[blockWid + 3]; // ar = 0
-        *dst++ = src[blockWid + 0];
-        *dst++ = src[blockWid + 7]; // ar = 1
-        *dst++ = src[blockWid + 4];
-        *dst++ = src[blockWid + 11]; // ar = 2
-        *dst++ = src[blockWid + 8];
-        *dst++ = src[blockWid + 15]; // ar = 3
-        *dst++ = src[blockWid + 12];
-      }
-      for (uint32_t c = 0; c < 4; c++) {
-        uint32_t blockWid = (((block + c) * width) + i) << 2;
-
-        *dst++ = src[blockWid + 1]; // gb = 0
-        *dst++ = src[blockWid + 2];
-        *dst++ = src[blockWid + 5]; // gb = 1
-        *dst++ = src[blockWid + 6];
-        *dst++ = src[blockWid + 9]; // gb = 2
-        *dst++ = src[blockWid + 10];
-        *dst++ = src[blockWid + 13]; // gb = 3
-        *dst++ = src[blockWid + 14];
+  // 4x4 tiles: the AR half, then the GB half
+  EncodeTileRows(dst, width, height, 4, 4, 64, threads, [&](u8* out, u32 y) {
+    for (u32 x = 0; x < width; x += 4) {
+      for (u32 c = 0; c < 4; c++) {
+        const u8* line = src + (((y + c) * width) + x) * 4;
+#ifdef LIBRII_IMAGE_SSSE3
+        // AR pairs to the low half, GB pairs to the high half
+        const __m128i split = _mm_shuffle_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(line)),
+            _mm_setr_epi8(3, 0, 7, 4, 11, 8, 15, 12, 1, 2, 5, 6, 9, 10, 13,
+                          14));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + c * 8), split);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 32 + c * 8),
+                         _mm_unpackhi_epi64(split, split));
+#else
+        for (u32 i = 0; i < 4; i++) {
+          out[c * 8 + i * 2] = line[i * 4 + 3];
+          out[c * 8 + i * 2 + 1] = line[i * 4 + 0];
+          out[32 + c * 8 + i * 2] = line[i * 4 + 1];
+          out[32 + c * 8 + i * 2 + 1] = line[i * 4 + 2];
+        }
+#endif
       }
+      out += 64;
     }
-  }
+  });
 }
 
 // raw 8-bit RGBA -> X
 void encode(u8* dst, const u8* src, int width, int height,
-            gx::TextureFormat texformat) {
+            gx::TextureFormat texformat, CmprQuality quality,
+            u32 num_threads) {
   if (texformat == gx::TextureFormat::CMPR) {
-    EncodeDXT1(dst, src, width, height);
+    EncodeDXT1(dst, src, width, height, quality, num_threads);
     return;
   }
 
   if (texformat == gx::TextureFormat::I4) {
-    encodeI4(dst, (const u32*)src, width, height);
+    encodeI4(dst, (const u32*)src, width, height, num_threads);
     return;
   }
 
   if (texformat == gx::TextureFormat::I8) {
-    encodeI8(dst, (const u32*)src, width, height);
+    encodeI8(dst, (const u32*)src, width, height, num_threads);
     return;
   }
 
   if (texformat == gx::TextureFormat::IA4) {
-    encodeIA4(dst, (const u32*)src, width, height);
+    encodeIA4(dst, (const u32*)src, width, height, num_threads);
     return;
   }
 
   if (texformat == gx::TextureFormat::IA8) {
-    encodeIA8(dst, (const u32*)src, width, height);
+    encodeIA8(dst, (const u32*)src, width, height, num_threads);
     return;
   }
 
   if (texformat == gx::TextureFormat::RGB565) {
-    encodeRGB565(dst, (const u32*)src, width, height);
+    encodeRGB565(dst, (const u32*)src, width, height, num_threads);
     return;
   }
 
   if (texformat == gx::TextureFormat::RGB5A3) {
-    encodeRGB5A3(dst, (const u32*)src, width, height);
+    encodeRGB5A3(dst, (const u32*)src, width, height, num_threads);
     return;
   }
 
   if (texformat == gx::TextureFormat::RGBA8) {
-    encodeRGBA8(dst, (const u32*)src, width, height);
+    encodeRGBA8(dst, (const u32*)src, width, height, num_threads);
     return;
   }
 
@@ -331,11 +442,12 @@ struct RGBA32ImageTarget {
   RGBA32ImageTarget(int w, int h) : mW(w), mH(h) {
     mTmp.resize(roundUp(w, 32) * roundUp(h, 32) * 4);
   }
-  void copyTo(u8* dst, gx::TextureFormat fmt) {
+  void copyTo(u8* dst, gx::TextureFormat fmt, CmprQuality quality,
+              u32 num_threads) {
     if (fmt == gx::TextureFormat::Extension_RawRGBA32) {
       memcpy(dst, mTmp.data(), mTmp.size());
     } else {
-      encode(dst, mTmp.data(), mW, mH, fmt);
+      encode(dst, mTmp.data(), mW, mH, fmt, quality, num_threads);
     }
   }
   void fromOtherSized(std::span<const u8> src, u32 ow, u32 oh,
@@ -360,10 +472,121 @@ private:
   int mW;
   int mH;
 };
+//! @brief Run `level_fn(i, encoder_threads)` for each level of a mip chain,
+//! spreading levels over the shared thread pool.
+//!
+//! Levels run concurrently, so each is encoded on its own worker
+//! (`encoder_threads` is 1); a lone level gets every thread instead.
+template <typename F> static void ForEachLevel(u32 mipMapCount, F level_fn) {
+  if (mipMapCount == 0) {
+    level_fn(0, 0);
+    return;
+  }
+  rsl::ParallelFor(mipMapCount + 1, 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      level_fn(static_cast<u32>(i), 1);
+  });
+}
+
+void generateMipChain(u8* dst, int dwidth, int dheight,
+                      gx::TextureFormat format, const u8* src, int swidth,
+                      int sheight, u32 mipMapCount, ResizingAlgorithm algorithm,
+                      MipSource mipSource, CmprQuality quality) {
+  assert(dst && src);
+  assert(dwidth > 0 && dheight > 0);
+  assert(swidth > 0 && sheight > 0);
+  const bool raw = format == gx::TextureFormat::Extension_RawRGBA32;
+  const auto raw_fmt = gx::TextureFormat::Extension_RawRGBA32;
+
+  // Raw levels are laid out like an encoded raw chain; when the output is
+  // raw, they are generated in place.
+  std::vector<u8> levels;
+  u8* pLevels = dst;
+  if (!raw) {
+    levels.resize(getEncodedSize(dwidth, dheight, raw_fmt, mipMapCount));
+    pLevels = levels.data();
+  }
+  auto level_data = [&](u8* base, gx::TextureFormat fmt, u32 i) {
+    return base + (i == 0 ? 0 : getEncodedSize(dwidth, dheight, fmt, i - 1));
+  };
+  auto scale = [&](u32 i, const u8* from, int fw, int fh) {
+    u8* to = level_data(pLevels, raw_fmt, i);
+    if (fw == (dwidth >> i) && fh == (dheight >> i))
+      memcpy(to, from, fw * fh * 4);
+    else
+      resize(to, dwidth >> i, dheight >> i, from, fw, fh, algorithm);
+  };
+  auto encode_level = [&](u32 i, u32 num_threads) {
+    if (raw)
+      return;
+    const u32 w = dwidth >> i;
+    const u32 h = dheight >> i;
+    const u8* level = level_data(pLevels, raw_fmt, i);
+    // Levels smaller than a tile are padded with their edge pixels, as the
+    // encoders work on whole tiles.
+    const auto info = gx::getFormatInfo(static_cast<u32>(format));
+    const u32 tw = roundUp(w, 1 << info.xshift);
+    const u32 th = roundUp(h, 1 << info.yshift);
+    std::vector<u8> padded;
+    if (tw != w || th != h) {
+      padded.resize(tw * th * 4);
+      for (u32 y = 0; y < th; ++y)
+        for (u32 x = 0; x < tw; ++x)
+          memcpy(&padded[(y * tw + x) * 4],
+                 &level[(std::min(y, h - 1) * w + std::min(x, w - 1)) * 4], 4);
+      level = padded.data();
+    }
+    encode(level_data(dst, format, i), level, tw, th, format, quality,
+           num_threads);
+  };
+
+  if (mipSource == MipSource::Base) {
+    ForEachLevel(mipMapCount, [&](u32 i, u32 num_threads) {
+      scale(i, src, swidth, sheight);
+      encode_level(i, num_threads);
+    });
+    return;
+  }
+
+  // Each level depends on the last: scale them in order, then encode them
+  // concurrently.
+  for (u32 i = 0; i <= mipMapCount; ++i) {
+    if (i == 0)
+      scale(0, src, swidth, sheight);
+    else
+      scale(i, level_data(pLevels, raw_fmt, i - 1), dwidth >> (i - 1),
+            dheight >> (i - 1));
+  }
+  ForEachLevel(mipMapCount, encode_level);
+}
+
+//! @brief transform() for a single level, with no mipmaps.
+static void transformLevel(u8* dst, int dwidth, int dheight,
+                           gx::TextureFormat oldformat,
+                           gx::TextureFormat newformat, const u8* src,
+                           int swidth, int sheight,
+                           ResizingAlgorithm algorithm, CmprQuality quality,
+                           u32 num_threads) {
+  if (swidth <= 4 || sheight <= 4 || dwidth <= 0 || dheight <= 0)
+    return;
+
+  RGBA32ImageSource source(src, swidth, sheight, oldformat);
+  assert(source.get().data());
+
+  // TODO: We don't always need to allocate this
+  RGBA32ImageTarget target(dwidth, dheight);
+  assert(target.get().data());
+
+  target.fromOtherSized(source, algorithm);
+
+  // TODO: A copy here can be prevented
+  target.copyTo(dst, newformat, quality, num_threads);
+}
+
 void transform(u8* dst, int dwidth, int dheight, gx::TextureFormat oldformat,
                std::optional<gx::TextureFormat> newformat, const u8* src,
                int swidth, int sheight, u32 mipMapCount,
-               ResizingAlgorithm algorithm) {
+               ResizingAlgorithm algorithm, CmprQuality quality) {
   printf(
       "Transform: Dest={%p, w:%i, h:%i}, Source={%p, w:%i, h:%i}, NumMip=%u\n",
       dst, dwidth, dheight, src, swidth, sheight, mipMapCount);
@@ -394,34 +617,20 @@ void transform(u8* dst, int dwidth, int dheight, gx::TextureFormat oldformat,
       pSrc = src;
     }
     assert(pSrc);
-    transform(dst, dwidth, dheight, oldformat, newformat, pSrc, swidth, sheight,
-              0, algorithm);
-    for (u32 i = 1; i <= mipMapCount; ++i) {
+    // Levels are independent: transform them concurrently, largest first
+    ForEachLevel(mipMapCount, [&](u32 i, u32 num_threads) {
       const auto src_lod_ofs =
-          getEncodedSize(swidth, sheight, oldformat, i - 1);
+          i == 0 ? 0 : getEncodedSize(swidth, sheight, oldformat, i - 1);
       const auto dst_lod_ofs =
-          getEncodedSize(dwidth, dheight, newformat.value(), i - 1);
-      const auto src_lod_x = swidth >> i;
-      const auto src_lod_y = sheight >> i;
-      auto dst_lod_x = dwidth >> i;
-      auto dst_lod_y = dheight >> i;
-
-      transform(dst + dst_lod_ofs, dst_lod_x, dst_lod_y, oldformat,
-                newformat.value(), pSrc + src_lod_ofs, src_lod_x, src_lod_y, 0,
-                algorithm);
-    }
-  } else if (swidth > 4 && sheight > 4) {
-    RGBA32ImageSource source(src, swidth, sheight, oldformat);
-    assert(source.get().data());
-
-    // TODO: We don't always need to allocate this
-    RGBA32ImageTarget target(dwidth, dheight);
-    assert(target.get().data());
-
-    target.fromOtherSized(source, algorithm);
-
-    // TODO: A copy here can be prevented
-    target.copyTo(dst, newformat.value());
+          i == 0 ? 0
+                 : getEncodedSize(dwidth, dheight, newformat.value(), i - 1);
+      transformLevel(dst + dst_lod_ofs, dwidth >> i, dheight >> i, oldformat,
+                     newformat.value(), pSrc + src_lod_ofs, swidth >> i,
+                     sheight >> i, algorithm, quality, num_threads);
+    });
+  } else {
+    transformLevel(dst, dwidth, dheight, oldformat, newformat.value(), src,
+                   swidth, sheight, algorithm, quality, 0);
   }
 }
 
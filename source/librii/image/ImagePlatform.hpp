@@ -6,6 +6,7 @@
 #include <tuple>
 
 #include <librii/gx.h>
+#include <librii/image/CmprEncoder.hpp>
 
 namespace librii::image {
 
@@ -60,12 +61,16 @@ void decode(u8* dst, const u8* src, int width, int height,
 //! @param[in] width The width of the image in pixels.
 //! @param[in] height The height of the image in pixels.
 //! @param[in] texformat The format of the image.
+//! @param[in] quality CMPR endpoint search; ignored for other formats.
+//! @param[in] num_threads Large images are split across this many threads of
+//! the shared pool (0: every hardware thread, 1: the calling thread only).
 //!
 //! @pre For efficiency reasons, this method does not handle the case where dst
 //! == src.
 //!
 void encode(u8* dst, const u8* src, int width, int height,
-            gx::TextureFormat texformat);
+            gx::TextureFormat texformat,
+            CmprQuality quality = CmprQuality::Exhaustive, u32 num_threads = 0);
 
 //! @brief Specifies an algorithm for downscaling/upscaling an image.
 //!
@@ -86,6 +91,41 @@ enum ResizingAlgorithm { AVIR, Lanczos };
 void resize(u8* dst, int dx, int dy, const u8* src, int sx, int sy,
             ResizingAlgorithm type = ResizingAlgorithm::AVIR);
 
+//! @brief Specifies what each level of a generated mip chain is scaled from.
+//!
+enum class MipSource {
+  Base,    //!< The source image: sharpest, levels are built concurrently.
+  Previous //!< The level above: cheaper to scale, but scaled in sequence.
+};
+
+//! @brief Generate a mip chain from a raw, 8-bit RGBA image and encode it.
+//!
+//! Levels are scaled and encoded concurrently on the shared thread pool,
+//! straight into `dst`; each level is encoded on a single thread.
+//!
+//! @param[in] dst         The destination pointer. Must be sized
+//! getEncodedSize(dx, dy, format, mipMapCount).
+//! @param[in] dx          Width of the base level in pixels.
+//! @param[in] dy          Height of the base level in pixels.
+//! @param[in] format      Format of the target data.
+//! gx::TextureFormat::Extension_RawRGBA32 may be passed in to indicate raw
+//! data.
+//! @param[in] src         Pointer to the raw source image. May not overlap
+//! dst.
+//! @param[in] sx          Width of the source image in pixels.
+//! @param[in] sy          Height of the source image in pixels.
+//! @param[in] mipMapCount Number of additional levels of detail past the
+//! first image.
+//! @param[in] algorithm   Algorithm to utilize for downscaling.
+//! @param[in] mipSource   What each level is scaled from.
+//! @param[in] quality     CMPR endpoint search.
+//!
+void generateMipChain(u8* dst, int dx, int dy, gx::TextureFormat format,
+                      const u8* src, int sx, int sy, u32 mipMapCount,
+                      ResizingAlgorithm algorithm = ResizingAlgorithm::AVIR,
+                      MipSource mipSource = MipSource::Base,
+                      CmprQuality quality = CmprQuality::Exhaustive);
+
 //! @brief Perform a composite transformation on image data, with mipmap
 //! support.
 //!
@@ -108,12 +148,14 @@ void resize(u8* dst, int dx, int dy, const u8* src, int sx, int sy,
 //! @param[in] mipMapCount	Number of additional levels of detail past the
 //! first image. Zero corresponds to the base image--no mipmapping.
 //! @param[in] algorithm	Algorithm to utilize for upscaling/downscaling.
+//! @param[in] quality		CMPR endpoint search, when encoding to CMPR.
 //!
 void transform(
     u8* dst, int dx, int dy,
     gx::TextureFormat oldformat = gx::TextureFormat::Extension_RawRGBA32,
     std::optional<gx::TextureFormat> newformat = std::nullopt,
     const u8* src = nullptr, int sx = -1, int sy = -1, u32 mipMapCount = 0,
-    ResizingAlgorithm algorithm = ResizingAlgorithm::AVIR);
+    ResizingAlgorithm algorithm = ResizingAlgorithm::AVIR,
+    CmprQuality quality = CmprQuality::Exhaustive);
 
 } // namespace librii::image
@@ -0,0 +1,471 @@
+#include "Builder.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <limits>
+#include <map>
+#include <rsl/ParallelFor.hpp>
+#include <unordered_map>
+
+namespace librii::kcol {
+
+namespace {
+
+//! Exact (bitwise) key for deduplicating vectors
+struct VecKey {
+  std::array<u32, 3> bits;
+
+  explicit VecKey(const glm::vec3& v)
+      : bits{std::bit_cast<u32>(v.x), std::bit_cast<u32>(v.y),
+             std::bit_cast<u32>(v.z)} {}
+  bool operator==(const VecKey&) const = default;
+};
+struct VecKeyHash {
+  size_t operator()(const VecKey& k) const {
+    u64 h = k.bits[0];
+    h = h * 0x9E3779B97F4A7C15ull ^ k.bits[1];
+    h = h * 0x9E3779B97F4A7C15ull ^ k.bits[2];
+    return static_cast<size_t>(h ^ (h >> 29));
+  }
+};
+
+class VectorPool {
+public:
+  VectorPool(std::vector<glm::vec3>& out) : mOut(out) {}
+
+  //! Returns the index of `v`, or -1 if the pool is full (indices are u16)
+  int insert(const glm::vec3& v) {
+    auto [it, inserted] =
+        mIndices.emplace(VecKey(v), static_cast<u32>(mOut.size()));
+    if (inserted) {
+      if (mOut.size() > 0xFFFF) {
+        mIndices.erase(it);
+        return -1;
+      }
+      mOut.push_back(v);
+    }
+    return static_cast<int>(it->second);
+  }
+
+private:
+  std::vector<glm::vec3>& mOut;
+  std::unordered_map<VecKey, u32, VecKeyHash> mIndices;
+};
+
+//! A prism in world space, for intersection tests against cubes
+struct BuildPrism {
+  //! Top face; the bottom face is this pushed down by `depth`
+  std::array<glm::vec3, 3> verts;
+  glm::vec3 fnrm;
+  glm::vec3 depth;
+  std::array<glm::vec3, 3> enrm;
+  std::array<glm::vec3, 3> edges;
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+void ProjectPrism(const BuildPrism& prism, const glm::vec3& axis, float& lo,
+                  float& hi) {
+  const float a = glm::dot(prism.verts[0], axis);
+  const float b = glm::dot(prism.verts[1], axis);
+  const float c = glm::dot(prism.verts[2], axis);
+  lo = std::min({a, b, c});
+  hi = std::max({a, b, c});
+  const float d = glm::dot(prism.depth, axis);
+  if (d > 0.0f)
+    lo -= d;
+  else
+    hi -= d;
+}
+
+bool Contains(const glm::vec3& box_min, const glm::vec3& box_max,
+              const glm::vec3& p) {
+  return p.x >= box_min.x && p.y >= box_min.y && p.z >= box_min.z &&
+         p.x <= box_max.x && p.y <= box_max.y && p.z <= box_max.z;
+}
+
+//! Separating axis test of a convex prism against an axis-aligned box
+bool PrismIntersectsBox(const BuildPrism& prism, const glm::vec3& box_min,
+                        const glm::vec3& box_max) {
+  for (int i = 0; i < 3; ++i) {
+    if (prism.max[i] < box_min[i] || prism.min[i] > box_max[i])
+      return false;
+  }
+  // Cheap accept: small triangles usually have a corner inside the box
+  for (const auto& v : prism.verts) {
+    if (Contains(box_min, box_max, v))
+      return true;
+  }
+
+  const glm::vec3 center = (box_min + box_max) * 0.5f;
+  const glm::vec3 half = (box_max - box_min) * 0.5f;
+
+  auto separated = [&](const glm::vec3& axis) {
+    if (glm::dot(axis, axis) < 1e-12f)
+      return false;
+    float lo, hi;
+    ProjectPrism(prism, axis, lo, hi);
+    const float c = glm::dot(center, axis);
+    const float r = half.x * std::abs(axis.x) + half.y * std::abs(axis.y) +
+                    half.z * std::abs(axis.z);
+    return hi < c - r || lo > c + r;
+  };
+
+  if (separated(prism.fnrm))
+    return false;
+  for (const auto& n : prism.enrm) {
+    if (separated(n))
+      return false;
+  }
+  const std::array<glm::vec3, 4> prism_edges{prism.edges[0], prism.edges[1],
+                                             prism.edges[2], prism.fnrm};
+  for (int i = 0; i < 3; ++i) {
+    glm::vec3 box_edge{0.0f};
+    box_edge[i] = 1.0f;
+    for (const auto& e : prism_edges) {
+      if (separated(glm::cross(box_edge, e)))
+        return false;
+    }
+  }
+  return true;
+}
+
+// A cube is either a leaf (`index` into BuildTree::lists) or a branch (`index`
+// of the first of its eight consecutive children)
+struct BuildNode {
+  bool leaf = true;
+  u32 index = 0;
+};
+
+//! The octree under one root block
+struct BuildTree {
+  std::vector<BuildNode> nodes;
+  std::vector<std::vector<u16>> lists;
+};
+
+class TreeBuilder {
+public:
+  TreeBuilder(std::span<const BuildPrism> prisms,
+              const KCollisionBuildOptions& options)
+      : mPrisms(prisms), mOptions(options) {}
+
+  //! `candidates` must already be filtered against the root cube
+  BuildTree build(const glm::vec3& origin, u32 shift,
+                  std::vector<u32> candidates) {
+    BuildTree tree;
+    tree.nodes.emplace_back();
+    subdivide(tree, 0, origin, shift, 0, std::move(candidates));
+    return tree;
+  }
+
+private:
+  void makeLeaf(BuildTree& tree, u32 node, const std::vector<u32>& prisms) {
+    std::vector<u16> list(prisms.size());
+    // Prism indices are 1-based in the file
+    for (size_t i = 0; i < prisms.size(); ++i)
+      list[i] = static_cast<u16>(prisms[i] + 1);
+    tree.nodes[node] = {.leaf = true,
+                        .index = static_cast<u32>(tree.lists.size())};
+    tree.lists.push_back(std::move(list));
+  }
+
+  void subdivide(BuildTree& tree, u32 node, const glm::vec3& origin,
+                 u32 shift, u32 depth, std::vector<u32> prisms) {
+    if (prisms.size() <= mOptions.max_triangles_per_leaf ||
+        depth >= mOptions.max_depth || shift <= mOptions.min_cube_shift) {
+      makeLeaf(tree, node, prisms);
+      return;
+    }
+
+    const u32 child_shift = shift - 1;
+    const float child_width = static_cast<float>(1u << child_shift);
+    std::array<std::vector<u32>, 8> children;
+    std::array<glm::vec3, 8> child_origins;
+    size_t total = 0;
+    for (u32 i = 0; i < 8; ++i) {
+      // Child order matches the game: x is bit 0, y bit 1, z bit 2
+      child_origins[i] =
+          origin + glm::vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * child_width;
+      const glm::vec3 lo = child_origins[i] - mOptions.sphere_radius;
+      const glm::vec3 hi =
+          child_origins[i] + child_width + mOptions.sphere_radius;
+      for (u32 p : prisms) {
+        if (PrismIntersectsBox(mPrisms[p], lo, hi))
+          children[i].push_back(p);
+      }
+      total += children[i].size();
+    }
+
+    // Splitting a cube whose prisms mostly span every child only costs space
+    if (static_cast<float>(total) >
+        static_cast<float>(prisms.size() * 8) * mOptions.max_child_share) {
+      makeLeaf(tree, node, prisms);
+      return;
+    }
+
+    const u32 first = static_cast<u32>(tree.nodes.size());
+    tree.nodes[node] = {.leaf = false, .index = first};
+    tree.nodes.resize(first + 8);
+    prisms.clear();
+    prisms.shrink_to_fit();
+    for (u32 i = 0; i < 8; ++i) {
+      subdivide(tree, first + i, child_origins[i], child_shift, depth + 1,
+                std::move(children[i]));
+    }
+  }
+
+  std::span<const BuildPrism> mPrisms;
+  const KCollisionBuildOptions& mOptions;
+};
+
+u32 CeilLog2(float extent) {
+  const auto units = static_cast<u64>(std::ceil(std::max(extent, 1.0f)));
+  return static_cast<u32>(std::bit_width(units - 1));
+}
+
+void StoreBE32(std::vector<u8>& out, size_t offset, u32 value) {
+  out[offset + 0] = static_cast<u8>(value >> 24);
+  out[offset + 1] = static_cast<u8>(value >> 16);
+  out[offset + 2] = static_cast<u8>(value >> 8);
+  out[offset + 3] = static_cast<u8>(value);
+}
+
+//! Lay the trees out as the game expects.
+//!
+//! Nodes are u32 words in groups (the root array, then eight per branch). A
+//! branch holds the offset of its child group; a leaf holds 0x80000000 | the
+//! offset of its prism list minus 2. Both are relative to the group holding
+//! the word. Lists are 0-terminated u16 prism indices, stored after every
+//! group so that all offsets are positive.
+std::vector<u8> SerializeBlocks(std::span<const BuildTree> trees) {
+  struct Group {
+    u32 tree;
+    u32 first_node;
+    u32 base;
+  };
+  std::vector<Group> groups;
+  // Per tree, the offset of the child group of each branch node
+  std::vector<std::vector<u32>> child_pos(trees.size());
+  for (size_t t = 0; t < trees.size(); ++t)
+    child_pos[t].resize(trees[t].nodes.size());
+
+  u32 pos = static_cast<u32>(trees.size() * 4);
+  for (u32 t = 0; t < trees.size(); ++t) {
+    if (trees[t].nodes[0].leaf)
+      continue;
+    child_pos[t][0] = pos;
+    groups.push_back({t, trees[t].nodes[0].index, pos});
+    pos += 32;
+  }
+  for (size_t g = 0; g < groups.size(); ++g) {
+    const auto group = groups[g];
+    for (u32 i = 0; i < 8; ++i) {
+      const auto& node = trees[group.tree].nodes[group.first_node + i];
+      if (node.leaf)
+        continue;
+      child_pos[group.tree][group.first_node + i] = pos;
+      groups.push_back({group.tree, node.index, pos});
+      pos += 32;
+    }
+  }
+
+  // Identical lists are shared. The leading 0 lets the first list be
+  // addressed like every other one.
+  const u32 lists_begin = pos;
+  std::map<std::vector<u16>, u32> list_pos;
+  std::vector<u16> list_data{0};
+  auto leaf_word = [&](const BuildTree& tree, const BuildNode& node,
+                       u32 base) -> u32 {
+    const auto& list = tree.lists[node.index];
+    auto [it, inserted] = list_pos.emplace(
+        list, lists_begin + static_cast<u32>(list_data.size() * 2));
+    if (inserted) {
+      list_data.insert(list_data.end(), list.begin(), list.end());
+      list_data.push_back(0);
+    }
+    return 0x8000'0000 | (it->second - 2 - base);
+  };
+  auto node_word = [&](u32 t, u32 node, u32 base) -> u32 {
+    const auto& n = trees[t].nodes[node];
+    return n.leaf ? leaf_word(trees[t], n, base) : child_pos[t][node] - base;
+  };
+
+  std::vector<u32> words(pos / 4);
+  for (u32 t = 0; t < trees.size(); ++t)
+    words[t] = node_word(t, 0, 0);
+  for (const auto& group : groups) {
+    for (u32 i = 0; i < 8; ++i) {
+      words[group.base / 4 + i] =
+          node_word(group.tree, group.first_node + i, group.base);
+    }
+  }
+
+  std::vector<u8> out(lists_begin + ((list_data.size() * 2 + 3) & ~3));
+  for (size_t i = 0; i < words.size(); ++i)
+    StoreBE32(out, i * 4, words[i]);
+  for (size_t i = 0; i < list_data.size(); ++i) {
+    out[lists_begin + i * 2] = static_cast<u8>(list_data[i] >> 8);
+    out[lists_begin + i * 2 + 1] = static_cast<u8>(list_data[i]);
+  }
+  return out;
+}
+
+} // namespace
+
+std::string BuildKCollisionData(KCollisionData& data,
+                                std::span<const KCollisionTriangle> tris,
+                                const KCollisionBuildOptions& options) {
+  data.pos_data.clear();
+  data.nrm_data.clear();
+  data.prism_data.clear();
+  data.block_data.clear();
+  data.prism_thickness = options.prism_thickness;
+  data.sphere_radius = options.sphere_radius;
+
+  VectorPool positions(data.pos_data);
+  VectorPool normals(data.nrm_data);
+  std::vector<BuildPrism> prisms;
+  prisms.reserve(tris.size());
+
+  glm::vec3 bb_min{std::numeric_limits<float>::max()};
+  glm::vec3 bb_max{std::numeric_limits<float>::lowest()};
+
+  for (const auto& tri : tris) {
+    const auto& [a, b, c] = tri.verts;
+    const glm::vec3 cross = glm::cross(b - a, c - a);
+    const float len = glm::length(cross);
+    if (!(len > 1e-4f) || !std::isfinite(len))
+      continue; // Degenerate
+
+    BuildPrism prism;
+    prism.fnrm = cross / len;
+    prism.enrm = {glm::normalize(glm::cross(prism.fnrm, c - a)),
+                  glm::normalize(glm::cross(b - a, prism.fnrm)),
+                  glm::normalize(glm::cross(prism.fnrm, b - c))};
+    prism.edges = {b - a, c - b, a - c};
+    const float height = glm::dot(c - a, prism.enrm[2]);
+
+    const int pos_i = positions.insert(a);
+    const int fnrm_i = normals.insert(prism.fnrm);
+    const int enrm1_i = normals.insert(prism.enrm[0]);
+    const int enrm2_i = normals.insert(prism.enrm[1]);
+    const int enrm3_i = normals.insert(prism.enrm[2]);
+    if (pos_i < 0 || fnrm_i < 0 || enrm1_i < 0 || enrm2_i < 0 || enrm3_i < 0)
+      return "Too many unique positions or normals (limit is 65536)";
+    if (data.prism_data.size() >= 0xFFFF)
+      return "Too many triangles (limit is 65535)";
+
+    data.prism_data.push_back(
+        KCollisionPrismData{.height = height,
+                            .pos_i = static_cast<u16>(pos_i),
+                            .fnrm_i = static_cast<u16>(fnrm_i),
+                            .enrm1_i = static_cast<u16>(enrm1_i),
+                            .enrm2_i = static_cast<u16>(enrm2_i),
+                            .enrm3_i = static_cast<u16>(enrm3_i),
+                            .attribute = tri.attribute});
+
+    prism.depth = prism.fnrm * options.prism_thickness;
+    prism.verts = {a, b, c};
+    prism.min = prism.max = a;
+    for (const auto& v : prism.verts) {
+      prism.min = glm::min(prism.min, glm::min(v, v - prism.depth));
+      prism.max = glm::max(prism.max, glm::max(v, v - prism.depth));
+    }
+    bb_min = glm::min(bb_min, prism.min);
+    bb_max = glm::max(bb_max, prism.max);
+    prisms.push_back(prism);
+  }
+
+  if (prisms.empty())
+    bb_min = bb_max = glm::vec3(0.0f);
+
+  // The area is padded so spheres touching the geometry are still inside it
+  const glm::vec3 area_min = glm::floor(bb_min - options.sphere_radius);
+  const glm::vec3 extent = bb_max + options.sphere_radius - area_min;
+  std::array<u32, 3> area_shift;
+  for (int i = 0; i < 3; ++i) {
+    area_shift[i] = std::max(CeilLog2(extent[i]), options.min_cube_shift);
+    if (area_shift[i] > 30)
+      return "Collision is too large";
+  }
+
+  u32 block_shift = std::min({area_shift[0], area_shift[1], area_shift[2]});
+  auto num_roots = [&](u32 shift) -> u64 {
+    return u64(1) << ((area_shift[0] - shift) + (area_shift[1] - shift) +
+                      (area_shift[2] - shift));
+  };
+  while (block_shift > options.min_cube_shift &&
+         num_roots(block_shift - 1) <= options.max_root_blocks)
+    --block_shift;
+
+  data.area_min_pos = area_min;
+  data.area_x_width_mask = ~((1u << area_shift[0]) - 1);
+  data.area_y_width_mask = ~((1u << area_shift[1]) - 1);
+  data.area_z_width_mask = ~((1u << area_shift[2]) - 1);
+  data.block_width_shift = block_shift;
+  data.area_x_blocks_shift = area_shift[0] - block_shift;
+  data.area_xy_blocks_shift =
+      data.area_x_blocks_shift + area_shift[1] - block_shift;
+
+  // Bin prisms into the root blocks their (padded) bounds overlap
+  const std::array<u32, 3> roots_per_axis{1u << (area_shift[0] - block_shift),
+                                          1u << (area_shift[1] - block_shift),
+                                          1u << (area_shift[2] - block_shift)};
+  const float block_width = static_cast<float>(1u << block_shift);
+  std::vector<std::vector<u32>> bins(num_roots(block_shift));
+  for (u32 p = 0; p < prisms.size(); ++p) {
+    std::array<u32, 3> lo, hi;
+    for (int i = 0; i < 3; ++i) {
+      auto cell = [&](float v) {
+        const float f = std::floor((v - area_min[i]) / block_width);
+        return static_cast<u32>(
+            std::clamp(f, 0.0f, static_cast<float>(roots_per_axis[i] - 1)));
+      };
+      lo[i] = cell(prisms[p].min[i] - options.sphere_radius);
+      hi[i] = cell(prisms[p].max[i] + options.sphere_radius);
+    }
+    for (u32 z = lo[2]; z <= hi[2]; ++z)
+      for (u32 y = lo[1]; y <= hi[1]; ++y)
+        for (u32 x = lo[0]; x <= hi[0]; ++x)
+          bins[(z << data.area_xy_blocks_shift) |
+               (y << data.area_x_blocks_shift) | x]
+              .push_back(p);
+  }
+
+  std::vector<BuildTree> trees(bins.size());
+  TreeBuilder builder(prisms, options);
+  auto build_root = [&](u32 r) {
+    const glm::vec3 origin =
+        area_min + glm::vec3(r & (roots_per_axis[0] - 1),
+                             (r >> data.area_x_blocks_shift) &
+                                 (roots_per_axis[1] - 1),
+                             r >> data.area_xy_blocks_shift) *
+                       block_width;
+    const glm::vec3 lo = origin - options.sphere_radius;
+    const glm::vec3 hi = origin + block_width + options.sphere_radius;
+    std::vector<u32> inside;
+    for (u32 p : bins[r]) {
+      if (PrismIntersectsBox(prisms[p], lo, hi))
+        inside.push_back(p);
+    }
+    bins[r] = {};
+    trees[r] = builder.build(origin, block_shift, std::move(inside));
+  };
+
+  // Roots are independent; the layout is done serially afterwards, so the
+  // output does not depend on the thread count
+  rsl::ParallelFor(
+      trees.size(), 1,
+      [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r)
+          build_root(r);
+      },
+      options.num_threads);
+
+  data.block_data = SerializeBlocks(trees);
+  return "";
+}
+
+} // namespace librii::kcol
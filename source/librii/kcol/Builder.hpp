@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Model.hpp"
+#include <array>
+#include <core/common.h>
+#include <glm/vec3.hpp>
+#include <span>
+#include <string>
+
+namespace librii::kcol {
+
+//! Input to BuildKCollisionData
+struct KCollisionTriangle {
+  std::array<glm::vec3, 3> verts;
+  u16 attribute = 0;
+};
+
+struct KCollisionBuildOptions {
+  //! Cubes holding more prisms than this are subdivided
+  u32 max_triangles_per_leaf = 32;
+  //! Maximum number of subdivisions below a root block
+  u32 max_depth = 8;
+  //! Cubes are never smaller than (1 << min_cube_shift) units
+  u32 min_cube_shift = 7;
+  //! Root blocks are shrunk while there are no more than this many
+  u32 max_root_blocks = 4096;
+  //! A cube is only split if its children hold, on average, at most this
+  //! share of its prisms. Lower values give smaller files but longer lists.
+  float max_child_share = 0.35f;
+
+  float prism_thickness = 300.0f;
+  //! Largest sphere the game may query. Cubes list every prism within this
+  //! distance of them.
+  float sphere_radius = 250.0f;
+
+  //! 0 uses every hardware thread
+  u32 num_threads = 0;
+};
+
+//! @brief Build collision from a triangle soup.
+//!
+//! Emits deduplicated positions/normals, one prism per non-degenerate triangle
+//! and the KCollisionV1 octree (`block_data` and the area/shift fields).
+//!
+//! @return An empty string on success, otherwise the reason for failure.
+std::string BuildKCollisionData(KCollisionData& data,
+                                std::span<const KCollisionTriangle> tris,
+                                const KCollisionBuildOptions& options = {});
+
+} // namespace librii::kcol
@@ -1,7 +1,12 @@
 #include "Model.hpp"
 #include <algorithm>
 #include <array>
+#include <bit>
+#include <cassert>
+#include <cstring>
 #include <math.h>
+#include <oishii/util/util.hxx>
+#include <rsl/ParallelFor.hpp>
 
 namespace librii::kcol {
 
@@ -56,6 +61,23 @@ static SectionSizes GetSectionSizes(const KCollisionV1Header& header,
   return {pos_data_size, nrm_data_size, prism_data_size, block_data_size};
 }
 
+//! Decode a big endian Vector3f array into `out` (already sized)
+static bool ReadVectorArray(std::vector<glm::vec3>& out,
+                            std::span<const u8> bytes, size_t offset) {
+  static_assert(sizeof(glm::vec3) == sizeof(Vector3f));
+  const size_t size = out.size() * sizeof(Vector3f);
+  if (offset + size > bytes.size_bytes()) {
+    return false;
+  }
+  if constexpr (std::endian::native == std::endian::big) {
+    std::memcpy(out.data(), bytes.data() + offset, size);
+  } else {
+    oishii::swapEndianArray32(out.data(), bytes.data() + offset,
+                              out.size() * 3);
+  }
+  return true;
+}
+
 std::string ReadKCollisionData(KCollisionData& data, std::span<const u8> bytes,
                                u32 file_size) {
   if (bytes.size_bytes() < file_size) {
@@ -90,37 +112,26 @@ std::string ReadKCollisionData(KCollisionData& data, std::span<const u8> bytes,
   const auto sizes = GetSectionSizes(*header, file_size);
 
   data.pos_data.resize(sizes.pos_data_size / sizeof(Vector3f));
-  for (size_t i = 0; i < data.pos_data.size(); ++i) {
-    auto* pos = rsl::buffer_cast<const Vector3f>(
-        bytes, header->pos_data_offset + i * sizeof(Vector3f));
-    if (pos == nullptr) {
-      return "Bug in reading code";
-    }
-
-    data.pos_data[i] = glm::vec3{pos->x, pos->y, pos->z};
+  if (!ReadVectorArray(data.pos_data, bytes, header->pos_data_offset)) {
+    return "Bug in reading code";
   }
 
   data.nrm_data.resize(sizes.nrm_data_size / sizeof(Vector3f));
-  for (size_t i = 0; i < data.nrm_data.size(); ++i) {
-    auto* nrm = rsl::buffer_cast<const Vector3f>(
-        bytes, header->nrm_data_offset + i * sizeof(Vector3f));
-    if (nrm == nullptr) {
-      return "Bug in reading code";
-    }
-
-    data.nrm_data[i] = glm::vec3{nrm->x, nrm->y, nrm->z};
+  if (!ReadVectorArray(data.nrm_data, bytes, header->nrm_data_offset)) {
+    return "Bug in reading code";
   }
 
-  data.prism_data.resize(sizes.prism_data_size / sizeof(KCollisionPrismData));
-  for (size_t i = 0; i < data.prism_data.size(); ++i) {
-    auto* prism = rsl::buffer_cast<const KCollisionPrismData>(
-        bytes,
-        header->prism_data_offset + (i + 1) * sizeof(KCollisionPrismData));
-    if (prism == nullptr) {
+  {
+    // Prisms are kept in their on-disk (big endian) representation
+    const size_t count = sizes.prism_data_size / sizeof(KCollisionPrismData);
+    const size_t begin =
+        header->prism_data_offset + sizeof(KCollisionPrismData);
+    if (begin + count * sizeof(KCollisionPrismData) > bytes.size_bytes()) {
       return "Bug in reading code";
     }
-
-    data.prism_data[i] = *prism;
+    data.prism_data.resize(count);
+    std::memcpy(data.prism_data.data(), bytes.data() + begin,
+                count * sizeof(KCollisionPrismData));
   }
 
   if (header->block_data_offset + sizes.block_data_size > file_size) {
@@ -134,6 +145,150 @@ std::string ReadKCollisionData(KCollisionData& data, std::span<const u8> bytes,
   return "";
 }
 
+std::vector<u8> WriteKCollisionData(const KCollisionData& data) {
+  const u32 pos_data_offset = sizeof(KCollisionV1Header);
+  const u32 nrm_data_offset =
+      pos_data_offset + data.pos_data.size() * sizeof(Vector3f);
+  const u32 prism_begin =
+      nrm_data_offset + data.nrm_data.size() * sizeof(Vector3f);
+  const u32 block_data_offset =
+      prism_begin + data.prism_data.size() * sizeof(KCollisionPrismData);
+
+  std::vector<u8> result(block_data_offset + data.block_data.size());
+
+  const auto& min = data.area_min_pos;
+  const KCollisionV1Header header{
+      .pos_data_offset = pos_data_offset,
+      .nrm_data_offset = nrm_data_offset,
+      // 1-indexed, see GetSectionSizes
+      .prism_data_offset =
+          static_cast<u32>(prism_begin - sizeof(KCollisionPrismData)),
+      .block_data_offset = block_data_offset,
+      .prism_thickness = data.prism_thickness,
+      .area_min_pos = {min.x, min.y, min.z},
+      .area_x_width_mask = data.area_x_width_mask,
+      .area_y_width_mask = data.area_y_width_mask,
+      .area_z_width_mask = data.area_z_width_mask,
+      .block_width_shift = data.block_width_shift,
+      .area_x_blocks_shift = data.area_x_blocks_shift,
+      .area_xy_blocks_shift = data.area_xy_blocks_shift,
+      .sphere_radius = data.sphere_radius};
+  std::memcpy(result.data(), &header, sizeof(header));
+
+  auto write_vectors = [&](u32 offset, const std::vector<glm::vec3>& v) {
+    for (size_t i = 0; i < v.size(); ++i) {
+      const Vector3f entry{v[i].x, v[i].y, v[i].z};
+      std::memcpy(result.data() + offset + i * sizeof(Vector3f), &entry,
+                  sizeof(entry));
+    }
+  };
+  write_vectors(pos_data_offset, data.pos_data);
+  write_vectors(nrm_data_offset, data.nrm_data);
+
+  if (!data.prism_data.empty()) {
+    std::memcpy(result.data() + prism_begin, data.prism_data.data(),
+                data.prism_data.size() * sizeof(KCollisionPrismData));
+  }
+  if (!data.block_data.empty()) {
+    std::memcpy(result.data() + block_data_offset, data.block_data.data(),
+                data.block_data.size());
+  }
+
+  return result;
+}
+
+namespace {
+
+//! Prisms are expanded in blocks of this many, laid out one array per
+//! component so the arithmetic vectorizes
+constexpr size_t PrismBlock = 256;
+
+struct PrismBlockSoA {
+  std::array<float, PrismBlock> height;
+  std::array<std::array<float, PrismBlock>, 3> pos, fnrm, enrm1, enrm2, enrm3;
+};
+
+void FromPrismBlock(const KCollisionData& data,
+                    std::span<const KCollisionPrismData> prisms,
+                    std::span<std::array<glm::vec3, 3>> out) {
+  PrismBlockSoA in;
+  const size_t n = prisms.size();
+  const auto gather = [&](auto& dst, size_t i,
+                          const std::vector<glm::vec3>& src, u16 index) {
+    const glm::vec3 v = index < src.size() ? src[index] : glm::vec3(0.0f);
+    dst[0][i] = v.x;
+    dst[1][i] = v.y;
+    dst[2][i] = v.z;
+  };
+  for (size_t i = 0; i < n; ++i) {
+    const auto& prism = prisms[i];
+    in.height[i] = prism.height;
+    gather(in.pos, i, data.pos_data, prism.pos_i);
+    gather(in.fnrm, i, data.nrm_data, prism.fnrm_i);
+    gather(in.enrm1, i, data.nrm_data, prism.enrm1_i);
+    gather(in.enrm2, i, data.nrm_data, prism.enrm2_i);
+    gather(in.enrm3, i, data.nrm_data, prism.enrm3_i);
+  }
+
+  // The same operations, in the same order, as FromPrism
+  std::array<std::array<float, PrismBlock>, 3> v2, v3;
+  const auto& [px, py, pz] = in.pos;
+  const auto& [fx, fy, fz] = in.fnrm;
+  const auto& [ax, ay, az] = in.enrm1;
+  const auto& [bx, by, bz] = in.enrm2;
+  const auto& [cx, cy, cz] = in.enrm3;
+  for (size_t i = 0; i < n; ++i) {
+    // CrossA = cross(enrm1, fnrm), CrossB = cross(enrm2, fnrm)
+    const float cax = ay[i] * fz[i] - fy[i] * az[i];
+    const float cay = az[i] * fx[i] - fz[i] * ax[i];
+    const float caz = ax[i] * fy[i] - fx[i] * ay[i];
+    const float cbx = by[i] * fz[i] - fy[i] * bz[i];
+    const float cby = bz[i] * fx[i] - fz[i] * bx[i];
+    const float cbz = bx[i] * fy[i] - fx[i] * by[i];
+    const float sa = in.height[i] / (cax * cx[i] + cay * cy[i] + caz * cz[i]);
+    const float sb = in.height[i] / (cbx * cx[i] + cby * cy[i] + cbz * cz[i]);
+    v2[0][i] = px[i] + cbx * sb;
+    v2[1][i] = py[i] + cby * sb;
+    v2[2][i] = pz[i] + cbz * sb;
+    v3[0][i] = px[i] + cax * sa;
+    v3[1][i] = py[i] + cay * sa;
+    v3[2][i] = pz[i] + caz * sa;
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = {glm::vec3(px[i], py[i], pz[i]),
+              glm::vec3(v2[0][i], v2[1][i], v2[2][i]),
+              glm::vec3(v3[0][i], v3[1][i], v3[2][i])};
+  }
+}
+
+} // namespace
+
+void FromPrisms(const KCollisionData& data,
+                std::span<std::array<glm::vec3, 3>> out, u32 num_threads) {
+  assert(out.size() == data.prism_data.size());
+  const size_t n = std::min(out.size(), data.prism_data.size());
+  const std::span<const KCollisionPrismData> prisms(data.prism_data);
+
+  rsl::ParallelFor(
+      n, 64 * PrismBlock,
+      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i += PrismBlock) {
+          const size_t count = std::min(PrismBlock, end - i);
+          FromPrismBlock(data, prisms.subspan(i, count),
+                         out.subspan(i, count));
+        }
+      },
+      num_threads);
+}
+
+std::vector<std::array<glm::vec3, 3>>
+FromPrisms(const KCollisionData& data, u32 num_threads) {
+  std::vector<std::array<glm::vec3, 3>> out(data.prism_data.size());
+  FromPrisms(data, out, num_threads);
+  return out;
+}
+
 constexpr std::array<char, 8> WiimmSZSIdentifier = {'W', 'i', 'i', 'm',
                                                     'm', 'S', 'Z', 'S'};
 
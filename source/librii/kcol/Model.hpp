@@ -125,6 +125,8 @@ struct KCollisionData {
 
 std::string ReadKCollisionData(KCollisionData& data, std::span<const u8> bytes,
                                u32 file_size);
+//! Serialize as a KCollisionV1 (Revolution) file
+std::vector<u8> WriteKCollisionData(const KCollisionData& data);
 
 inline std::array<glm::vec3, 3> FromPrism(const KCollisionData& data,
                                           const KCollisionPrismData& prism) {
@@ -133,4 +135,16 @@ inline std::array<glm::vec3, 3> FromPrism(const KCollisionData& data,
                    data.nrm_data[prism.enrm2_i], data.nrm_data[prism.enrm3_i]);
 }
 
+//! @brief FromPrism for every prism of `data`, in bulk.
+//!
+//! Same arithmetic as FromPrism. Prisms indexing past the position/normal
+//! arrays read zero vectors. Large files are split across `num_threads`
+//! threads (0 for every hardware thread).
+//!
+//! @param out Must hold one triangle per prism
+void FromPrisms(const KCollisionData& data,
+                std::span<std::array<glm::vec3, 3>> out, u32 num_threads = 0);
+std::vector<std::array<glm::vec3, 3>> FromPrisms(const KCollisionData& data,
+                                                 u32 num_threads = 0);
+
 } // namespace librii::kcol
@@ -0,0 +1,479 @@
+#include "Octree.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <rsl/ParallelFor.hpp>
+#include <unordered_map>
+
+namespace librii::kcol {
+
+namespace {
+
+u32 LoadBE32(std::span<const u8> data, size_t offset) {
+  return (u32(data[offset]) << 24) | (u32(data[offset + 1]) << 16) |
+         (u32(data[offset + 2]) << 8) | u32(data[offset + 3]);
+}
+u16 LoadBE16(std::span<const u8> data, size_t offset) {
+  return static_cast<u16>((data[offset] << 8) | data[offset + 1]);
+}
+
+//! Clip a ray to a box. Zero direction components are handled explicitly so
+//! rays parallel to a slab never produce NaNs.
+bool ClipToBox(const glm::vec3& origin, const glm::vec3& dir,
+               const glm::vec3& inv_dir, const glm::vec3& box_min,
+               const glm::vec3& box_max, float& t0, float& t1) {
+  for (int i = 0; i < 3; ++i) {
+    if (dir[i] == 0.0f) {
+      if (origin[i] < box_min[i] || origin[i] > box_max[i])
+        return false;
+      continue;
+    }
+    float near = (box_min[i] - origin[i]) * inv_dir[i];
+    float far = (box_max[i] - origin[i]) * inv_dir[i];
+    if (near > far)
+      std::swap(near, far);
+    t0 = std::max(t0, near);
+    t1 = std::min(t1, far);
+    if (t0 > t1)
+      return false;
+  }
+  return true;
+}
+
+glm::vec3 ClosestPointOnTriangle(const glm::vec3& p, const glm::vec3& a,
+                                 const glm::vec3& b, const glm::vec3& c) {
+  // Ericson, Real-Time Collision Detection 5.1.5
+  const glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+  const float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+  if (d1 <= 0.0f && d2 <= 0.0f)
+    return a;
+  const glm::vec3 bp = p - b;
+  const float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+  if (d3 >= 0.0f && d4 <= d3)
+    return b;
+  const float vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    return a + ab * (d1 / (d1 - d3));
+  const glm::vec3 cp = p - c;
+  const float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+  if (d6 >= 0.0f && d5 <= d6)
+    return c;
+  const float vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    return a + ac * (d2 / (d2 - d6));
+  const float va = d3 * d6 - d5 * d4;
+  if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+    return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+  const float denom = 1.0f / (va + vb + vc);
+  return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+glm::vec3 ChildOffset(u32 i) {
+  // Matches the game: x is bit 0, y bit 1, z bit 2
+  return glm::vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+}
+
+} // namespace
+
+std::string KCollisionOctree::decode(const KCollisionData& data) {
+  *this = {};
+
+  if (data.block_width_shift < 0 || data.block_width_shift > 30 ||
+      data.area_x_blocks_shift < 0 || data.area_xy_blocks_shift < 0 ||
+      data.area_xy_blocks_shift < data.area_x_blocks_shift ||
+      data.area_xy_blocks_shift > 30) {
+    return "Invalid block shifts";
+  }
+  mBlockShift = data.block_width_shift;
+  mBlockWidth = static_cast<float>(1u << mBlockShift);
+  mRootsPerAxis[0] = 1u << data.area_x_blocks_shift;
+  mRootsPerAxis[1] =
+      1u << (data.area_xy_blocks_shift - data.area_x_blocks_shift);
+  const u64 z_width = u64(~data.area_z_width_mask) + 1;
+  mRootsPerAxis[2] =
+      static_cast<u32>(std::max<u64>(z_width >> mBlockShift, 1));
+  mAreaMin = data.area_min_pos;
+  mPrismThickness = data.prism_thickness;
+  mSphereRadius = data.sphere_radius;
+
+  const u64 num_roots =
+      u64(mRootsPerAxis[0]) * mRootsPerAxis[1] * mRootsPerAxis[2];
+  std::span<const u8> blocks = data.block_data;
+  if (num_roots * 4 > blocks.size()) {
+    return "Block data is too small for the root blocks";
+  }
+
+  mPrisms.reserve(data.prism_data.size());
+  for (const auto& prism : data.prism_data) {
+    if (prism.pos_i >= data.pos_data.size() ||
+        std::max({prism.fnrm_i, prism.enrm1_i, prism.enrm2_i,
+                  prism.enrm3_i}) >= data.nrm_data.size()) {
+      return "Prism references missing position or normal";
+    }
+    mPrisms.push_back(Prism{.verts = FromPrism(data, prism),
+                            .fnrm = data.nrm_data[prism.fnrm_i],
+                            .enrm = {data.nrm_data[prism.enrm1_i],
+                                     data.nrm_data[prism.enrm2_i],
+                                     data.nrm_data[prism.enrm3_i]},
+                            .height = prism.height,
+                            .attribute = prism.attribute});
+  }
+
+  struct Pending {
+    u32 node;
+    u32 base;     //!< Offset of the group holding the word
+    u32 word_ofs; //!< Offset of the word
+    s32 shift;    //!< Width of this cube
+  };
+  std::vector<Pending> queue;
+  queue.reserve(num_roots);
+  for (u32 i = 0; i < num_roots; ++i)
+    queue.push_back({i, 0, i * 4, static_cast<s32>(mBlockShift)});
+  mNodes.resize(num_roots);
+
+  // Lists are commonly shared between leaves
+  std::unordered_map<u32, u32> leaf_by_offset;
+  // Bounds the work malformed (e.g. heavily self-referencing) files can cause
+  const size_t max_nodes = std::max<size_t>(blocks.size(), 1 << 16) * 2;
+
+  for (size_t q = 0; q < queue.size(); ++q) {
+    const auto cur = queue[q];
+    const u32 word = LoadBE32(blocks, cur.word_ofs);
+
+    if (word & LeafBit) {
+      const u64 list_ofs = u64(cur.base) + (word & ~LeafBit);
+      auto [it, inserted] = leaf_by_offset.emplace(
+          static_cast<u32>(list_ofs), static_cast<u32>(mLeaves.size()));
+      if (inserted) {
+        // The offset points 2 bytes before the first entry
+        Leaf leaf{.first = static_cast<u32>(mPrismLists.size())};
+        for (u64 pos = list_ofs + 2;; pos += 2) {
+          if (pos + 2 > blocks.size()) {
+            return "Unterminated prism list";
+          }
+          const u16 index = LoadBE16(blocks, pos);
+          if (index == 0)
+            break;
+          if (index > mPrisms.size()) {
+            return "Prism list references missing prism";
+          }
+          mPrismLists.push_back(index - 1);
+        }
+        leaf.count = static_cast<u32>(mPrismLists.size()) - leaf.first;
+        mLeaves.push_back(leaf);
+      }
+      mNodes[cur.node] = LeafBit | it->second;
+      continue;
+    }
+
+    const u64 group = u64(cur.base) + word;
+    if (word == 0 || group + 32 > blocks.size()) {
+      return "Invalid octree branch offset";
+    }
+    if (cur.shift <= 0 || mNodes.size() + 8 > max_nodes) {
+      return "Octree is too deep";
+    }
+    const u32 first = static_cast<u32>(mNodes.size());
+    mNodes[cur.node] = first;
+    mNodes.resize(first + 8);
+    for (u32 i = 0; i < 8; ++i) {
+      queue.push_back({first + i, static_cast<u32>(group),
+                       static_cast<u32>(group + i * 4), cur.shift - 1});
+    }
+  }
+
+  return "";
+}
+
+std::optional<u32> KCollisionOctree::rootAt(const glm::vec3& local) const {
+  std::array<u32, 3> cell;
+  for (int i = 0; i < 3; ++i) {
+    if (!(local[i] >= 0.0f))
+      return std::nullopt;
+    cell[i] = static_cast<u32>(local[i] / mBlockWidth);
+    if (cell[i] >= mRootsPerAxis[i])
+      return std::nullopt;
+  }
+  return (cell[2] * mRootsPerAxis[1] + cell[1]) * mRootsPerAxis[0] + cell[0];
+}
+
+std::span<const u16> KCollisionOctree::prismsAt(const glm::vec3& pos) const {
+  if (mNodes.empty())
+    return {};
+  const glm::vec3 local = pos - mAreaMin;
+  const auto root = rootAt(local);
+  if (!root)
+    return {};
+
+  const std::array<u32, 3> p{static_cast<u32>(local.x),
+                             static_cast<u32>(local.y),
+                             static_cast<u32>(local.z)};
+  u32 node = *root;
+  u32 shift = mBlockShift;
+  while (!(mNodes[node] & LeafBit)) {
+    --shift;
+    const u32 child = ((p[0] >> shift) & 1) | (((p[1] >> shift) & 1) << 1) |
+                      (((p[2] >> shift) & 1) << 2);
+    node = mNodes[node] + child;
+  }
+  return leafPrisms(node);
+}
+
+void KCollisionOctree::rayTestLeaf(u32 node, const glm::vec3& origin,
+                                   const glm::vec3& dir, float t_max,
+                                   std::optional<KclRayHit>& best) const {
+  for (const u16 index : leafPrisms(node)) {
+    const auto& prism = mPrisms[index];
+    // Collision is one-sided
+    if (glm::dot(dir, prism.fnrm) >= 0.0f)
+      continue;
+
+    // Moller-Trumbore
+    const glm::vec3 e1 = prism.verts[1] - prism.verts[0];
+    const glm::vec3 e2 = prism.verts[2] - prism.verts[0];
+    const glm::vec3 p = glm::cross(dir, e2);
+    const float det = glm::dot(e1, p);
+    if (std::abs(det) < 1e-12f)
+      continue;
+    const float inv_det = 1.0f / det;
+    const glm::vec3 s = origin - prism.verts[0];
+    const float u = glm::dot(s, p) * inv_det;
+    if (u < 0.0f || u > 1.0f)
+      continue;
+    const glm::vec3 q = glm::cross(s, e1);
+    const float v = glm::dot(dir, q) * inv_det;
+    if (v < 0.0f || u + v > 1.0f)
+      continue;
+    const float t = glm::dot(e2, q) * inv_det;
+    if (t < 0.0f || t > t_max || (best && best->distance <= t))
+      continue;
+
+    best = KclRayHit{.distance = t,
+                     .position = origin + dir * t,
+                     .normal = prism.fnrm,
+                     .prism = index,
+                     .attribute = prism.attribute};
+  }
+}
+
+void KCollisionOctree::rayVisit(u32 node, const glm::vec3& cube_min,
+                                float width, const glm::vec3& origin,
+                                const glm::vec3& inv_dir, const glm::vec3& dir,
+                                float t_min, float t_max,
+                                std::optional<KclRayHit>& best) const {
+  if (mNodes[node] & LeafBit) {
+    rayTestLeaf(node, origin, dir, t_max, best);
+    return;
+  }
+
+  // Visit the children the ray passes through, nearest first
+  const float half = width * 0.5f;
+  struct Entry {
+    float t0, t1;
+    u32 child;
+  };
+  std::array<Entry, 8> order;
+  u32 count = 0;
+  for (u32 i = 0; i < 8; ++i) {
+    const glm::vec3 child_min = cube_min + ChildOffset(i) * half;
+    float t0 = t_min, t1 = t_max;
+    if (!ClipToBox(origin, dir, inv_dir, child_min, child_min + half, t0, t1))
+      continue;
+    u32 j = count++;
+    for (; j > 0 && order[j - 1].t0 > t0; --j)
+      order[j] = order[j - 1];
+    order[j] = {t0, t1, i};
+  }
+  for (u32 i = 0; i < count; ++i) {
+    if (best && best->distance < order[i].t0)
+      return;
+    rayVisit(mNodes[node] + order[i].child,
+             cube_min + ChildOffset(order[i].child) * half, half, origin,
+             inv_dir, dir, order[i].t0, order[i].t1, best);
+  }
+}
+
+std::optional<KclRayHit>
+KCollisionOctree::rayCast(const glm::vec3& origin, const glm::vec3& dir,
+                          float max_distance) const {
+  if (mNodes.empty() || dir == glm::vec3(0.0f))
+    return std::nullopt;
+
+  const glm::vec3 inv_dir = 1.0f / dir;
+  const glm::vec3 area_max =
+      mAreaMin + glm::vec3(mRootsPerAxis[0], mRootsPerAxis[1],
+                           mRootsPerAxis[2]) *
+                     mBlockWidth;
+  float t_enter = 0.0f, t_exit = max_distance;
+  if (!ClipToBox(origin, dir, inv_dir, mAreaMin, area_max, t_enter, t_exit))
+    return std::nullopt;
+
+  // Walk the root blocks in order (Amanatides & Woo)
+  const glm::vec3 start = (origin + dir * t_enter - mAreaMin) / mBlockWidth;
+  std::array<s32, 3> cell, step;
+  glm::vec3 t_next, t_delta;
+  for (int i = 0; i < 3; ++i) {
+    cell[i] = std::clamp(static_cast<s32>(std::floor(start[i])), 0,
+                         static_cast<s32>(mRootsPerAxis[i]) - 1);
+    if (dir[i] > 0.0f) {
+      step[i] = 1;
+      t_next[i] = ((mAreaMin[i] + (cell[i] + 1) * mBlockWidth) - origin[i]) *
+                  inv_dir[i];
+      t_delta[i] = mBlockWidth * inv_dir[i];
+    } else if (dir[i] < 0.0f) {
+      step[i] = -1;
+      t_next[i] =
+          ((mAreaMin[i] + cell[i] * mBlockWidth) - origin[i]) * inv_dir[i];
+      t_delta[i] = -mBlockWidth * inv_dir[i];
+    } else {
+      step[i] = 0;
+      t_next[i] = t_delta[i] = INFINITY;
+    }
+  }
+
+  std::optional<KclRayHit> best;
+  float t = t_enter;
+  while (t <= t_exit) {
+    const int axis = t_next.x < t_next.y ? (t_next.x < t_next.z ? 0 : 2)
+                                         : (t_next.y < t_next.z ? 1 : 2);
+    const float t_leave = std::min(t_next[axis], t_exit);
+    const u32 root =
+        (cell[2] * mRootsPerAxis[1] + cell[1]) * mRootsPerAxis[0] + cell[0];
+    const glm::vec3 cube_min =
+        mAreaMin + glm::vec3(cell[0], cell[1], cell[2]) * mBlockWidth;
+    rayVisit(root, cube_min, mBlockWidth, origin, inv_dir, dir, t, t_leave,
+             best);
+    if (best && best->distance <= t_leave)
+      break;
+
+    cell[axis] += step[axis];
+    if (cell[axis] < 0 || cell[axis] >= static_cast<s32>(mRootsPerAxis[axis]))
+      break;
+    t = t_next[axis];
+    t_next[axis] += t_delta[axis];
+  }
+  return best;
+}
+
+std::vector<std::optional<KclRayHit>>
+KCollisionOctree::rayCastBatch(std::span<const KclRay> rays,
+                               u32 num_threads) const {
+  std::vector<std::optional<KclRayHit>> result(rays.size());
+  rsl::ParallelFor(
+      rays.size(), 256,
+      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+          result[i] = rayCast(rays[i]);
+      },
+      num_threads);
+  return result;
+}
+
+void KCollisionOctree::collectLeaves(u32 node, const glm::vec3& cube_min,
+                                     float width, const glm::vec3& lo,
+                                     const glm::vec3& hi,
+                                     std::vector<u16>& out) const {
+  for (int i = 0; i < 3; ++i) {
+    if (cube_min[i] > hi[i] || cube_min[i] + width < lo[i])
+      return;
+  }
+  if (mNodes[node] & LeafBit) {
+    const auto prisms = leafPrisms(node);
+    out.insert(out.end(), prisms.begin(), prisms.end());
+    return;
+  }
+  const float half = width * 0.5f;
+  for (u32 i = 0; i < 8; ++i) {
+    collectLeaves(mNodes[node] + i, cube_min + ChildOffset(i) * half, half, lo,
+                  hi, out);
+  }
+}
+
+bool KCollisionOctree::sphereTest(u32 index, const glm::vec3& center,
+                                  float radius, KclSphereHit& hit) const {
+  const auto& prism = mPrisms[index];
+  const glm::vec3 rel = center - prism.verts[0];
+
+  const float dist_ca = glm::dot(rel, prism.enrm[0]);
+  if (dist_ca >= radius)
+    return false;
+  const float dist_ab = glm::dot(rel, prism.enrm[1]);
+  if (dist_ab >= radius)
+    return false;
+  const float dist_bc = glm::dot(rel, prism.enrm[2]) - prism.height;
+  if (dist_bc >= radius)
+    return false;
+
+  // Spheres must reach the face, but not from below the prism
+  const float depth = radius - glm::dot(rel, prism.fnrm);
+  if (depth <= 0.0f || depth > mPrismThickness)
+    return false;
+
+  hit.prism = index;
+  hit.attribute = prism.attribute;
+  if (dist_ca <= 0.0f && dist_ab <= 0.0f && dist_bc <= 0.0f) {
+    hit.normal = prism.fnrm;
+    hit.depth = depth;
+    return true;
+  }
+
+  // Past an edge: only the rim of the sphere touches
+  const glm::vec3 closest = ClosestPointOnTriangle(
+      center, prism.verts[0], prism.verts[1], prism.verts[2]);
+  const glm::vec3 delta = center - closest;
+  const float dist = glm::length(delta);
+  if (dist >= radius)
+    return false;
+  hit.normal = dist > 1e-6f ? delta / dist : prism.fnrm;
+  hit.depth = radius - dist;
+  return true;
+}
+
+void KCollisionOctree::sphereOverlap(const glm::vec3& center, float radius,
+                                     std::vector<KclSphereHit>& out) const {
+  out.clear();
+  if (mNodes.empty())
+    return;
+
+  // Leaves already list every prism within sphere_radius of them, so spheres
+  // no larger than that only need the leaf holding their center
+  std::vector<u16> candidates;
+  const float margin = radius - mSphereRadius;
+  if (margin <= 0.0f) {
+    const auto prisms = prismsAt(center);
+    candidates.assign(prisms.begin(), prisms.end());
+  } else {
+    const glm::vec3 lo = center - margin - mAreaMin;
+    const glm::vec3 hi = center + margin - mAreaMin;
+    std::array<u32, 3> first, last;
+    for (int i = 0; i < 3; ++i) {
+      const float max_cell = static_cast<float>(mRootsPerAxis[i] - 1);
+      if (hi[i] < 0.0f || lo[i] / mBlockWidth > max_cell + 1.0f)
+        return;
+      first[i] = static_cast<u32>(
+          std::clamp(std::floor(lo[i] / mBlockWidth), 0.0f, max_cell));
+      last[i] = static_cast<u32>(
+          std::clamp(std::floor(hi[i] / mBlockWidth), 0.0f, max_cell));
+    }
+    for (u32 z = first[2]; z <= last[2]; ++z) {
+      for (u32 y = first[1]; y <= last[1]; ++y) {
+        for (u32 x = first[0]; x <= last[0]; ++x) {
+          collectLeaves((z * mRootsPerAxis[1] + y) * mRootsPerAxis[0] + x,
+                        mAreaMin + glm::vec3(x, y, z) * mBlockWidth,
+                        mBlockWidth, lo + mAreaMin, hi + mAreaMin, candidates);
+        }
+      }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+  }
+
+  for (const u16 index : candidates) {
+    KclSphereHit hit;
+    if (sphereTest(index, center, radius, hit))
+      out.push_back(hit);
+  }
+}
+
+} // namespace librii::kcol
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Model.hpp"
+#include <array>
+#include <core/common.h>
+#include <glm/vec3.hpp>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace librii::kcol {
+
+struct KclRay {
+  glm::vec3 origin;
+  glm::vec3 direction; //!< Need not be normalized
+  float max_distance = std::numeric_limits<float>::infinity();
+};
+
+struct KclRayHit {
+  float distance = 0.0f; //!< In units of `direction`
+  glm::vec3 position;
+  glm::vec3 normal;
+  u32 prism = 0; //!< Index into KCollisionData::prism_data
+  u16 attribute = 0;
+};
+
+struct KclSphereHit {
+  u32 prism = 0;
+  u16 attribute = 0;
+  glm::vec3 normal; //!< Direction to push the sphere out
+  float depth = 0.0f;
+};
+
+//! @brief The KCollisionV1 octree, decoded for fast queries.
+//!
+//! Nodes are flattened into one array: the root blocks first, then groups of
+//! eight children. Leaves index contiguous ranges of a shared prism list.
+class KCollisionOctree {
+public:
+  //! @return An empty string on success, otherwise why `data` is malformed.
+  std::string decode(const KCollisionData& data);
+
+  //! First front-facing hit along the ray, if any
+  std::optional<KclRayHit>
+  rayCast(const glm::vec3& origin, const glm::vec3& direction,
+          float max_distance = std::numeric_limits<float>::infinity()) const;
+  std::optional<KclRayHit> rayCast(const KclRay& ray) const {
+    return rayCast(ray.origin, ray.direction, ray.max_distance);
+  }
+  //! Casts independent rays, in parallel for large batches
+  std::vector<std::optional<KclRayHit>>
+  rayCastBatch(std::span<const KclRay> rays, u32 num_threads = 0) const;
+
+  //! @brief Every prism the sphere collides with, as the game tests it.
+  //!
+  //! Prisms are one-sided and `prism_thickness` deep: spheres behind a face,
+  //! or below the prism, do not collide.
+  void sphereOverlap(const glm::vec3& center, float radius,
+                     std::vector<KclSphereHit>& out) const;
+
+  //! Prism indices (0-based) of the leaf containing `pos`, as the game looks
+  //! them up. Empty outside the area.
+  std::span<const u16> prismsAt(const glm::vec3& pos) const;
+
+  std::size_t numNodes() const { return mNodes.size(); }
+  std::size_t numLeaves() const { return mLeaves.size(); }
+
+private:
+  static constexpr u32 LeafBit = 0x8000'0000;
+
+  struct Leaf {
+    u32 first = 0;
+    u32 count = 0;
+  };
+  //! Precomputed from the prism data
+  struct Prism {
+    std::array<glm::vec3, 3> verts;
+    glm::vec3 fnrm;
+    std::array<glm::vec3, 3> enrm;
+    float height = 0.0f;
+    u16 attribute = 0;
+  };
+
+  std::span<const u16> leafPrisms(u32 node) const {
+    const auto& leaf = mLeaves[mNodes[node] & ~LeafBit];
+    return {mPrismLists.data() + leaf.first, leaf.count};
+  }
+  std::optional<u32> rootAt(const glm::vec3& local) const;
+  void rayVisit(u32 node, const glm::vec3& cube_min, float width,
+                const glm::vec3& origin, const glm::vec3& inv_dir,
+                const glm::vec3& dir, float t_min, float t_max,
+                std::optional<KclRayHit>& best) const;
+  void rayTestLeaf(u32 node, const glm::vec3& origin, const glm::vec3& dir,
+                   float t_max, std::optional<KclRayHit>& best) const;
+  void collectLeaves(u32 node, const glm::vec3& cube_min, float width,
+                     const glm::vec3& lo, const glm::vec3& hi,
+                     std::vector<u16>& out) const;
+  bool sphereTest(u32 prism, const glm::vec3& center, float radius,
+                  KclSphereHit& hit) const;
+
+  //! LeafBit | index into mLeaves, or the index of the first of 8 children
+  std::vector<u32> mNodes;
+  std::vector<Leaf> mLeaves;
+  std::vector<u16> mPrismLists;
+  std::vector<Prism> mPrisms;
+
+  glm::vec3 mAreaMin{0.0f};
+  std::array<u32, 3> mRootsPerAxis{0, 0, 0};
+  u32 mBlockShift = 0;
+  float mBlockWidth = 0.0f;
+  float mPrismThickness = 0.0f;
+  float mSphereRadius = 0.0f;
+};
+
+} // namespace librii::kcol
@@ -0,0 +1,213 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+namespace librii::math {
+
+namespace {
+
+constexpr u32 NumBins = 12;
+//! Leaves this large are split even if the SAH disagrees
+constexpr u32 MaxLeafSize = 64;
+//! Keeps traversal within its fixed stack
+constexpr u32 MaxDepth = 60;
+
+AABB EmptyBounds() {
+  return {.min = glm::vec3(std::numeric_limits<float>::infinity()),
+          .max = glm::vec3(-std::numeric_limits<float>::infinity())};
+}
+
+float HalfArea(const AABB& box) {
+  const glm::vec3 d = box.max - box.min;
+  return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+glm::vec3 Centroid(const AABB& box) { return (box.min + box.max) * 0.5f; }
+
+} // namespace
+
+void BVH::build(std::span<const AABB> bounds, u32 max_leaf_size) {
+  mNodes.clear();
+  mParents.clear();
+  mPrimBounds.assign(bounds.begin(), bounds.end());
+  mPrimIndices.resize(bounds.size());
+  std::iota(mPrimIndices.begin(), mPrimIndices.end(), 0);
+  mPrimLeaves.resize(bounds.size());
+  if (bounds.empty())
+    return;
+
+  max_leaf_size = std::max(max_leaf_size, 1u);
+  mNodes.reserve(bounds.size() * 2);
+  mParents.reserve(bounds.size() * 2);
+
+  struct Task {
+    u32 node;
+    u32 depth;
+  };
+  std::vector<Task> tasks;
+
+  mNodes.push_back({.first = 0, .count = static_cast<u32>(bounds.size())});
+  mParents.push_back(NoParent);
+  tasks.push_back({0, 0});
+
+  while (!tasks.empty()) {
+    const auto [node_id, depth] = tasks.back();
+    tasks.pop_back();
+
+    const u32 first = mNodes[node_id].first;
+    const u32 count = mNodes[node_id].count;
+    const auto prims = std::span(mPrimIndices).subspan(first, count);
+
+    AABB box = EmptyBounds();
+    AABB centroids = EmptyBounds();
+    for (u32 p : prims) {
+      box.expandBound(mPrimBounds[p]);
+      const glm::vec3 c = Centroid(mPrimBounds[p]);
+      centroids.expandBound({c, c});
+    }
+    mNodes[node_id].bounds = box;
+
+    if (count <= max_leaf_size || depth >= MaxDepth)
+      continue;
+
+    // Binned SAH over every axis
+    const float leaf_cost = static_cast<float>(count) * HalfArea(box);
+    float best_cost = std::numeric_limits<float>::infinity();
+    int best_axis = -1;
+    u32 best_split = 0;
+    const glm::vec3 extent = centroids.max - centroids.min;
+    for (int axis = 0; axis < 3; ++axis) {
+      if (!(extent[axis] > 0.0f))
+        continue;
+      const float scale = NumBins / extent[axis];
+      std::array<AABB, NumBins> bin_bounds;
+      std::array<u32, NumBins> bin_counts{};
+      bin_bounds.fill(EmptyBounds());
+      for (u32 p : prims) {
+        const u32 b = std::min(
+            static_cast<u32>((Centroid(mPrimBounds[p])[axis] -
+                              centroids.min[axis]) *
+                             scale),
+            NumBins - 1);
+        bin_bounds[b].expandBound(mPrimBounds[p]);
+        ++bin_counts[b];
+      }
+      // Sweep from the right, then the left
+      std::array<float, NumBins> right_cost{};
+      AABB acc = EmptyBounds();
+      u32 acc_count = 0;
+      for (u32 b = NumBins - 1; b > 0; --b) {
+        acc.expandBound(bin_bounds[b]);
+        acc_count += bin_counts[b];
+        right_cost[b] = acc_count == 0 ? 0.0f
+                                       : static_cast<float>(acc_count) *
+                                             HalfArea(acc);
+      }
+      acc = EmptyBounds();
+      acc_count = 0;
+      for (u32 b = 0; b < NumBins - 1; ++b) {
+        acc.expandBound(bin_bounds[b]);
+        acc_count += bin_counts[b];
+        if (acc_count == 0 || acc_count == count)
+          continue;
+        const float cost =
+            static_cast<float>(acc_count) * HalfArea(acc) + right_cost[b + 1];
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = axis;
+          best_split = b + 1;
+        }
+      }
+    }
+
+    u32 mid = 0;
+    if (best_axis >= 0 && best_cost < leaf_cost) {
+      const float scale = NumBins / extent[best_axis];
+      const auto it = std::partition(prims.begin(), prims.end(), [&](u32 p) {
+        const u32 b = std::min(
+            static_cast<u32>((Centroid(mPrimBounds[p])[best_axis] -
+                              centroids.min[best_axis]) *
+                             scale),
+            NumBins - 1);
+        return b < best_split;
+      });
+      mid = static_cast<u32>(it - prims.begin());
+    } else if (count > MaxLeafSize) {
+      // Splitting does not pay off, but the leaf would be too slow to scan:
+      // fall back to the median of the widest axis.
+      int axis = 0;
+      if (extent.y > extent[axis])
+        axis = 1;
+      if (extent.z > extent[axis])
+        axis = 2;
+      mid = count / 2;
+      std::nth_element(prims.begin(), prims.begin() + mid, prims.end(),
+                       [&](u32 a, u32 b) {
+                         return Centroid(mPrimBounds[a])[axis] <
+                                Centroid(mPrimBounds[b])[axis];
+                       });
+    } else {
+      continue;
+    }
+    if (mid == 0 || mid == count)
+      continue;
+
+    const u32 left = static_cast<u32>(mNodes.size());
+    mNodes[node_id].first = left;
+    mNodes[node_id].count = 0;
+    mNodes.push_back({.first = first, .count = mid});
+    mNodes.push_back({.first = first + mid, .count = count - mid});
+    mParents.push_back(node_id);
+    mParents.push_back(node_id);
+    tasks.push_back({left, depth + 1});
+    tasks.push_back({left + 1, depth + 1});
+  }
+
+  for (u32 i = 0; i < mNodes.size(); ++i) {
+    const Node& node = mNodes[i];
+    for (u32 j = node.first; j < node.first + node.count; ++j)
+      mPrimLeaves[mPrimIndices[j]] = i;
+  }
+}
+
+void BVH::refitLeaf(u32 node) {
+  Node& leaf = mNodes[node];
+  AABB box = EmptyBounds();
+  for (u32 i = leaf.first; i < leaf.first + leaf.count; ++i)
+    box.expandBound(mPrimBounds[mPrimIndices[i]]);
+  leaf.bounds = box;
+}
+
+void BVH::refit(std::span<const AABB> bounds) {
+  assert(bounds.size() == mPrimBounds.size());
+  std::copy(bounds.begin(), bounds.end(), mPrimBounds.begin());
+  // Children always follow their parents, so a reverse sweep is bottom-up
+  for (u32 i = static_cast<u32>(mNodes.size()); i-- > 0;) {
+    Node& node = mNodes[i];
+    if (node.count != 0) {
+      refitLeaf(i);
+      continue;
+    }
+    node.bounds = mNodes[node.first].bounds;
+    node.bounds.expandBound(mNodes[node.first + 1].bounds);
+  }
+}
+
+void BVH::update(u32 prim, const AABB& bounds) {
+  assert(prim < mPrimBounds.size());
+  mPrimBounds[prim] = bounds;
+  u32 node = mPrimLeaves[prim];
+  refitLeaf(node);
+  for (node = mParents[node]; node != NoParent; node = mParents[node]) {
+    Node& parent = mNodes[node];
+    AABB box = mNodes[parent.first].bounds;
+    box.expandBound(mNodes[parent.first + 1].bounds);
+    if (box == parent.bounds)
+      break;
+    parent.bounds = box;
+  }
+}
+
+} // namespace librii::math
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <array>
+#include <core/common.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <librii/math/aabb.hpp>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace librii::math {
+
+//! Ray/box slab test. `inv_dir` is the componentwise reciprocal of the ray
+//! direction, so axes the ray is parallel to are infinite. A ray parallel to
+//! an axis whose origin lies exactly on one of the box's faces in that axis
+//! gives 0 * inf = NaN; it is treated as inside that slab.
+//!
+//! @return Distance at which the ray enters the box, if it does before `t_max`.
+inline std::optional<float> IntersectRayAABB(const AABB& box,
+                                             const glm::vec3& origin,
+                                             const glm::vec3& inv_dir,
+                                             float t_max) {
+  constexpr float inf = std::numeric_limits<float>::infinity();
+  // Written branch-free on whole vectors, so it vectorizes
+  const glm::vec3 t0 = (box.min - origin) * inv_dir;
+  const glm::vec3 t1 = (box.max - origin) * inv_dir;
+  const glm::bvec3 on_face = glm::isnan(t0) || glm::isnan(t1);
+  const glm::vec3 near = glm::mix(glm::min(t0, t1), glm::vec3(-inf), on_face);
+  const glm::vec3 far = glm::mix(glm::max(t0, t1), glm::vec3(inf), on_face);
+  const float enter =
+      glm::max(glm::max(near.x, near.y), glm::max(near.z, 0.0f));
+  const float exit = glm::min(glm::min(far.x, far.y), glm::min(far.z, t_max));
+  if (!(enter <= exit))
+    return std::nullopt;
+  return enter;
+}
+
+//! Möller–Trumbore. Both faces are hit unless `cull_back` is set.
+//!
+//! @return Distance along the ray, in units of `dir`.
+inline std::optional<float>
+IntersectRayTriangle(const glm::vec3& origin, const glm::vec3& dir,
+                     const std::array<glm::vec3, 3>& tri,
+                     bool cull_back = false) {
+  const glm::vec3 e1 = tri[1] - tri[0];
+  const glm::vec3 e2 = tri[2] - tri[0];
+  const glm::vec3 p = glm::cross(dir, e2);
+  const float det = glm::dot(e1, p);
+  if (cull_back ? det <= 0.0f : det == 0.0f)
+    return std::nullopt;
+  const float inv_det = 1.0f / det;
+  const glm::vec3 s = origin - tri[0];
+  const float u = glm::dot(s, p) * inv_det;
+  if (u < 0.0f || u > 1.0f)
+    return std::nullopt;
+  const glm::vec3 q = glm::cross(s, e1);
+  const float v = glm::dot(dir, q) * inv_det;
+  if (v < 0.0f || u + v > 1.0f)
+    return std::nullopt;
+  const float t = glm::dot(e2, q) * inv_det;
+  if (t < 0.0f)
+    return std::nullopt;
+  return t;
+}
+
+//! @brief Bounding volume hierarchy over a set of boxes.
+//!
+//! Built top-down with the binned surface area heuristic. When primitives move
+//! but their number does not, `refit` / `update` adjust the bounds in place
+//! instead of rebuilding the tree.
+class BVH {
+public:
+  //! Primitives are identified by their index into `bounds`.
+  void build(std::span<const AABB> bounds, u32 max_leaf_size = 4);
+  //! Recompute every node's bounds. `bounds` must be as large as when built.
+  void refit(std::span<const AABB> bounds);
+  //! Move a single primitive, only touching the nodes above it
+  void update(u32 prim, const AABB& bounds);
+
+  bool empty() const { return mNodes.empty(); }
+  std::size_t numPrimitives() const { return mPrimBounds.size(); }
+  std::size_t numNodes() const { return mNodes.size(); }
+  AABB bounds() const { return mNodes.empty() ? AABB{} : mNodes[0].bounds; }
+
+  //! @brief Visit primitives whose boxes the ray crosses, nearest node first.
+  //!
+  //! `test(prim, t_max)` returns the distance of a hit closer than `t_max`, or
+  //! std::nullopt. Hits shrink the search.
+  //!
+  //! @return The closest hit: {primitive, distance}.
+  template <typename F>
+  std::optional<std::pair<u32, float>>
+  rayCast(const glm::vec3& origin, const glm::vec3& dir, F&& test,
+          float t_max = std::numeric_limits<float>::infinity()) const {
+    if (mNodes.empty())
+      return std::nullopt;
+    const glm::vec3 inv_dir = 1.0f / dir;
+    std::optional<std::pair<u32, float>> best;
+
+    if (!IntersectRayAABB(mNodes[0].bounds, origin, inv_dir, t_max))
+      return std::nullopt;
+
+    std::array<u32, 64> stack;
+    u32 sp = 0;
+    stack[sp++] = 0;
+    while (sp != 0) {
+      const Node& node = mNodes[stack[--sp]];
+      if (node.count != 0) {
+        for (u32 i = node.first; i < node.first + node.count; ++i) {
+          const u32 prim = mPrimIndices[i];
+          if (auto t = test(prim, t_max); t && *t < t_max) {
+            t_max = *t;
+            best = std::pair{prim, *t};
+          }
+        }
+        continue;
+      }
+      const u32 l = node.first;
+      const u32 r = node.first + 1;
+      auto tl = IntersectRayAABB(mNodes[l].bounds, origin, inv_dir, t_max);
+      auto tr = IntersectRayAABB(mNodes[r].bounds, origin, inv_dir, t_max);
+      // Push the far child first so the near one is popped next
+      if (tl && tr) {
+        const bool left_first = *tl <= *tr;
+        stack[sp++] = left_first ? r : l;
+        stack[sp++] = left_first ? l : r;
+      } else if (tl) {
+        stack[sp++] = l;
+      } else if (tr) {
+        stack[sp++] = r;
+      }
+    }
+    return best;
+  }
+
+private:
+  struct Node {
+    AABB bounds;
+    //! Leaves: first index into mPrimIndices. Otherwise: the left child; the
+    //! right child follows it.
+    u32 first = 0;
+    //! 0 for interior nodes
+    u32 count = 0;
+  };
+  static constexpr u32 NoParent = ~0u;
+
+  void refitLeaf(u32 node);
+
+  std::vector<Node> mNodes;
+  std::vector<u32> mParents;
+  std::vector<u32> mPrimIndices;
+  std::vector<AABB> mPrimBounds;
+  //! Leaf holding each primitive
+  std::vector<u32> mPrimLeaves;
+};
+
+} // namespace librii::math
@@ -1,101 +1,189 @@
 #include "SZS.hpp"
 #include <algorithm>
+#include <cstring>
 #include <llvm/Support/raw_ostream.h>
 #include <oishii/writer/binary_writer.hxx>
+#include <rsl/ParallelFor.hpp>
 
 namespace librii::szs {
 
+static bool hasMagic(std::span<const u8> src) {
+  return src.size() >= 4 && src[0] == 'Y' && src[1] == 'a' && src[2] == 'z' &&
+         src[3] == '0';
+}
+
 u32 getExpandedSize(std::span<const u8> src) {
-  if (src.size_bytes() < 8)
+  if (src.size_bytes() < 8 || !hasMagic(src))
     return 0;
 
-  assert(src[0] == 'Y' && src[1] == 'a' && src[2] == 'z' && src[3] == '0');
   return (src[4] << 24) | (src[5] << 16) | (src[6] << 8) | src[7];
 }
 
-llvm::Error decode(std::span<u8> dst, std::span<const u8> src) {
-  assert(src[0] == 'Y' && src[1] == 'a' && src[2] == 'z' && src[3] == '0');
-  assert(dst.size() >= getExpandedSize(src));
+namespace {
 
-  int in_position = 0x10;
-  int out_position = 0;
+// Longest chunk: 3 bytes of input, 0x111 bytes of output
+constexpr std::size_t MaxGroupIn = 1 + 8 * 3;
+constexpr std::size_t MaxGroupOut = 8 * 0x111 + 8;
 
-  const auto take8 = [&]() {
-    const u8 result = src[in_position];
-    ++in_position;
-    return result;
-  };
-  const auto take16 = [&]() {
-    const u32 high = src[in_position];
-    ++in_position;
-    const u32 low = src[in_position];
-    ++in_position;
-    return (high << 8) | low;
-  };
-  const auto give8 = [&](u8 val) {
-    dst[out_position] = val;
-    ++out_position;
-  };
+llvm::Error truncatedError() {
+  return llvm::createStringError(
+      std::errc::executable_format_error,
+      "Truncated source file: the file could not be decompressed fully");
+}
 
-  const auto read_group = [&](bool raw) {
-    if (raw) {
-      give8(take8());
-      return;
-    }
+// Expand a back-reference. The source may overlap the destination, in which
+// case the copy must observe its own output (e.g. distance 1 is a fill).
+//
+// With `Overrun`, up to 7 bytes past the end of the run may be clobbered.
+template <bool Overrun> inline void copyBackref(u8* out, u32 dist, u32 len) {
+  const u8* ref = out - dist;
+  if (Overrun && dist >= 8) {
+    for (u32 i = 0; i < len; i += 8)
+      std::memcpy(out + i, ref + i, 8);
+  } else if (dist >= len) {
+    std::memcpy(out, ref, len);
+  } else if (dist == 1) {
+    std::memset(out, *ref, len);
+  } else if (dist >= 8) {
+    // Each word only reads bytes at least 8 behind it, which are final
+    u32 i = 0;
+    for (; i + 8 <= len; i += 8)
+      std::memcpy(out + i, ref + i, 8);
+    for (; i < len; ++i)
+      out[i] = ref[i];
+  } else {
+    for (u32 i = 0; i < len; ++i)
+      out[i] = ref[i];
+  }
+}
 
-    const u16 group = take16();
-    const int reverse = (group & 0xfff) + 1;
-    const int g_size = group >> 12;
+template <bool Fast>
+llvm::Error decodeGroup(const u8*& in, const u8* in_end, u8*& out,
+                        u8* out_begin, u8* out_end) {
+  if (!Fast && in >= in_end)
+    return truncatedError();
 
-    int size = g_size ? g_size + 2 : take8() + 18;
+  u8 header = *in++;
+  if (Fast && header == 0xff) {
+    std::memcpy(out, in, 8);
+    in += 8;
+    out += 8;
+    return llvm::Error::success();
+  }
 
-    // Invalid data could buffer overflow
+  for (int i = 0; i < 8; ++i, header <<= 1) {
+    if (!Fast && out >= out_end)
+      break;
 
-    for (int i = 0; i < size; ++i) {
-      give8(dst[out_position - reverse]);
+    if (header & 0x80) {
+      if (!Fast && in >= in_end)
+        return truncatedError();
+      *out++ = *in++;
+      continue;
     }
-  };
 
-  const auto read_chunk = [&]() {
-    const u8 header = take8();
+    if (!Fast && in_end - in < 2)
+      return truncatedError();
+    const u32 b0 = in[0];
+    const u32 b1 = in[1];
+    in += 2;
 
-    for (int i = 0; i < 8; ++i) {
-      if (in_position >= src.size() || out_position >= dst.size())
-        return;
-      read_group(header & (1 << (7 - i)));
+    const u32 dist = (((b0 & 0xf) << 8) | b1) + 1;
+    u32 len = b0 >> 4;
+    if (len != 0) {
+      len += 2;
+    } else {
+      if (!Fast && in >= in_end)
+        return truncatedError();
+      len = *in++ + 0x12;
     }
-  };
 
-  while (in_position < src.size() && out_position < dst.size())
-    read_chunk();
+    if (dist > static_cast<std::size_t>(out - out_begin))
+      return llvm::createStringError(
+          std::errc::executable_format_error,
+          "Invalid back-reference: points before the start of the file");
+    if (!Fast && len > static_cast<std::size_t>(out_end - out))
+      return llvm::createStringError(
+          std::errc::no_buffer_space,
+          "Invalid YAZ0 header: file is larger than reported");
 
-  // if (out_position < dst.size())
-  //   return llvm::createStringError(
-  //       std::errc::executable_format_error,
-  //       "Truncated source file: the file could not be decompressed fully");
+    copyBackref<Fast>(out, dist, len);
+    out += len;
+  }
 
-  // if (in_position != src.size())
-  //   return llvm::createStringError(
-  //       std::errc::no_buffer_space,
-  //       "Invalid YAZ0 header: file is larger than reported");
+  return llvm::Error::success();
+}
+
+} // namespace
+
+StreamDecoder::StreamDecoder(std::span<u8> dst, std::span<const u8> src)
+    : mSrc(src) {
+  const u32 expanded = getExpandedSize(src);
+  if (src.size() >= 16 && expanded != 0 && dst.size() >= expanded)
+    mDst = dst.subspan(0, expanded);
+  else
+    mHeaderError = true;
+}
+
+llvm::Error StreamDecoder::decodeUntil(std::size_t size) {
+  if (mHeaderError) {
+    if (mSrc.size() < 16 || !hasMagic(mSrc))
+      return llvm::createStringError(std::errc::executable_format_error,
+                                     "Invalid YAZ0 header: bad magic");
+    if (getExpandedSize(mSrc) != 0)
+      return llvm::createStringError(
+          std::errc::no_buffer_space,
+          "Destination buffer is smaller than the expanded size");
+    // An empty file
+    return llvm::Error::success();
+  }
 
+  const u8* in = mSrc.data() + mIn;
+  const u8* const in_end = mSrc.data() + mSrc.size();
+  u8* out = mDst.data() + mOut;
+  u8* const out_begin = mDst.data();
+  u8* const out_end = mDst.data() + mDst.size();
+  u8* const target = mDst.data() + std::min(size, mDst.size());
+
+  while (out < target) {
+    // When a whole group cannot run off either buffer (even with the overrun
+    // of copyBackref), only the back-reference distances need validating.
+    const bool fast = static_cast<std::size_t>(in_end - in) >= MaxGroupIn &&
+                      static_cast<std::size_t>(out_end - out) >= MaxGroupOut;
+    auto err = fast ? decodeGroup<true>(in, in_end, out, out_begin, out_end)
+                    : decodeGroup<false>(in, in_end, out, out_begin, out_end);
+    if (err)
+      return err;
+  }
+
+  mIn = in - mSrc.data();
+  mOut = out - mDst.data();
   return llvm::Error::success();
 }
 
-std::vector<u8> encodeFast(std::span<const u8> src) {
-  std::vector<u8> result(16 + roundUp(src.size(), 8) / 8 * 9 - 1);
+llvm::Error decode(std::span<u8> dst, std::span<const u8> src) {
+  StreamDecoder stream(dst, src);
+  return stream.decodeAll();
+}
 
+static void writeHeader(std::vector<u8>& result, u32 size) {
   result[0] = 'Y';
   result[1] = 'a';
   result[2] = 'z';
   result[3] = '0';
 
-  result[4] = (src.size() & 0xff00'0000) >> 24;
-  result[5] = (src.size() & 0x00ff'0000) >> 16;
-  result[6] = (src.size() & 0x0000'ff00) >> 8;
-  result[7] = (src.size() & 0x0000'00ff) >> 0;
+  result[4] = (size & 0xff00'0000) >> 24;
+  result[5] = (size & 0x00ff'0000) >> 16;
+  result[6] = (size & 0x0000'ff00) >> 8;
+  result[7] = (size & 0x0000'00ff) >> 0;
 
   std::fill(result.begin() + 8, result.begin() + 16, 0);
+}
+
+std::vector<u8> encodeFast(std::span<const u8> src) {
+  std::vector<u8> result(16 + roundUp(src.size(), 8) / 8 + src.size());
+
+  writeHeader(result, src.size());
 
   auto* dst = result.data() + 16;
 
@@ -107,8 +195,338 @@ std::vector<u8> encodeFast(std::span<const u8> src) {
     }
     *dst++ = *it++;
   }
-  while (counter--)
-    *dst++ = 0;
+
+  return result;
+}
+
+namespace {
+
+constexpr u32 WindowSize = 0x1000;
+constexpr u32 MinMatch = 3;
+constexpr u32 MaxMatch = 0x111;
+
+// Each chunk is prefixed by one bit of a group header byte, MSB first: 1 for a
+// literal byte, 0 for a back-reference.
+class GroupWriter {
+public:
+  explicit GroupWriter(std::vector<u8>& out) : mOut(out) {}
+
+  void literal(u8 c) {
+    beginChunk(true);
+    mOut.push_back(c);
+  }
+  void backref(u32 dist, u32 len) {
+    assert(dist >= 1 && dist <= WindowSize);
+    assert(len >= MinMatch && len <= MaxMatch);
+    beginChunk(false);
+
+    const u32 reverse = dist - 1;
+    if (len < 0x12) {
+      mOut.push_back(((len - 2) << 4) | (reverse >> 8));
+      mOut.push_back(reverse & 0xff);
+    } else {
+      mOut.push_back(reverse >> 8);
+      mOut.push_back(reverse & 0xff);
+      mOut.push_back(len - 0x12);
+    }
+  }
+
+  //! Re-emit the chunks of another writer's output, continuing the current
+  //! group. The source stream may end with a partial group.
+  void append(std::span<const u8> stream, u32 num_chunks) {
+    std::size_t pos = 0;
+    u8 header = 0;
+    for (u32 i = 0; i < num_chunks; ++i) {
+      if (i % 8 == 0)
+        header = stream[pos++];
+      const bool raw = header & (0x80 >> (i % 8));
+      const std::size_t size = raw ? 1 : (stream[pos] >> 4) ? 2 : 3;
+      beginChunk(raw);
+      mOut.insert(mOut.end(), stream.begin() + pos,
+                  stream.begin() + pos + size);
+      pos += size;
+    }
+  }
+
+  u32 numChunks() const { return mNumChunks; }
+
+private:
+  void beginChunk(bool raw) {
+    ++mNumChunks;
+    if (mRemaining == 0) {
+      mHeaderPos = mOut.size();
+      mOut.push_back(0);
+      mRemaining = 8;
+    }
+    --mRemaining;
+    if (raw)
+      mOut[mHeaderPos] |= 1 << mRemaining;
+  }
+
+  std::vector<u8>& mOut;
+  std::size_t mHeaderPos = 0;
+  unsigned mRemaining = 0;
+  u32 mNumChunks = 0;
+};
+
+struct Match {
+  u32 len = 0;
+  u32 dist = 0;
+};
+
+// Hash chains over the trailing 4 KiB window. Chain links are stored in a ring
+// indexed by position, so memory use is independent of the input size.
+class MatchFinder {
+public:
+  MatchFinder(std::span<const u8> src, u32 max_chain)
+      : mSrc(src), mMaxChain(max_chain), mHead(HashSize, -1),
+        mPrev(WindowSize, -1) {}
+
+  //! Make `pos` available as a match source for later positions.
+  void insert(u32 pos) {
+    if (pos + MinMatch > mSrc.size())
+      return;
+    const u32 h = hash(pos);
+    mPrev[pos % WindowSize] = mHead[h];
+    mHead[h] = pos;
+  }
+
+  //! Longest match for `pos` against previously inserted positions.
+  Match find(u32 pos) const {
+    const u32 limit = std::min<u32>(MaxMatch, mSrc.size() - pos);
+    if (limit < MinMatch)
+      return {};
+
+    const u8* cur = mSrc.data() + pos;
+    Match best;
+    s32 cand = mHead[hash(pos)];
+    for (u32 chain = mMaxChain; cand >= 0 && chain != 0; --chain) {
+      const u32 dist = pos - cand;
+      if (dist > WindowSize)
+        break;
+
+      const u8* ref = mSrc.data() + cand;
+      // Cheap rejection: a longer match must also agree on this byte
+      if (ref[best.len] == cur[best.len]) {
+        u32 len = 0;
+        while (len < limit && ref[len] == cur[len])
+          ++len;
+        if (len > best.len) {
+          best = {.len = len, .dist = dist};
+          if (len == limit)
+            break;
+        }
+      }
+
+      const s32 next = mPrev[cand % WindowSize];
+      if (next >= cand)
+        break;
+      cand = next;
+    }
+
+    return best.len >= MinMatch ? best : Match{};
+  }
+
+private:
+  static constexpr u32 HashBits = 15;
+  static constexpr u32 HashSize = 1 << HashBits;
+
+  u32 hash(u32 pos) const {
+    const u32 v = (mSrc[pos] << 16) | (mSrc[pos + 1] << 8) | mSrc[pos + 2];
+    return (v * 2654435761u) >> (32 - HashBits);
+  }
+
+  std::span<const u8> mSrc;
+  u32 mMaxChain;
+  std::vector<s32> mHead;
+  std::vector<s32> mPrev;
+};
+
+// The encoders below compress src[begin:], using src[:begin] only as history.
+
+void primeWindow(MatchFinder& finder, u32 begin) {
+  for (u32 pos = begin - std::min(begin, WindowSize); pos < begin; ++pos)
+    finder.insert(pos);
+}
+
+void encodeGreedy(std::span<const u8> src, u32 begin, GroupWriter& out) {
+  MatchFinder finder(src, 16);
+  primeWindow(finder, begin);
+
+  for (u32 pos = begin; pos < src.size();) {
+    const Match m = finder.find(pos);
+    if (m.len == 0) {
+      out.literal(src[pos]);
+      finder.insert(pos++);
+      continue;
+    }
+    out.backref(m.dist, m.len);
+    for (const u32 end = pos + m.len; pos < end; ++pos)
+      finder.insert(pos);
+  }
+}
+
+void encodeLazy(std::span<const u8> src, u32 begin, GroupWriter& out) {
+  MatchFinder finder(src, 64);
+  primeWindow(finder, begin);
+
+  u32 pos = begin;
+  Match cur = finder.find(pos);
+  while (pos < src.size()) {
+    if (cur.len == 0) {
+      out.literal(src[pos]);
+      finder.insert(pos++);
+      cur = finder.find(pos);
+      continue;
+    }
+
+    finder.insert(pos);
+    const Match next =
+        cur.len < MaxMatch ? finder.find(pos + 1) : Match{};
+    if (next.len > cur.len) {
+      out.literal(src[pos++]);
+      cur = next;
+      continue;
+    }
+
+    out.backref(cur.dist, cur.len);
+    for (const u32 end = pos + cur.len; ++pos < end;)
+      finder.insert(pos);
+    cur = finder.find(pos);
+  }
+}
+
+// Matches are priced in bits, including the group header flag.
+constexpr u32 LiteralCost = 1 + 8;
+constexpr u32 matchCost(u32 len) { return len < 0x12 ? 1 + 16 : 1 + 24; }
+
+void encodeOptimal(std::span<const u8> src, u32 begin, GroupWriter& out) {
+  MatchFinder finder(src, 256);
+  primeWindow(finder, begin);
+
+  // The parse is solved per block to bound memory; matches may still refer
+  // back across block boundaries, they just may not extend past the end.
+  constexpr u32 BlockSize = 0x10000;
+  std::vector<Match> matches(BlockSize);
+  std::vector<u32> cost(BlockSize + 1);
+  std::vector<u16> choice(BlockSize);
+
+  for (u32 block = begin; block < src.size(); block += BlockSize) {
+    const u32 size = std::min<u32>(BlockSize, src.size() - block);
+
+    for (u32 i = 0; i < size; ++i) {
+      matches[i] = finder.find(block + i);
+      finder.insert(block + i);
+    }
+
+    cost[size] = 0;
+    for (u32 i = size; i-- > 0;) {
+      u32 best = LiteralCost + cost[i + 1];
+      u32 best_len = 1;
+
+      const u32 max_len = std::min(matches[i].len, size - i);
+      // A maximal match in a long run is almost always the right call, and
+      // skipping the scan keeps the parse linear on degenerate input.
+      const u32 min_len = max_len == MaxMatch ? MaxMatch : MinMatch;
+      for (u32 len = max_len; len >= min_len && len >= MinMatch; --len) {
+        const u32 c = matchCost(len) + cost[i + len];
+        if (c < best) {
+          best = c;
+          best_len = len;
+        }
+      }
+
+      cost[i] = best;
+      choice[i] = best_len;
+    }
+
+    for (u32 i = 0; i < size; i += choice[i]) {
+      if (choice[i] == 1)
+        out.literal(src[block + i]);
+      else
+        out.backref(matches[i].dist, choice[i]);
+    }
+  }
+}
+
+void encodeRange(std::span<const u8> src, u32 begin, Algo algo,
+                 GroupWriter& out) {
+  switch (algo) {
+  case Algo::Stored:
+    for (u32 pos = begin; pos < src.size(); ++pos)
+      out.literal(src[pos]);
+    break;
+  case Algo::Greedy:
+    encodeGreedy(src, begin, out);
+    break;
+  case Algo::Lazy:
+    encodeLazy(src, begin, out);
+    break;
+  case Algo::Optimal:
+    encodeOptimal(src, begin, out);
+    break;
+  }
+}
+
+} // namespace
+
+std::vector<u8> encode(std::span<const u8> src, Algo algo) {
+  if (algo == Algo::Stored)
+    return encodeFast(src);
+
+  std::vector<u8> result(16);
+  result.reserve(16 + src.size() / 2);
+  writeHeader(result, src.size());
+
+  GroupWriter writer(result);
+  encodeRange(src, 0, algo, writer);
+
+  return result;
+}
+
+std::vector<u8> encodeParallel(std::span<const u8> src, Algo algo,
+                               u32 num_threads) {
+  // Fixed so that the output never depends on the thread count
+  constexpr u32 RegionSize = 0x40000;
+
+  if (algo == Algo::Stored || src.size() <= RegionSize)
+    return encode(src, algo);
+
+  struct Region {
+    std::vector<u8> stream;
+    u32 num_chunks = 0;
+  };
+  const u32 num_regions = roundUp(src.size(), RegionSize) / RegionSize;
+  std::vector<Region> regions(num_regions);
+
+  rsl::ParallelFor(
+      num_regions, 1,
+      [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+          const u32 begin = i * RegionSize;
+          const u32 end = std::min<u32>(begin + RegionSize, src.size());
+
+          auto& region = regions[i];
+          region.stream.reserve((end - begin) / 2);
+          GroupWriter writer(region.stream);
+          encodeRange(src.subspan(0, end), begin, algo, writer);
+          region.num_chunks = writer.numChunks();
+        }
+      },
+      num_threads);
+
+  std::size_t total = 16;
+  for (auto& region : regions)
+    total += region.stream.size();
+
+  std::vector<u8> result(16);
+  result.reserve(total);
+  writeHeader(result, src.size());
+
+  // Regions may end mid-group, so their chunks are regrouped serially
+  GroupWriter writer(result);
+  for (auto& region : regions)
+    writer.append(region.stream, region.num_chunks);
 
   return result;
 }
@@ -10,6 +10,54 @@ namespace librii::szs {
 // 0 if invalid
 u32 getExpandedSize(std::span<const u8> src);
 llvm::Error decode(std::span<u8> dst, std::span<const u8> src);
+
+//! Expands a Yaz0 stream on demand, so the start of a file can be inspected
+//! (or rejected) before the rest of it has been decompressed.
+class StreamDecoder {
+public:
+  //! `dst` must hold at least getExpandedSize(src) bytes.
+  StreamDecoder(std::span<u8> dst, std::span<const u8> src);
+
+  //! Expand until at least `size` bytes are available, or the end of the file.
+  //! Decoding proceeds a group at a time, so slightly more may be produced.
+  llvm::Error decodeUntil(std::size_t size);
+  llvm::Error decodeAll() { return decodeUntil(mDst.size()); }
+
+  //! The expanded prefix produced so far
+  std::span<const u8> available() const { return mDst.subspan(0, mOut); }
+  bool done() const { return mOut == mDst.size(); }
+
+private:
+  std::span<u8> mDst;
+  std::span<const u8> mSrc;
+  std::size_t mIn = 16;
+  std::size_t mOut = 0;
+  bool mHeaderError = false;
+};
+
+//! Compression strategies, cheapest first. All produce valid Yaz0 streams.
+enum class Algo {
+  //! Every byte is stored as a literal; output is ~12% larger than the input.
+  Stored,
+  //! Hash-chain match finder; always takes the longest match available.
+  Greedy,
+  //! Like Greedy, but defers a match by one byte when the next position has a
+  //! longer one. Comparable ratio to Nintendo's own encoder.
+  Lazy,
+  //! Minimum-cost parse over the longest matches at every position.
+  Optimal,
+};
+
+std::vector<u8> encode(std::span<const u8> src, Algo algo = Algo::Lazy);
+
+//! Compresses fixed-size regions of `src` concurrently on `num_threads` workers
+//! (0: one per hardware thread). Each region is primed with the preceding
+//! window, so back-references still cross region boundaries. The output
+//! depends only on `src` and `algo`, never on the thread count.
+std::vector<u8> encodeParallel(std::span<const u8> src,
+                               Algo algo = Algo::Lazy, u32 num_threads = 0);
+
+//! Literal-only encoding (Algo::Stored)
 std::vector<u8> encodeFast(std::span<const u8> src);
 
 } // namespace librii::szs
@@ -1,5 +1,7 @@
 #include "U8.hpp"
+#include <algorithm>
 #include <core/common.h>
+#include <cstring>
 #include <rsl/SimpleReader.hpp>
 #include <unordered_map>
 
@@ -75,7 +77,31 @@ bool RangeContainsInclusive(std::span<const u8> range, const void* ptr) {
   return ptr >= range.data() && ptr <= range.data() + range.size();
 }
 
-bool LoadU8Archive(LowU8Archive& result, std::span<const u8> data) {
+u32 GetU8NodeTableEnd(std::span<const u8> data, u32 archive_size) {
+  rvlArchiveHeader header;
+  if (data.size_bytes() < sizeof(header))
+    return 0;
+  std::memcpy(&header, data.data(), sizeof(header));
+
+  // Untrusted: compared signed, then summed without overflow
+  constexpr s32 header_size = static_cast<s32>(sizeof(header));
+  const s32 nodes_offset = header.nodes.offset;
+  const s32 nodes_size = header.nodes.size;
+  const s32 files_offset = header.files.offset;
+  if (header.magic != 0x55aa382d || nodes_offset < header_size ||
+      nodes_size < 0 || files_offset < header_size)
+    return 0;
+
+  const u64 end = std::max(static_cast<u64>(nodes_offset) +
+                               static_cast<u64>(nodes_size),
+                           static_cast<u64>(files_offset));
+  if (end > archive_size)
+    return 0;
+  return static_cast<u32>(end);
+}
+
+// Reads everything but the file data, which may not be available yet
+static bool LoadU8ArchiveNodes(LowU8Archive& result, std::span<const u8> data) {
   if (!SafeMemCopy(result.header, data))
     return false;
 
@@ -103,7 +129,7 @@ bool LoadU8Archive(LowU8Archive& result, std::span<const u8> data) {
 
   auto* fd_begin = rvlArchiveHeaderGetFileData(
       reinterpret_cast<const rvlArchiveHeader*>(data.data()));
-  if (!RangeContains(data, fd_begin))
+  if (!RangeContainsInclusive(data, fd_begin))
     return false;
 
   // For some reason the FD pointer is actually just the start of the file
@@ -116,17 +142,27 @@ bool LoadU8Archive(LowU8Archive& result, std::span<const u8> data) {
     }
   }
 
-  result.file_data = {fd_begin, data.data() + data.size()};
-
   return true;
 }
 
-bool LoadU8Archive(U8Archive& result, std::span<const u8> data) {
-  LowU8Archive low;
-  if (!LoadU8Archive(low, data))
+bool LoadU8Archive(LowU8Archive& result, std::span<const u8> data) {
+  if (!LoadU8ArchiveNodes(result, data))
     return false;
 
+  auto* fd_begin = rvlArchiveHeaderGetFileData(
+      reinterpret_cast<const rvlArchiveHeader*>(data.data()));
+  if (!RangeContains(data, fd_begin))
+    return false;
+
+  result.file_data = {fd_begin, data.data() + data.size()};
+
+  return true;
+}
+
+static void ConvertNodes(U8Archive& result, const LowU8Archive& low) {
   result.watermark = low.header.watermark;
+  result.nodes.clear();
+  result.nodes.reserve(low.nodes.size());
   for (auto& node : low.nodes) {
     U8Archive::Node tmp = {.is_folder = (bool)rvlArchiveNodeIsFolder(node),
                            .name = low.strings.data() +
@@ -141,7 +177,26 @@ bool LoadU8Archive(U8Archive& result, std::span<const u8> data) {
 
     result.nodes.push_back(tmp);
   }
+}
+
+bool LoadU8ArchiveNodes(U8Archive& result, std::span<const u8> data,
+                        u32& file_data_offset) {
+  LowU8Archive low;
+  if (!LoadU8ArchiveNodes(low, data))
+    return false;
+
+  ConvertNodes(result, low);
+  result.file_data.clear();
+  file_data_offset = low.header.files.offset;
+  return true;
+}
+
+bool LoadU8Archive(U8Archive& result, std::span<const u8> data) {
+  LowU8Archive low;
+  if (!LoadU8Archive(low, data))
+    return false;
 
+  ConvertNodes(result, low);
   result.file_data = std::move(low.file_data);
   return true;
 }
@@ -203,4 +258,85 @@ std::vector<u8> SaveU8Archive(const U8Archive& arc) {
   return result;
 }
 
+static std::string NormalizePath(std::string_view path) {
+  std::string result;
+  while (!path.empty()) {
+    const auto sep = path.find_first_of("/\\");
+    const auto part = path.substr(0, sep);
+    path = sep == std::string_view::npos ? "" : path.substr(sep + 1);
+
+    if (part.empty() || part == ".")
+      continue;
+    if (!result.empty())
+      result += '/';
+    result += part;
+  }
+  return result;
+}
+
+U8PathIndex::U8PathIndex(const U8Archive& arc) {
+  const u32 count = arc.nodes.size();
+  if (count == 0)
+    return;
+
+  // Nodes are stored in preorder: a folder's descendants immediately follow
+  // it, up to (but excluding) its sibling_next.
+  std::vector<u32> parents(count, 0);
+  std::vector<u32> num_children(count + 1, 0);
+  {
+    struct Open {
+      u32 folder;
+      u32 end;
+    };
+    std::vector<Open> stack{{0, count}};
+    for (u32 i = 1; i < count; ++i) {
+      while (stack.size() > 1 && i >= stack.back().end)
+        stack.pop_back();
+
+      parents[i] = stack.back().folder;
+      ++num_children[parents[i]];
+
+      if (arc.nodes[i].is_folder) {
+        // Malformed archives are clamped rather than trusted
+        const u32 end = std::clamp<u32>(arc.nodes[i].folder.sibling_next,
+                                        i + 1, stack.back().end);
+        stack.push_back({i, end});
+      }
+    }
+  }
+
+  mChildBegin.resize(count + 1);
+  u32 total = 0;
+  for (u32 i = 0; i <= count; ++i) {
+    mChildBegin[i] = total;
+    total += num_children[i];
+  }
+  mChildren.resize(total);
+  std::vector<u32> fill(mChildBegin.begin(), mChildBegin.end() - 1);
+  for (u32 i = 1; i < count; ++i)
+    mChildren[fill[parents[i]]++] = i;
+
+  mPaths.resize(count);
+  mLookup.reserve(count);
+  mLookup.emplace("", 0);
+  for (u32 i = 1; i < count; ++i) {
+    const auto& parent = mPaths[parents[i]];
+    const auto& name = arc.nodes[i].name;
+    if (name.empty() || name == ".")
+      mPaths[i] = parent;
+    else
+      mPaths[i] = parent.empty() ? name : parent + "/" + name;
+
+    // The first node wins for duplicate paths, matching a linear search
+    mLookup.emplace(mPaths[i], i);
+  }
+}
+
+std::optional<u32> U8PathIndex::find(std::string_view path) const {
+  auto it = mLookup.find(NormalizePath(path));
+  if (it == mLookup.end())
+    return std::nullopt;
+  return it->second;
+}
+
 } // namespace librii::U8
@@ -2,8 +2,11 @@
 
 #include <array>
 #include <core/common.h>
+#include <optional>
 #include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace librii::U8 {
@@ -30,6 +33,54 @@ struct U8Archive {
 };
 
 bool LoadU8Archive(U8Archive& result, std::span<const u8> data);
+
+//! Size of the archive prefix (header, nodes and string table) needed to read
+//! the node table. `data` must hold at least the 32-byte header; returns 0 if
+//! it is not a valid U8 header or the prefix would not fit in `archive_size`
+//! bytes.
+u32 GetU8NodeTableEnd(std::span<const u8> data, u32 archive_size);
+
+//! Reads only the node table from a prefix of the archive, leaving `file_data`
+//! empty. File offsets are relative to `file_data_offset` in the archive.
+bool LoadU8ArchiveNodes(U8Archive& result, std::span<const u8> data,
+                        u32& file_data_offset);
 std::vector<u8> SaveU8Archive(const U8Archive& arc);
 
+//! Path lookup over an archive's node table, built once in O(nodes).
+//!
+//! Paths are '/'-separated and relative to the root. Empty and "." components
+//! are ignored, so "./course_model.brres" and "course_model.brres" resolve to
+//! the same node whether or not the archive has a top-level "." folder.
+class U8PathIndex {
+public:
+  U8PathIndex() = default;
+  explicit U8PathIndex(const U8Archive& arc);
+
+  //! Node index of a file or folder
+  std::optional<u32> find(std::string_view path) const;
+
+  //! Direct children of a folder node, in archive order
+  std::span<const u32> children(u32 folder) const {
+    return std::span(mChildren).subspan(mChildBegin[folder],
+                                        mChildBegin[folder + 1] -
+                                            mChildBegin[folder]);
+  }
+
+  //! Normalized path of a node
+  const std::string& path(u32 node) const { return mPaths[node]; }
+
+private:
+  std::vector<std::string> mPaths;
+  std::unordered_map<std::string, u32> mLookup;
+  // Children of node i are mChildren[mChildBegin[i]:mChildBegin[i + 1]]
+  std::vector<u32> mChildren;
+  std::vector<u32> mChildBegin;
+};
+
+//! Contents of a file node
+inline std::span<const u8> GetFileData(const U8Archive& arc, u32 node) {
+  const auto& file = arc.nodes[node].file;
+  return std::span(arc.file_data).subspan(file.offset, file.size);
+}
+
 } // namespace librii::U8
@@ -0,0 +1,58 @@
+#include "data_provider.hxx"
+#include <fstream>
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#define OISHII_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace oishii {
+
+static std::optional<std::vector<u8>> ReadWholeFile(std::string_view path) {
+  std::ifstream file(std::string(path), std::ios::binary | std::ios::ate);
+  if (!file)
+    return std::nullopt;
+
+  std::vector<u8> vec(file.tellg());
+  file.seekg(0, std::ios::beg);
+
+  if (!file.read(reinterpret_cast<char*>(vec.data()), vec.size()))
+    return std::nullopt;
+
+  return vec;
+}
+
+std::optional<DataProvider> DataProvider::fromFile(std::string_view file_path) {
+#ifdef OISHII_HAS_MMAP
+  const int fd = ::open(std::string(file_path).c_str(), O_RDONLY);
+  if (fd >= 0) {
+    struct stat st;
+    void* map = MAP_FAILED;
+    // Empty files cannot be mapped
+    if (::fstat(fd, &st) == 0 && st.st_size > 0)
+      map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping holds its own reference to the file
+    ::close(fd);
+
+    if (map != MAP_FAILED) {
+      const std::size_t size = st.st_size;
+      std::shared_ptr<const void> mapping(
+          map, [size](const void* p) { ::munmap(const_cast<void*>(p), size); });
+      DataProvider provider({static_cast<const u8*>(map), size},
+                            std::move(mapping), file_path);
+      provider.mIsMapped = true;
+      return provider;
+    }
+  }
+#endif
+
+  auto data = ReadWholeFile(file_path);
+  if (!data.has_value())
+    return std::nullopt;
+  return DataProvider(std::move(*data), file_path);
+}
+
+} // namespace oishii
@@ -2,6 +2,8 @@
 
 #include "types.hxx"
 #include <assert.h>
+#include <memory>
+#include <optional>
 #include <span>
 #include <string>
 #include <string_view>
@@ -52,30 +54,58 @@ public:
                std::string_view file_path = "<unknown file>")
       : mData(std::move(data)), mPath(file_path) {}
 
+  //! Construct a `DataProvider` over memory held elsewhere, without copying
+  //! it. `owner` keeps the memory alive for as long as any copy of the
+  //! provider; it may be null if the caller guarantees `data` outlives them.
+  DataProvider(std::span<const u8> data, std::shared_ptr<const void> owner,
+               std::string_view file_path = "<unknown file>")
+      : mOwner(std::move(owner)), mView(data), mIsView(true),
+        mPath(file_path) {}
+
+  //! Open a file through a read-only memory map, so that only the pages
+  //! actually read are loaded. Falls back to reading the whole file if it
+  //! cannot be mapped (or the platform lacks mmap).
+  static std::optional<DataProvider> fromFile(std::string_view file_path);
+
   //! Get a read-only slice of the data.
   ByteView slice(std::size_t start = 0,
                  std::size_t extent = std::dynamic_extent) {
+    const auto data = bytes();
     const std::size_t adjusted_size =
-        extent == std::dynamic_extent ? mData.size() : extent;
-    std::span<const u8> sliced_span{mData.data() + start, adjusted_size};
+        extent == std::dynamic_extent ? data.size() : extent;
+    std::span<const u8> sliced_span{data.data() + start, adjusted_size};
     return {sliced_span, *this, mPath};
   }
 
   std::string_view getFilePath() const { return mPath; }
 
+  //! Whether the data is a view of a memory-mapped file
+  bool isMapped() const { return mIsMapped; }
+
   // For ByteView to compute file offsets.
   std::ptrdiff_t computeOffset(const u8* element) const {
-    assert(element < mData.data() + mData.size() &&
-           "element is out of bounds.");
-    if (element > mData.data() + mData.size())
+    const auto data = bytes();
+    assert(element < data.data() + data.size() && "element is out of bounds.");
+    if (element > data.data() + data.size())
       return 0;
-    return element - mData.data();
+    return element - data.data();
   }
 
 private:
+  std::span<const u8> bytes() const {
+    return mIsView ? mView : std::span<const u8>(mData);
+  }
+
   // We don't keep track of slices, which would hold dangling pointers if mData
-  // reallocated.
-  const std::vector<u8> mData;
+  // reallocated. It is never modified after construction.
+  std::vector<u8> mData;
+
+  // Data not owned by mData: a file mapping or another buffer. The owner
+  // releases it when the last copy of the provider is destroyed.
+  std::shared_ptr<const void> mOwner;
+  std::span<const u8> mView;
+  bool mIsView = false;
+  bool mIsMapped = false;
 
   std::string mPath;
 };
@@ -6,6 +6,7 @@
 #include <array>
 #include <bit>
 #include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -110,6 +111,21 @@ public:
             bool unaligned = false>
   std::array<T, num> readX();
 
+  //! @brief Read `out.size()` consecutive values, bounds checking once.
+  //!
+  //! Endian conversion is done in bulk (see swapEndianArray).
+  template <typename T, EndianSelect E = EndianSelect::Current,
+            bool unaligned = false>
+  void readArray(std::span<T> out);
+  //! @brief Append `count` consecutive values to `out`.
+  template <typename T, EndianSelect E = EndianSelect::Current,
+            bool unaligned = false>
+  void readArrayInto(std::vector<T>& out, std::size_t count) {
+    const auto old_size = out.size();
+    out.resize(old_size + count);
+    readArray<T, E, unaligned>(std::span<T>(out).subspan(old_size));
+  }
+
   template <typename T, EndianSelect E = EndianSelect::Current,
             bool unaligned = false>
   void transfer(T& out) {
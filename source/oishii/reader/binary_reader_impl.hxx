@@ -32,6 +32,38 @@ template <typename T, EndianSelect E, bool unaligned> T BinaryReader::read() {
   return decoded;
 }
 
+template <typename T, EndianSelect E, bool unaligned>
+void BinaryReader::readArray(std::span<T> out) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  using integral_t = integral_of_equal_size_t<T>;
+
+  const u32 size = static_cast<u32>(out.size_bytes());
+  if (size == 0)
+    return;
+  boundsCheck(size);
+  if (!unaligned)
+    alignmentCheck(sizeof(T));
+
+#ifndef NDEBUG
+  for (const auto& bp : mBreakPoints) {
+    if (tell() < bp.offset + bp.size && bp.offset < tell() + size) {
+      printf("Reading from %04u (0x%04x) sized %u\n", tell(), tell(), size);
+      warnAt("Breakpoint hit", tell(), tell() + size);
+      __debugbreak();
+    }
+  }
+#endif
+
+  const u8* src = getStreamStart() + tell();
+  if (endianDecode<integral_t, E>(integral_t(1)) == integral_t(1))
+    std::memcpy(out.data(), src, size);
+  else
+    swapEndianArray(reinterpret_cast<integral_t*>(out.data()),
+                    reinterpret_cast<const integral_t*>(src), out.size());
+
+  seek<Whence::Current>(size);
+}
+
 template <typename T, int num, EndianSelect E, bool unaligned>
 std::array<T, num> BinaryReader::readX() {
   std::array<T, num> result;
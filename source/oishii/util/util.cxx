@@ -1,7 +1,88 @@
 #include "util.hxx"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define OISHII_SWAP_AVX2
+#define OISHII_SWAP_SSSE3
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define OISHII_SWAP_SSSE3
+#endif
+
 namespace oishii {
 
 Console Console::sInstance;
 
+namespace {
+
+#ifdef OISHII_SWAP_SSSE3
+// Reverses bytes within each 2- or 4-byte lane of a 16-byte block
+template <std::size_t N> __m128i SwapMask128() {
+  if constexpr (N == 2)
+    return _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+  else
+    return _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+}
+#endif
+
+//! Swaps whole vector blocks, returning how many bytes were handled.
+template <std::size_t N>
+std::size_t SwapBlocks(u8* dst, const u8* src, std::size_t size) {
+  std::size_t i = 0;
+#ifdef OISHII_SWAP_AVX2
+  {
+    const __m256i mask = _mm256_broadcastsi128_si256(SwapMask128<N>());
+    for (; i + 32 <= size; i += 32) {
+      const __m256i v =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                          _mm256_shuffle_epi8(v, mask));
+    }
+  }
+#endif
+#ifdef OISHII_SWAP_SSSE3
+  {
+    const __m128i mask = SwapMask128<N>();
+    for (; i + 16 <= size; i += 16) {
+      const __m128i v =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                       _mm_shuffle_epi8(v, mask));
+    }
+  }
+#endif
+  (void)dst;
+  (void)src;
+  (void)size;
+  return i;
+}
+
+} // namespace
+
+void swapEndianArray16(void* dst, const void* src, std::size_t count) {
+  auto* out = static_cast<u8*>(dst);
+  const auto* in = static_cast<const u8*>(src);
+  const std::size_t size = count * 2;
+
+  for (std::size_t i = SwapBlocks<2>(out, in, size); i < size; i += 2) {
+    u16 v;
+    std::memcpy(&v, in + i, 2);
+    v = swap16(v);
+    std::memcpy(out + i, &v, 2);
+  }
+}
+
+void swapEndianArray32(void* dst, const void* src, std::size_t count) {
+  auto* out = static_cast<u8*>(dst);
+  const auto* in = static_cast<const u8*>(src);
+  const std::size_t size = count * 4;
+
+  for (std::size_t i = SwapBlocks<4>(out, in, size); i < size; i += 4) {
+    u32 v;
+    std::memcpy(&v, in + i, 4);
+    v = swap32(v);
+    std::memcpy(out + i, &v, 4);
+  }
+}
+
 } // namespace oishii
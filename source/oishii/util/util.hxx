@@ -12,6 +12,8 @@
 
 #include "../options.hxx"
 #include "../types.hxx"
+#include <cstddef>
+#include <cstring>
 
 namespace oishii {
 // Console colors
@@ -137,6 +139,27 @@ template <typename T> inline T swapEndian(T v) {
   return T{};
 }
 
+//! @brief Byte swap an array of 16-bit words. `dst` may equal `src`.
+//!
+//! Uses SSSE3/AVX2 shuffles when available, scalar otherwise.
+void swapEndianArray16(void* dst, const void* src, std::size_t count);
+//! @brief Byte swap an array of 32-bit words. `dst` may equal `src`.
+void swapEndianArray32(void* dst, const void* src, std::size_t count);
+
+//! @brief Copy `count` values of type T, swapping each one.
+template <typename T>
+inline void swapEndianArray(T* dst, const T* src, std::size_t count) {
+  static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4,
+                "T must of size 1, 2, or 4");
+
+  if constexpr (sizeof(T) == 4)
+    swapEndianArray32(dst, src, count);
+  else if constexpr (sizeof(T) == 2)
+    swapEndianArray16(dst, src, count);
+  else if (dst != src)
+    std::memcpy(dst, src, count);
+}
+
 enum class EndianSelect {
   Current, // Grab current endian
   // Explicitly use endian
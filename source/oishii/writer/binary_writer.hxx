@@ -1,6 +1,8 @@
 #pragma once
 
 #include <bit>
+#include <cstring>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -24,8 +26,7 @@ public:
   void write(T val, bool checkmatch = true) {
     using integral_t = integral_of_equal_size_t<T>;
 
-    while (tell() + sizeof(T) > mBuf.size())
-      mBuf.push_back(0);
+    ensureSize(tell() + sizeof(T));
 
     breakPointProcess(sizeof(T));
 
@@ -59,8 +60,7 @@ public:
   }
   template <EndianSelect E = EndianSelect::Current>
   void writeN(std::size_t sz, u32 val) {
-    while (tell() + sz > mBuf.size())
-      mBuf.push_back(0);
+    ensureSize(tell() + sz);
 
     u32 decoded = endianDecode<u32, E>(val);
 
@@ -86,6 +86,48 @@ public:
     seek<Whence::Current>(sz);
   }
 
+  //! @brief Write a raw block of bytes (no endian conversion).
+  void writeBytes(std::span<const u8> data) {
+    if (data.empty())
+      return;
+    ensureSize(tell() + data.size());
+    breakPointProcess(static_cast<u32>(data.size()));
+#ifndef NDEBUG
+    checkMatch(data.data(), data.size());
+#endif
+    std::memcpy(&mBuf[tell()], data.data(), data.size());
+    seek<Whence::Current>(static_cast<int>(data.size()));
+  }
+
+  //! @brief Write an array of values, endian converting each element.
+  //!
+  //! Equivalent to calling write<T, E>() per element, but sizes the buffer
+  //! once and swaps in bulk (see swapEndianArray).
+  template <typename T, EndianSelect E = EndianSelect::Current>
+  void writeArray(std::span<const T> values) {
+    using integral_t = integral_of_equal_size_t<T>;
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    const std::size_t bytes = values.size() * sizeof(T);
+    if (bytes == 0)
+      return;
+    ensureSize(tell() + bytes);
+    breakPointProcess(static_cast<u32>(bytes));
+
+    u8* dst = &mBuf[tell()];
+    if (endianDecode<integral_t, E>(integral_t(1)) == integral_t(1)) {
+      std::memcpy(dst, values.data(), bytes);
+    } else {
+      swapEndianArray(reinterpret_cast<integral_t*>(dst),
+                      reinterpret_cast<const integral_t*>(values.data()),
+                      values.size());
+    }
+#ifndef NDEBUG
+    checkMatch(dst, bytes);
+#endif
+    seek<Whence::Current>(static_cast<int>(bytes));
+  }
+
   std::string mNameSpace = ""; // set by linker, stored in reservations
   std::string mBlockName = ""; // set by linker, stored in reservations
 
@@ -174,6 +216,18 @@ public:
   }
 
 private:
+#ifndef NDEBUG
+  void checkMatch(const u8* data, std::size_t size) {
+    if (mDebugMatch.size() <= tell() + size)
+      return;
+    if (std::memcmp(&mDebugMatch[tell()], data, size) != 0) {
+      fprintf(stderr, "Matching violation in block at %x (size %x)\n", tell(),
+              static_cast<u32>(size));
+      __debugbreak();
+    }
+  }
+#endif
+
   std::endian mFileEndian = std::endian::big; // to swap
 };
 
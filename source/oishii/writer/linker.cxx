@@ -27,102 +27,86 @@ public:
                                       const std::string& nameSpace,
                                       const std::string& blockName,
                                       std::string& resultName) {
-    // TODO: This can be optimized, no need to check two constructed strings
+    const auto find = [&](const std::string& nameSpacedSymbol) -> const Node* {
+      auto it = linker.mLayoutBySymbol.find(nameSpacedSymbol);
+      if (it == linker.mLayoutBySymbol.end())
+        return nullptr;
+      resultName = nameSpacedSymbol;
+      return linker.mLayout[it->second].mNode.get();
+    };
 
     // On same level
-    {
-      const std::string nameSpacedSymbol =
-          nameSpace.empty() ? symbol : nameSpace + "::" + symbol;
-      for (const auto& entry : linker.mLayout)
-        if ((entry.mNamespace.empty()
-                 ? entry.mNode->getId()
-                 : entry.mNamespace + "::" + entry.mNode->getId()) ==
-            nameSpacedSymbol) {
-          // if (resultName)
-          resultName = nameSpacedSymbol;
-          return entry.mNode.get();
-        }
-    }
+    if (const auto* node =
+            find(nameSpace.empty() ? symbol : nameSpace + "::" + symbol))
+      return node;
     // Children
     {
       std::string nameSpacePrefix = nameSpace.empty() ? "" : nameSpace + "::";
       //	if (hasEnding(nameSpacePrefix, "::::"))
       //		nameSpacePrefix = nameSpacePrefix.substr(0,
       // nameSpacePrefix.size() - 2);
-      const std::string nameSpacedSymbol =
-          nameSpacePrefix + (blockName.empty() ? "" : blockName + "::") +
-          symbol;
-      for (const auto& entry : linker.mLayout)
-        if ((entry.mNamespace.empty()
-                 ? entry.mNode->getId()
-                 : entry.mNamespace + "::" + entry.mNode->getId()) ==
-            nameSpacedSymbol) {
-          // if (resultName)
-          resultName = nameSpacedSymbol;
-          return entry.mNode.get();
-        }
+      if (const auto* node =
+              find(nameSpacePrefix +
+                   (blockName.empty() ? "" : blockName + "::") + symbol))
+        return node;
     }
     // Global
-    {
-      for (const auto& entry : linker.mLayout)
-        if ((entry.mNamespace.empty()
-                 ? entry.mNode->getId()
-                 : entry.mNamespace + "::" + entry.mNode->getId()) == symbol) {
-          // if (resultName)
-          resultName = symbol;
-          return entry.mNode.get();
-        }
-    }
+    if (const auto* node = find(symbol))
+      return node;
+
     printf("Search for %s failed!\n", symbol.c_str());
     assert(!"Failed critical namespaced symbol lookup in layout");
     return nullptr;
   }
+  static const Linker::MapEntry* findMapEntry(const Linker& linker,
+                                              const std::string& symbol) {
+    auto it = linker.mMapBySymbol.find(symbol);
+    return it != linker.mMapBySymbol.end() ? &linker.mMap[it->second]
+                                           : nullptr;
+  }
   // TODO: Offset might be better removed
   static u32 resolveHook(const Linker& linker, const std::string& symbol,
                          Hook::RelativePosition pos, int offset = 0) {
     std::string symbol_ = symbol;
-    // TODO: This can be much more optimized
     if (pos == Hook::RelativePosition::EndOfChildren) {
       if (!symbol_.empty())
         symbol_ += "::";
       symbol_ += "EndOfChildren";
     }
-    for (const auto& entry : linker.mMap) {
-      if (entry.symbol == symbol_) {
-        switch (pos) {
-        case Hook::RelativePosition::Begin:
-        case Hook::RelativePosition::EndOfChildren: // begin of marker node
-        {
-          auto roundDown = [](u32 in, u32 align) -> u32 {
-            return align ? in & ~(align - 1) : in;
-          };
-          auto roundUp = [roundDown](u32 in, u32 align) -> u32 {
-            return align ? roundDown(in + (align - 1), align) : in;
-          };
-          u32 x = entry.begin + offset;
-          // TODO: We don't need to make another pass from the start
-          u32 align = pos == Hook::RelativePosition::Begin
-                          ? entry.restrict.alignment
-                          : std::find_if(linker.mMap.begin(), linker.mMap.end(),
-                                         [symbol](auto& e) {
-                                           return e.symbol == symbol;
-                                         })
-                                ->restrict.alignment;
-          u32 rounded = roundUp(x, align);
-          return rounded;
-        }
-        case Hook::RelativePosition::End:
-          return entry.end + offset;
-        default:
-          printf("Linker Error: Unknown hook type %u -- assuming Begin (no "
-                 "align)\n",
-                 pos);
-          return entry.begin + offset;
-        }
+    const auto* entry = findMapEntry(linker, symbol_);
+    if (entry == nullptr) {
+      printf("Linker Error: Cannot resolve symbol \"%s\"!\n",
+             symbol_.c_str());
+      return 0xcccccccc;
+    }
+
+    switch (pos) {
+    case Hook::RelativePosition::Begin:
+    case Hook::RelativePosition::EndOfChildren: // begin of marker node
+    {
+      auto roundDown = [](u32 in, u32 align) -> u32 {
+        return align ? in & ~(align - 1) : in;
+      };
+      auto roundUp = [roundDown](u32 in, u32 align) -> u32 {
+        return align ? roundDown(in + (align - 1), align) : in;
+      };
+      u32 x = entry->begin + offset;
+      u32 align = entry->restrict.alignment;
+      if (pos == Hook::RelativePosition::EndOfChildren) {
+        const auto* parent = findMapEntry(linker, symbol);
+        align = parent != nullptr ? parent->restrict.alignment : 0;
       }
+      u32 rounded = roundUp(x, align);
+      return rounded;
+    }
+    case Hook::RelativePosition::End:
+      return entry->end + offset;
+    default:
+      printf("Linker Error: Unknown hook type %u -- assuming Begin (no "
+             "align)\n",
+             pos);
+      return entry->begin + offset;
     }
-    printf("Linker Error: Cannot resolve symbol \"%s\"!\n", symbol_.c_str());
-    return 0xcccccccc;
   }
 };
 
@@ -133,11 +117,20 @@ struct EndOfChildrenMarker : public Node {
   const Node& mParent;
 };
 
+void Linker::addToLayout(std::unique_ptr<Node> node,
+                         const std::string& nameSpace) {
+  const Node* key = node.get();
+  const auto& entry = mLayout.emplace_back(std::move(node), nameSpace);
+  mLayoutBySymbol.emplace(entry.mSymbol, mLayout.size() - 1);
+  mLayoutByNode.emplace(key, mLayout.size() - 1);
+}
+
 // We call this recursively
 void Linker::gather(std::unique_ptr<Node> pRoot,
                     const std::string& nameSpace) noexcept {
   // Add the node
-  auto& root = *mLayout.emplace_back(std::move(pRoot), nameSpace).mNode.get();
+  auto& root = *pRoot;
+  addToLayout(std::move(pRoot), nameSpace);
 
   std::vector<std::unique_ptr<Node>> children;
   const Node::eResult result = root.getChildren(children);
@@ -149,9 +142,8 @@ void Linker::gather(std::unique_ptr<Node> pRoot,
            (nameSpace.empty() ? "" : (nameSpace + "::")) + root.getId());
 
   if (!(root.getLinkingRestriction().Leaf)) {
-    mLayout.emplace_back(std::make_unique<EndOfChildrenMarker>(root),
-                         (nameSpace.empty() ? "" : (nameSpace + "::")) +
-                             root.getId());
+    addToLayout(std::make_unique<EndOfChildrenMarker>(root),
+                (nameSpace.empty() ? "" : (nameSpace + "::")) + root.getId());
   }
 }
 
@@ -181,9 +173,9 @@ void Linker::write(Writer& writer, bool doShuffle) {
                  writer.tell() - pad_begin);
     }
     // Fill map: symbol and begin position
-    mMap.push_back({(entry.mNamespace.empty() ? "" : entry.mNamespace + "::") +
-                        entry.mNode->getId(),
-                    writer.tell(), 0, entry.mNode->getLinkingRestriction()});
+    mMap.push_back({entry.mSymbol, writer.tell(), 0,
+                    entry.mNode->getLinkingRestriction()});
+    mMapBySymbol.emplace(entry.mSymbol, mMap.size() - 1);
     // Write
     writer.mNameSpace = entry.mNamespace;
     writer.mBlockName = entry.mNode->getId();
@@ -216,7 +208,6 @@ void Linker::write(Writer& writer, bool doShuffle) {
 
   // TODO: map::ktpt::...::enpt is map::enpt
   for (const auto& reserve : writer.mLinkReservations) {
-    // todo: make map
     const u32 addr = static_cast<u32>(reserve.addr);
     const Link& link = reserve.mLink;
 
@@ -243,34 +234,19 @@ void Linker::write(Writer& writer, bool doShuffle) {
     //#endif
     // TODO: Generalize all of these from/to methods
     if (link.from.mBlock) {
-      bool bSuccess = false;
-      for (const auto& entry : mLayout) {
-        if (entry.mNode.get() == link.from.mBlock) {
-          fromBlockSymbol =
-              entry.mNamespace.empty()
-                  ? entry.mNode->getId()
-                  : entry.mNamespace + "::" + entry.mNode->getId();
-          bSuccess = true;
-          break;
-        }
-      }
-      if (!bSuccess)
+      auto it = mLayoutByNode.find(link.from.mBlock);
+      if (it != mLayoutByNode.end())
+        fromBlockSymbol = mLayout[it->second].mSymbol;
+      else
         printf("Linker Error: Block %s was never written to stream, so canot "
                "be resolved.\n",
                link.from.mBlock->getId().c_str());
     }
     if (link.to.mBlock) {
-      bool bSuccess = false;
-      for (const auto& entry : mLayout) {
-        if (entry.mNode.get() == link.to.mBlock) {
-          toBlockSymbol = entry.mNamespace.empty()
-                              ? entry.mNode->getId()
-                              : entry.mNamespace + "::" + entry.mNode->getId();
-          bSuccess = true;
-          break;
-        }
-      }
-      if (!bSuccess)
+      auto it = mLayoutByNode.find(link.to.mBlock);
+      if (it != mLayoutByNode.end())
+        toBlockSymbol = mLayout[it->second].mSymbol;
+      else
         printf("Linker Error: Block %s was never written to stream, so canot "
                "be resolved.\n",
                link.to.mBlock->getId().c_str());
@@ -8,6 +8,7 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "../types.hxx"
@@ -63,13 +64,25 @@ private:
   struct LayoutElement {
     std::unique_ptr<Node> mNode;
     std::string mNamespace;
+    //! Namespaced ID, computed once: `mNamespace::id`
+    std::string mSymbol;
 
     LayoutElement(std::unique_ptr<Node> node, const std::string& Namespace)
-        : mNode(std::move(node)), mNamespace(Namespace) {}
+        : mNode(std::move(node)), mNamespace(Namespace),
+          mSymbol(Namespace.empty() ? mNode->getId()
+                                    : Namespace + "::" + mNode->getId()) {}
   };
 
   std::vector<LayoutElement> mLayout;
 
+  // Indices into mLayout/mMap, built as they are filled. Where symbols repeat,
+  // the first element wins, as a linear search would.
+  std::unordered_map<std::string, std::size_t> mLayoutBySymbol;
+  std::unordered_map<const Node*, std::size_t> mLayoutByNode;
+  std::unordered_map<std::string, std::size_t> mMapBySymbol;
+
+  void addToLayout(std::unique_ptr<Node> node, const std::string& nameSpace);
+
 public:
   //! Associates namespaced IDs to writer positions.
   //!
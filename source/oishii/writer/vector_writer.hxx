@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../interfaces.hxx"
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -37,6 +38,15 @@ protected:
 #endif
 public:
   void resize(u32 sz) { mBuf.resize(sz); }
+  //! Zero-extend the buffer to at least `size` bytes. Capacity grows
+  //! geometrically so streams of small writes stay amortized O(1).
+  void ensureSize(std::size_t size) {
+    if (size <= mBuf.size())
+      return;
+    if (size > mBuf.capacity())
+      mBuf.reserve(std::max(size, mBuf.capacity() * 2));
+    mBuf.resize(size);
+  }
   u8* getDataBlockStart() { return mBuf.data(); }
   u32 getBufSize() { return (u32)mBuf.size(); }
 
@@ -91,6 +91,9 @@ struct AssimpContext {
   bool mGenerateMipMaps = true;
   int mMinMipDimension = 32;
   int mMaxMipCount = 5;
+  // Endpoint search of the CMPR encoder
+  librii::image::CmprQuality mCmprQuality =
+      librii::image::CmprQuality::Exhaustive;
   // Set stencil outline if alpha
   bool mAutoTransparent = true;
   //
@@ -163,6 +166,10 @@ void RenderContextSettings(AssimpContext& ctx) {
 
       ImGui::Indent(-50);
     }
+    int cmpr_quality = static_cast<int>(ctx.mCmprQuality);
+    ImGui::Combo("Compression quality"_j, &cmpr_quality,
+                 "Fastest\0Fast\0Best (slowest)\0");
+    ctx.mCmprQuality = static_cast<librii::image::CmprQuality>(cmpr_quality);
   }
   if (ImGui::CollapsingHeader((const char*)ICON_FA_BRUSH u8" Material Settings",
                               ImGuiTreeNodeFlags_DefaultOpen)) {
@@ -296,7 +303,7 @@ public:
     std::vector<std::string> mat_merge;
     mContext->unresolved = mContext->helper->PrepareAss(
         mContext->mGenerateMipMaps, mContext->mMinMipDimension,
-        mContext->mMaxMipCount, path);
+        mContext->mMaxMipCount, mContext->mCmprQuality, path);
 
     mContext->state = State::WaitForTextureDependencies;
     // This step might be optional
@@ -322,7 +329,7 @@ public:
     mContext->helper->ImportAss(
         mContext->additional_textures, mContext->mGenerateMipMaps,
         mContext->mMinMipDimension, mContext->mMaxMipCount,
-        mContext->mAutoTransparent,
+        mContext->mCmprQuality, mContext->mAutoTransparent,
         glm::vec3(mContext->model_tint[0], mContext->model_tint[1],
                   mContext->model_tint[2]));
 
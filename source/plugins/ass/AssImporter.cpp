@@ -511,6 +511,7 @@ auto ConvertWrapMode(aiTextureMapMode mapmode) {
 
 std::set<std::pair<std::size_t, std::string>>
 AssImporter::PrepareAss(bool mip_gen, int min_dim, int max_mip,
+                        librii::image::CmprQuality cmpr_quality,
                         const std::string& model_path) {
   root = pScene->mRootNode;
   assert(root != nullptr);
@@ -583,6 +584,9 @@ AssImporter::PrepareAss(bool mip_gen, int min_dim, int max_mip,
 
   std::set<std::pair<std::size_t, std::string>> unresolved;
 
+  TextureImportQueue queue(mip_gen, min_dim, max_mip);
+  queue.setCmprQuality(cmpr_quality);
+  std::vector<std::pair<std::size_t, std::string>> jobs;
   for (auto& tex : texturesToImport) {
     printf("Importing texture: %s\n", tex.c_str());
 
@@ -590,18 +594,22 @@ AssImporter::PrepareAss(bool mip_gen, int min_dim, int max_mip,
     auto& data = out_collection->getTextures().add();
     data.setName(getFileShort(tex));
 
-    if (!importTexture(data, tex.c_str(), scratch, mip_gen, min_dim, max_mip)) {
-      // Favor PNG, and the current directory
-      if (!importTexture(
-              data,
-              (std::filesystem::path(model_path).parent_path() / (tex + ".png"))
-                  .string()
-                  .c_str(),
-              scratch, mip_gen, min_dim, max_mip)) {
-        printf("Cannot find texture %s\n", tex.c_str());
-        unresolved.emplace(i, tex);
-      }
+    // Favor PNG, and the current directory
+    const auto alt_path =
+        (std::filesystem::path(model_path).parent_path() / (tex + ".png"))
+            .string();
+    queue.add(data, {tex, alt_path});
+    jobs.emplace_back(i, tex);
+  }
+  const auto results = queue.run();
+  for (std::size_t j = 0; j < jobs.size(); ++j) {
+    if (!results[j].imported) {
+      printf("Cannot find texture %s\n", jobs[j].second.c_str());
+      unresolved.insert(jobs[j]);
+      continue;
     }
+    printf("Imported texture %s in %.1f ms%s\n", jobs[j].second.c_str(),
+           results[j].ms, results[j].shared ? " (shared)" : "");
   }
 
   return unresolved;
@@ -609,13 +617,19 @@ AssImporter::PrepareAss(bool mip_gen, int min_dim, int max_mip,
 
 void AssImporter::ImportAss(
     const std::vector<std::pair<std::size_t, std::vector<u8>>>& data,
-    bool mip_gen, int min_dim, int max_mip, bool auto_outline, glm::vec3 tint) {
-  for (auto& [idx, idata] : data) {
-    auto& data = out_collection->getTextures()[idx];
-    bool imported = importTexture(data, idata.data(), idata.size(), scratch,
-                                  mip_gen, min_dim, max_mip);
-    (void)imported;
-    assert(imported);
+    bool mip_gen, int min_dim, int max_mip,
+    librii::image::CmprQuality cmpr_quality, bool auto_outline,
+    glm::vec3 tint) {
+  TextureImportQueue queue(mip_gen, min_dim, max_mip);
+  queue.setCmprQuality(cmpr_quality);
+  for (auto& [idx, idata] : data)
+    queue.add(out_collection->getTextures()[idx], idata);
+  const auto results = queue.run();
+  for (std::size_t j = 0; j < data.size(); ++j) {
+    assert(results[j].imported);
+    printf("Imported texture %s in %.1f ms%s\n",
+           out_collection->getTextures()[data[j].first].getName().c_str(),
+           results[j].ms, results[j].shared ? " (shared)" : "");
   }
   std::unordered_map<std::string, libcube::Texture*> tex_lut;
   for (auto& tex : out_collection->getTextures())
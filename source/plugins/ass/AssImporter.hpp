@@ -3,6 +3,7 @@
 #include <core/common.h>
 #include <core/kpi/Plugins.hpp>
 #include <glm/glm.hpp>
+#include <librii/image/CmprEncoder.hpp>
 #include <map>
 #include <plugins/gc/Export/IndexedPolygon.hpp>
 #include <plugins/j3d/Scene.hpp>
@@ -35,10 +36,12 @@ public:
 
   std::set<std::pair<std::size_t, std::string>>
   PrepareAss(bool mip_gen, int min_dim, int max_mip,
+             librii::image::CmprQuality cmpr_quality,
              const std::string& model_path);
   void
   ImportAss(const std::vector<std::pair<std::size_t, std::vector<u8>>>& data,
-            bool mip_gen, int min_dim, int max_mip, bool auto_outline,
+            bool mip_gen, int min_dim, int max_mip,
+            librii::image::CmprQuality cmpr_quality, bool auto_outline,
             glm::vec3 tint);
 
   void SetTransaction(kpi::IOTransaction& t) { transaction = &t; }
@@ -1,6 +1,16 @@
 #include "ImportTexture.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <llvm/Support/xxhash.h>
+#include <mutex>
+#include <optional>
 #include <plugins/gc/Export/Texture.hpp>
+#include <rsl/ParallelFor.hpp>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <vendor/stb_image.h>
 
@@ -8,9 +18,9 @@ namespace riistudio::ass {
 
 const auto power_of_2 = [](u32 x) { return (x & (x - 1)) == 0; };
 
-bool importTexture(libcube::Texture& data, u8* image, std::vector<u8>& scratch,
-                   bool mip_gen, int min_dim, int max_mip, int width,
-                   int height, int channels) {
+bool importTexture(libcube::Texture& data, u8* image, bool mip_gen, int min_dim,
+                   int max_mip, int width, int height, int channels,
+                   librii::image::CmprQuality quality) {
   if (!image) {
     data.setWidth(0);
     data.setHeight(0);
@@ -29,46 +39,200 @@ bool importTexture(libcube::Texture& data, u8* image, std::vector<u8>& scratch,
   data.setHeight(height);
   data.setMipmapCount(num_mip);
   data.resizeData();
-  if (num_mip == 0) {
-    data.encode(image);
-  } else {
-    printf("Width: %u, Height: %u.\n", (unsigned)width, (unsigned)height);
-    u32 size = 0;
-    for (int i = 0; i <= num_mip; ++i) {
-      size += (width >> i) * (height >> i) * 4;
-      printf("Image %i: %u, %u. -> Total Size: %u\n", i, (unsigned)(width >> i),
-             (unsigned)(height >> i), size);
-    }
-    scratch.resize(size);
-
-    u32 slide = 0;
-    for (int i = 0; i <= num_mip; ++i) {
-      librii::image::resize(scratch.data() + slide, width >> i, height >> i,
-                            image, width, height, librii::image::Lanczos);
-      slide += (width >> i) * (height >> i) * 4;
-    }
-
-    data.encode(scratch.data());
-  }
+  librii::image::generateMipChain(
+      data.getData(), width, height, data.getTextureFormat(), image, width,
+      height, num_mip, librii::image::Lanczos, librii::image::MipSource::Base,
+      quality);
   stbi_image_free(image);
   return true;
 }
 bool importTexture(libcube::Texture& data, const u8* idata, const u32 isize,
-                   std::vector<u8>& scratch, bool mip_gen, int min_dim,
-                   int max_mip) {
+                   bool mip_gen, int min_dim, int max_mip) {
   int width, height, channels;
   u8* image = stbi_load_from_memory(idata, isize, &width, &height, &channels,
                                     STBI_rgb_alpha);
-  return importTexture(data, image, scratch, mip_gen, min_dim, max_mip, width,
-                       height, channels);
+  return importTexture(data, image, mip_gen, min_dim, max_mip, width, height,
+                       channels);
 }
-bool importTexture(libcube::Texture& data, const char* path,
-                   std::vector<u8>& scratch, bool mip_gen, int min_dim,
-                   int max_mip) {
+bool importTexture(libcube::Texture& data, const char* path, bool mip_gen,
+                   int min_dim, int max_mip) {
   int width, height, channels;
   u8* image = stbi_load(path, &width, &height, &channels, STBI_rgb_alpha);
-  return importTexture(data, image, scratch, mip_gen, min_dim, max_mip, width,
-                       height, channels);
+  return importTexture(data, image, mip_gen, min_dim, max_mip, width, height,
+                       channels);
+}
+
+static std::optional<std::vector<u8>> ReadFile(const std::string& path) {
+  std::ifstream stream(path, std::ios::binary | std::ios::ate);
+  if (!stream)
+    return std::nullopt;
+  const auto size = stream.tellg();
+  stream.seekg(0, std::ios::beg);
+  std::vector<u8> data(size);
+  if (!stream.read(reinterpret_cast<char*>(data.data()), size))
+    return std::nullopt;
+  return data;
+}
+
+static void CopyTexture(libcube::Texture& dst, const libcube::Texture& src) {
+  dst.setTextureFormat(src.getTextureFormat());
+  dst.setWidth(src.getWidth());
+  dst.setHeight(src.getHeight());
+  dst.setMipmapCount(src.getMipmapCount());
+  dst.resizeData();
+  std::copy_n(src.getData(), src.getEncodedSize(true), dst.getData());
+}
+
+//! A distinct source image, and the jobs importing it
+struct TextureImportQueue::Source {
+  //! Read again when imported, unless the job was given the file in memory
+  std::string path;
+  std::vector<u8> file;
+  std::vector<std::size_t> jobs;
+  int width = 0;
+  int height = 0;
+  //! Estimated peak memory use while importing
+  std::size_t cost = 0;
+};
+
+std::size_t TextureImportQueue::add(libcube::Texture& data,
+                                    std::vector<std::string> paths) {
+  mJobs.push_back({.data = &data, .paths = std::move(paths)});
+  return mJobs.size() - 1;
+}
+std::size_t TextureImportQueue::add(libcube::Texture& data,
+                                    std::vector<u8> file) {
+  mJobs.push_back({.data = &data, .file = std::move(file)});
+  return mJobs.size() - 1;
+}
+
+std::vector<TextureImportQueue::Result> TextureImportQueue::run() {
+  std::vector<Result> results(mJobs.size());
+  std::vector<Source> sources;
+  // Files are identified by a 64-bit hash of their contents and their size,
+  // so only one file needs to be in memory at a time here.
+  std::unordered_map<u64, std::size_t> by_content;
+
+  for (std::size_t i = 0; i < mJobs.size(); ++i) {
+    auto& job = mJobs[i];
+    int width = 0, height = 0, channels = 0;
+    auto probe = [&](const std::vector<u8>& file) {
+      return stbi_info_from_memory(file.data(), file.size(), &width, &height,
+                                   &channels) != 0;
+    };
+    std::optional<std::vector<u8>> read;
+    const std::string* path = nullptr;
+    bool found = !job.file.empty() && probe(job.file);
+    for (std::size_t p = 0; !found && p < job.paths.size(); ++p) {
+      if (read = ReadFile(job.paths[p]); read && probe(*read)) {
+        path = &job.paths[p];
+        found = true;
+      }
+    }
+    if (!found) {
+      job.data->setWidth(0);
+      job.data->setHeight(0);
+      continue;
+    }
+
+    const auto& file = path != nullptr ? *read : job.file;
+    const std::size_t file_size = file.size();
+    const u64 hash = llvm::xxHash64(llvm::ArrayRef<u8>(file)) ^ file_size;
+    if (auto it = by_content.find(hash); it != by_content.end()) {
+      sources[it->second].jobs.push_back(i);
+      continue;
+    }
+    by_content.emplace(hash, sources.size());
+    const std::size_t pixels = static_cast<std::size_t>(width) * height;
+    sources.push_back({
+        .path = path != nullptr ? *path : std::string{},
+        .file = path != nullptr ? std::vector<u8>{} : std::move(job.file),
+        .jobs = {i},
+        .width = width,
+        .height = height,
+        // The file, the decoded image, and the RGBA mip chain or resizing
+        // target
+        .cost = file_size + pixels * 4 * (mMipGen ? 3 : 2),
+    });
+  }
+  by_content.clear();
+
+  std::stable_sort(sources.begin(), sources.end(),
+                   [](const Source& l, const Source& r) {
+                     return l.width * l.height > r.width * r.height;
+                   });
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::size_t in_flight = 0;
+  u32 running = 0;
+  const u32 num_threads =
+      mNumThreads != 0 ? mNumThreads : std::thread::hardware_concurrency();
+
+  // Imports are shared pool jobs, so the encoders within each stay on its
+  // worker thread rather than starting more.
+  for (auto& source : sources) {
+    {
+      std::unique_lock lock(mutex);
+      cv.wait(lock, [&] {
+        return (running == 0 || running < num_threads) &&
+               (in_flight == 0 || in_flight + source.cost <= mMemoryBudget);
+      });
+      in_flight += source.cost;
+      ++running;
+    }
+    rsl::SubmitSharedJob([&, s = &source] {
+      import(*s, results);
+      {
+        std::scoped_lock lock(mutex);
+        in_flight -= s->cost;
+        --running;
+      }
+      cv.notify_all();
+    });
+  }
+  {
+    std::unique_lock lock(mutex);
+    cv.wait(lock, [&] { return running == 0; });
+  }
+
+  mJobs.clear();
+  return results;
+}
+
+void TextureImportQueue::import(Source& source, std::vector<Result>& results) {
+  const auto start = std::chrono::steady_clock::now();
+  auto& first = *mJobs[source.jobs[0]].data;
+
+  if (source.file.empty()) {
+    if (auto file = ReadFile(source.path))
+      source.file = std::move(*file);
+  }
+  int width = 0, height = 0, channels = 0;
+  u8* image = source.file.empty()
+                  ? nullptr
+                  : stbi_load_from_memory(source.file.data(),
+                                          source.file.size(), &width, &height,
+                                          &channels, STBI_rgb_alpha);
+  std::vector<u8>().swap(source.file);
+  const bool imported = importTexture(first, image, mMipGen, mMinDim, mMaxMip,
+                                      width, height, channels, mCmprQuality);
+  for (std::size_t i = 1; i < source.jobs.size(); ++i) {
+    auto& data = *mJobs[source.jobs[i]].data;
+    if (imported) {
+      CopyTexture(data, first);
+    } else {
+      data.setWidth(0);
+      data.setHeight(0);
+    }
+  }
+
+  const std::chrono::duration<double, std::milli> ms =
+      std::chrono::steady_clock::now() - start;
+  for (std::size_t i = 0; i < source.jobs.size(); ++i) {
+    results[source.jobs[i]] = {
+        .imported = imported, .shared = i != 0, .ms = ms.count()};
+  }
 }
 
 } // namespace riistudio::ass
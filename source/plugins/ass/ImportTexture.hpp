@@ -1,19 +1,80 @@
 #pragma once
 
 #include <core/common.h>
+#include <librii/image/CmprEncoder.hpp>
 #include <plugins/gc/Export/Texture.hpp>
-#include <vector>	
+#include <string>
+#include <vector>
 
 namespace riistudio::ass {
 
-bool importTexture(libcube::Texture& data, u8* image, std::vector<u8>& scratch,
-                   bool mip_gen, int min_dim, int max_mip, int width,
-                   int height, int channels);
+bool importTexture(libcube::Texture& data, u8* image, bool mip_gen, int min_dim,
+                   int max_mip, int width, int height, int channels,
+                   librii::image::CmprQuality quality =
+                       librii::image::CmprQuality::Exhaustive);
 bool importTexture(libcube::Texture& data, const u8* idata, const u32 isize,
-                   std::vector<u8>& scratch, bool mip_gen, int min_dim,
-                   int max_mip);
-bool importTexture(libcube::Texture& data, const char* path,
-                   std::vector<u8>& scratch, bool mip_gen, int min_dim,
-                   int max_mip);
+                   bool mip_gen, int min_dim, int max_mip);
+bool importTexture(libcube::Texture& data, const char* path, bool mip_gen,
+                   int min_dim, int max_mip);
+
+//! @brief Imports a batch of textures on the shared thread pool, one texture
+//! per worker.
+//!
+//! Files are only read to find and hash them, then read again when imported.
+//! The largest images are decoded first, and decoding waits while the images
+//! already in flight would exceed the memory budget. Identical source files
+//! are decoded once and the result copied to every texture using them.
+class TextureImportQueue {
+public:
+  TextureImportQueue(bool mip_gen, int min_dim, int max_mip)
+      : mMipGen(mip_gen), mMinDim(min_dim), mMaxMip(max_mip) {}
+
+  //! Import `data` from the first of `paths` that holds an image
+  //!
+  //! @return Index of the job in the results of run()
+  std::size_t add(libcube::Texture& data, std::vector<std::string> paths);
+  //! Import `data` from an image file held in memory
+  std::size_t add(libcube::Texture& data, std::vector<u8> file);
+
+  struct Result {
+    bool imported = false;
+    //! Copied from another job with the same source image
+    bool shared = false;
+    //! Time spent decoding and encoding
+    double ms = 0.0;
+  };
+  //! Import everything queued. Textures that fail are left empty.
+  std::vector<Result> run();
+
+  //! Limit on the file and image data of imports in flight. One import always
+  //! runs, however large.
+  void setMemoryBudget(std::size_t bytes) { mMemoryBudget = bytes; }
+  std::size_t memoryBudget() const { return mMemoryBudget; }
+  //! Limit on imports in flight. 0: One per hardware thread
+  void setNumThreads(u32 num_threads) { mNumThreads = num_threads; }
+  //! Endpoint search of the CMPR encoder
+  void setCmprQuality(librii::image::CmprQuality quality) {
+    mCmprQuality = quality;
+  }
+
+private:
+  struct Job {
+    libcube::Texture* data = nullptr;
+    std::vector<std::string> paths;
+    std::vector<u8> file;
+  };
+  struct Source;
+
+  void import(Source& source, std::vector<Result>& results);
+
+  bool mMipGen;
+  int mMinDim;
+  int mMaxMip;
+  std::size_t mMemoryBudget = 512 * 1024 * 1024;
+  u32 mNumThreads = 0;
+  librii::image::CmprQuality mCmprQuality =
+      librii::image::CmprQuality::Exhaustive;
+  std::vector<Job> mJobs;
+};
 
 } // namespace riistudio::ass
@@ -40,13 +40,15 @@ glm::vec3 Polygon::getNrm(const libcube::Model& mdl, u64 id) const {
 
 template <typename X, typename Y>
 auto add_to_buffer(const X& entry, Y& buf) -> u16 {
-  const auto found = std::find(buf.mEntries.begin(), buf.mEntries.end(), entry);
-  if (found != buf.mEntries.end()) {
-    return found - buf.mEntries.begin();
+  // Entries that would be written the same are merged
+  if constexpr (std::is_same_v<X, librii::gx::Color>) {
+    return buf.mIndex.findOrAdd(buf.mEntries, entry);
+  } else {
+    return buf.mIndex.findOrAdd(
+        buf.mEntries, entry,
+        librii::gx::QuantizationStep(buf.mQuantize.mType.generic,
+                                     buf.mQuantize.divisor));
   }
-
-  buf.mEntries.push_back(entry);
-  return buf.mEntries.size() - 1;
 };
 
 u64 Polygon::addPos(libcube::Model& mdl, const glm::vec3& v) {
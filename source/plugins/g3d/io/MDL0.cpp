@@ -130,10 +130,8 @@ void writeGenericBuffer(
   const auto nComponents =
       librii::gx::computeComponentCount(kind, buf.mQuantize.mComp);
 
-  for (auto& entry : buf.mEntries) {
-    librii::gx::writeComponents(writer, entry, buf.mQuantize.mType, nComponents,
-                                buf.mQuantize.divisor);
-  }
+  librii::gx::writeComponentArray<T>(writer, buf.mEntries, buf.mQuantize.mType,
+                                     nComponents, buf.mQuantize.divisor);
   writer.alignTo(32);
 } // namespace riistudio::g3d
 
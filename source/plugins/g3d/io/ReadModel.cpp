@@ -78,10 +78,8 @@ readGenericBuffer(GenericBuffer<T, HasMinimum, HasDivisor, kind>& out,
 
   reader.seekSet(start + startOfs);
   // TODO: Recompute bounds
-  for (auto& entry : out.mEntries) {
-    entry = librii::gx::readComponents<T>(reader, out.mQuantize.mType,
-                                          nComponents, out.mQuantize.divisor);
-  }
+  librii::gx::readComponentArray<T>(reader, out.mEntries, out.mQuantize.mType,
+                                    nComponents, out.mQuantize.divisor);
 
   return ""; // Valid
 }
@@ -10,6 +10,7 @@
 #include <librii/g3d/data/AnimData.hpp>
 #include <librii/g3d/data/ModelData.hpp>
 #include <librii/gx.h>
+#include <plugins/gc/Export/PackedRecord.hpp>
 #include <plugins/gc/Export/Scene.hpp>
 #include <tuple>
 
@@ -37,11 +38,17 @@ struct GenericBuffer : public virtual kpi::IObject {
 
   Quantization mQuantize;
   std::vector<T> mEntries;
+  //! Not part of the document; see add_to_buffer
+  librii::gx::VertexIndex<T> mIndex;
 
   bool operator==(const GenericBuffer& rhs) const {
     return mName == rhs.mName && mId == rhs.mId && mQuantize == rhs.mQuantize &&
            mEntries == rhs.mEntries;
   }
+
+  // Vertex data in history is stored compressed
+  using _Memento =
+      libcube::PackedRecord<GenericBuffer, &GenericBuffer::mEntries>;
 };
 class PositionBuffer
     : public GenericBuffer<glm::vec3, true, true,
@@ -6,6 +6,7 @@
 #include <core/common.h>
 
 #include <librii/g3d/data/TextureData.hpp>
+#include <plugins/gc/Export/PackedRecord.hpp>
 #include <plugins/gc/Export/Texture.hpp>
 
 namespace riistudio::g3d {
@@ -32,6 +33,9 @@ struct Texture : public librii::g3d::TextureData,
   bool operator==(const Texture& rhs) const {
     return TextureData::operator==(static_cast<const TextureData&>(rhs));
   }
+
+  // Pixel data in history is stored compressed
+  using _Memento = libcube::PackedRecord<Texture, &TextureData::data>;
 };
 
 } // namespace riistudio::g3d
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <condition_variable>
+#include <core/common.h>
+#include <core/kpi/Memento.hpp>
+#include <functional>
+#include <librii/szs/SZS.hpp>
+#include <memory>
+#include <mutex>
+#include <rsl/ParallelFor.hpp>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace libcube {
+
+//! @brief History record for objects that own one large array (pixel data,
+//! vertex data), selected with `using _Memento = PackedRecord<T, &T::array>`.
+//!
+//! While the record describes the current document, the array is kept as is.
+//! Once only older history holds it, the array is Yaz0 compressed on the shared
+//! thread pool, off the thread committing history; undoing to it expands the
+//! array again.
+template <typename T, auto Blob> class PackedRecord {
+public:
+  PackedRecord(const T& live, const PackedRecord* last = nullptr)
+      : mState(std::make_shared<State>(live)) {
+    (void)last;
+  }
+
+  bool operator==(const T& live) const {
+    std::scoped_lock lock(mState->mutex);
+    if (mState->packed.empty())
+      return mState->object == live;
+    const auto& blob = live.*Blob;
+    if (blob.size() != mState->count || Hash(blob) != mState->hash)
+      return false;
+    // Compare everything else
+    T probe(mState->object);
+    probe.*Blob = blob;
+    return probe == live;
+  }
+
+  template <typename U> void restore(U& out) const {
+    std::scoped_lock lock(mState->mutex);
+    static_cast<T&>(out) = mState->object;
+    if (mState->packed.empty())
+      return;
+    auto& blob = out.*Blob;
+    blob.resize(mState->count);
+    llvm::cantFail(librii::szs::decode(Bytes(blob), mState->packed));
+  }
+
+  //! Queue the array for compression. `usage` is lowered by the bytes saved.
+  void compact(const kpi::SupersededBytes& usage) const {
+    {
+      std::scoped_lock lock(mState->mutex);
+      if (mState->pending || !mState->packed.empty() ||
+          Bytes(mState->object.*Blob).size() < MinPackedSize)
+        return;
+      mState->pending = true;
+    }
+    rsl::SubmitSharedJob([weak = std::weak_ptr<State>(mState), usage] {
+      // Nothing to do if the history dropped the record meanwhile
+      if (auto state = weak.lock())
+        Pack(*state, *usage);
+    });
+  }
+  //! Block until a queued compact() is done
+  void waitCompacted() const {
+    std::unique_lock lock(mState->mutex);
+    mState->done.wait(lock, [&] { return !mState->pending; });
+  }
+  bool compacted() const {
+    std::scoped_lock lock(mState->mutex);
+    return !mState->packed.empty();
+  }
+
+  std::size_t memoryUsage() const {
+    std::scoped_lock lock(mState->mutex);
+    return sizeof(*this) + sizeof(State) +
+           (mState->packed.empty() ? Bytes(mState->object.*Blob).size()
+                                   : mState->packed.size());
+  }
+
+private:
+  // Compressing smaller arrays is not worth the time
+  static constexpr std::size_t MinPackedSize = 4096;
+
+  struct State {
+    State(const T& live) : object(live) {}
+
+    std::mutex mutex;
+    std::condition_variable done;
+    T object;
+    // Empty until compressed
+    std::vector<u8> packed;
+    std::size_t count = 0;
+    std::size_t hash = 0;
+    bool pending = false;
+  };
+
+  static void Pack(State& state, std::atomic<std::size_t>& usage) {
+    // Only Pack modifies the array, so reading it unlocked is safe
+    const auto& blob = state.object.*Blob;
+    const std::size_t size = Bytes(blob).size();
+    auto packed = librii::szs::encode(Bytes(blob), librii::szs::Algo::Greedy);
+    const std::size_t hash = Hash(blob);
+
+    std::scoped_lock lock(state.mutex);
+    if (packed.size() < size) {
+      state.count = blob.size();
+      state.hash = hash;
+      state.packed = std::move(packed);
+      std::remove_cvref_t<decltype(blob)>().swap(state.object.*Blob);
+      usage -= size - state.packed.size();
+    }
+    state.pending = false;
+    state.done.notify_all();
+  }
+
+  template <typename V> static std::span<const u8> Bytes(const V& v) {
+    static_assert(std::is_trivially_copyable_v<typename V::value_type>);
+    return {reinterpret_cast<const u8*>(v.data()),
+            v.size() * sizeof(typename V::value_type)};
+  }
+  template <typename V> static std::span<u8> Bytes(V& v) {
+    return {reinterpret_cast<u8*>(v.data()),
+            v.size() * sizeof(typename V::value_type)};
+  }
+  template <typename V> static std::size_t Hash(const V& v) {
+    const auto bytes = Bytes(v);
+    return std::hash<std::string_view>{}(std::string_view(
+        reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+  }
+
+  // Records are immutable as far as history is concerned; compacting only
+  // changes how the array is stored. Shared with the compaction job.
+  std::shared_ptr<State> mState;
+};
+
+} // namespace libcube
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <core/3d/i3dmodel.hpp>
 #include <librii/gx/Texture.hpp>
+#include <librii/image/DecodeCache.hpp>
 #include <librii/image/ImagePlatform.hpp>
 #include <vendor/dolemu/TextureDecoder/TextureDecoder.h>
 
@@ -16,25 +17,26 @@ struct Texture : public riistudio::lib3d::Texture {
         getWidth(), getHeight(), getTextureFormat(), mip ? getImageCount() : 0);
   }
   inline void decode(std::vector<u8>& out, bool mip) const override {
-    u32 size = getDecodedSize(mip);
+    const u32 size = getDecodedSize(mip);
     if (size == 0)
       return;
-    size = std::max(size, u32(1024 * 1024 * 4));
-    // assert(size);
-
-    if (out.size() < size) {
+    if (out.size() < size)
       out.resize(size);
-    }
-
-    if (librii::gx::IsPaletteFormat(getTextureFormat())) {
-      // Palettes not supported
-      return;
-    }
-
-    librii::image::transform(
-        out.data(), getWidth(), getHeight(), getTextureFormat(),
-        librii::gx::TextureFormat::Extension_RawRGBA32, getData(), getWidth(),
-        getHeight(), mip ? getMipmapCount() : 0);
+    const auto image = decodeShared(mip);
+    std::copy(image->begin(), image->end(), out.begin());
+  }
+  inline std::shared_ptr<const std::vector<u8>>
+  decodeShared(bool mip) const override {
+    const u32 size = getDecodedSize(mip);
+    if (size == 0)
+      return std::make_shared<std::vector<u8>>();
+    auto image = librii::image::DecodeCache::get().decode(
+        getData(), getWidth(), getHeight(), getTextureFormat(),
+        mip ? getMipmapCount() : 0);
+    // Palettes not supported
+    if (image == nullptr)
+      return std::make_shared<std::vector<u8>>(size);
+    return image;
   }
 
   virtual librii::gx::TextureFormat getTextureFormat() const = 0;
@@ -34,20 +34,14 @@ glm::vec4 Shape::getClr(const libcube::Model& mdl, u64 chan, u64 idx) const {
 
 template <typename X, typename Y>
 auto add_to_buffer(const X& entry, Y& buf) -> u16 {
-  const auto found = std::find(buf.begin(), buf.end(), entry);
-  if (found != buf.end()) {
-    return found - buf.begin();
-  }
-
-  buf.push_back(entry);
-  return buf.size() - 1;
+  return buf.findOrAdd(entry);
 };
 
 u64 Shape::addPos(libcube::Model& mdl, const glm::vec3& v) {
-  return add_to_buffer(v, reinterpret_cast<Model&>(mdl).mBufs.pos.mData);
+  return add_to_buffer(v, reinterpret_cast<Model&>(mdl).mBufs.pos);
 }
 u64 Shape::addNrm(libcube::Model& mdl, const glm::vec3& v) {
-  return add_to_buffer(v, reinterpret_cast<Model&>(mdl).mBufs.norm.mData);
+  return add_to_buffer(v, reinterpret_cast<Model&>(mdl).mBufs.norm);
 }
 u64 Shape::addClr(libcube::Model& mdl, u64 chan, const glm::vec4& v) {
   librii::gx::ColorF32 fclr;
@@ -56,11 +50,10 @@ u64 Shape::addClr(libcube::Model& mdl, u64 chan, const glm::vec4& v) {
   fclr.b = v[2];
   fclr.a = v[3];
   librii::gx::Color c = fclr;
-  return add_to_buffer(c,
-                       reinterpret_cast<Model&>(mdl).mBufs.color[chan].mData);
+  return add_to_buffer(c, reinterpret_cast<Model&>(mdl).mBufs.color[chan]);
 }
 u64 Shape::addUv(libcube::Model& mdl, u64 chan, const glm::vec2& v) {
-  return add_to_buffer(v, reinterpret_cast<Model&>(mdl).mBufs.uv[chan].mData);
+  return add_to_buffer(v, reinterpret_cast<Model&>(mdl).mBufs.uv[chan]);
 }
 
 glm::mat4 computeBoneMdl(u32 id, kpi::ConstCollectionRange<lib3d::Bone> bones) {
@@ -3,6 +3,7 @@
 #include <core/common.h>
 #include <librii/gx.h>
 #include <librii/j3d/data/TextureData.hpp>
+#include <plugins/gc/Export/PackedRecord.hpp>
 #include <plugins/gc/Export/Texture.hpp>
 #include <vector>
 #include <vendor/fa5/IconsFontAwesome5.h>
@@ -36,6 +37,9 @@ struct Texture : public librii::j3d::TextureData, public libcube::Texture {
   void setWidth(u16 width) override { mWidth = width; }
   u16 getHeight() const override { return mHeight; }
   void setHeight(u16 height) override { mHeight = height; }
+
+  // Pixel data in history is stored compressed
+  using _Memento = libcube::PackedRecord<Texture, &TextureData::mData>;
 };
 
 } // namespace riistudio::j3d
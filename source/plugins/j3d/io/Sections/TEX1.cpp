@@ -295,17 +295,7 @@ struct TEX1Node final : public oishii::Node {
 
     Result write(oishii::Writer& writer) const noexcept {
       const auto& tex = mCol.getTextures()[mIdx];
-      const auto before = writer.tell();
-
-      writer.skip(tex.mData.size() - 1);
-      writer.write<u8>(0);
-      writer.skip(-tex.mData.size());
-
-      // memcpy_s(writer.getDataBlockStart() + before, writer.endpos(),
-      // tex.mData.data(), tex.mData.size());
-      memcpy(writer.getDataBlockStart() + before, tex.mData.data(),
-             tex.mData.size());
-      writer.skip(tex.mData.size());
+      writer.writeBytes(tex.mData);
       return {};
     }
 
@@ -179,16 +179,14 @@ void readVTX1(BMDOutputContext& ctx) {
         auto pos = reinterpret_cast<decltype(ctx.mdl.mBufs.pos)*>(buf);
 
         pos->mData.resize(ensize);
-        for (int i = 0; i < ensize; ++i)
-          pos->readBufferEntryGeneric(reader, pos->mData[i]);
+        pos->readData(reader);
         break;
       }
       case VBufferKind::normal: {
         auto nrm = reinterpret_cast<decltype(ctx.mdl.mBufs.norm)*>(buf);
 
         nrm->mData.resize(ensize);
-        for (int i = 0; i < ensize; ++i)
-          nrm->readBufferEntryGeneric(reader, nrm->mData[i]);
+        nrm->readData(reader);
         break;
       }
       case VBufferKind::color: {
@@ -196,8 +194,7 @@ void readVTX1(BMDOutputContext& ctx) {
             reinterpret_cast<decltype(ctx.mdl.mBufs.color)::value_type*>(buf);
 
         clr->mData.resize(ensize);
-        for (int i = 0; i < ensize; ++i)
-          clr->readBufferEntryColor(reader, clr->mData[i]);
+        clr->readData(reader);
         break;
       }
       case VBufferKind::textureCoordinate: {
@@ -205,8 +202,7 @@ void readVTX1(BMDOutputContext& ctx) {
             reinterpret_cast<decltype(ctx.mdl.mBufs.uv)::value_type*>(buf);
 
         uv->mData.resize(ensize);
-        for (int i = 0; i < ensize; ++i)
-          uv->readBufferEntryGeneric(reader, uv->mData[i]);
+        uv->readData(reader);
         break;
       }
       }
@@ -1,18 +1,19 @@
 #include <core/3d/i3dmodel.hpp>
 #include <core/kpi/Plugins.hpp>
 #include <filesystem>
+#include <future>
 #include <librii/hx/CullMode.hpp>
 #include <librii/hx/PixMode.hpp>
 #include <librii/rhst/RHST.hpp>
 #include <oishii/reader/binary_reader.hxx>
+#include <plugins/ass/ImportTexture.hpp>
 #include <plugins/g3d/collection.hpp>
 #include <plugins/gc/Export/Scene.hpp>
 #include <plugins/j3d/Material.hpp>
 #include <plugins/j3d/Scene.hpp>
 #include <set>
-#include <stb_image.h>
 #include <string>
-#include <vendor/thread_pool.hpp>
+#include <thread>
 
 // XXX: Hack, though we'll refactor all of this way soon
 std::string rebuild_dest;
@@ -269,82 +270,6 @@ static inline std::string getFileShort(const std::string& path) {
   return tmp;
 }
 
-const auto power_of_2 = [](u32 x) { return (x & (x - 1)) == 0; };
-
-static bool importTexture(libcube::Texture& data, u8* image,
-                          std::vector<u8>& scratch, bool mip_gen, int min_dim,
-                          int max_mip, int width, int height, int channels) {
-  if (!image) {
-    data.setWidth(0);
-    data.setHeight(0);
-    return false;
-  }
-  assert(image);
-
-  int num_mip = 0;
-  if (mip_gen && power_of_2(width) && power_of_2(height)) {
-    while ((num_mip + 1) < max_mip && (width >> (num_mip + 1)) >= min_dim &&
-           (height >> (num_mip + 1)) >= min_dim)
-      ++num_mip;
-  }
-  data.setTextureFormat(librii::gx::TextureFormat::CMPR);
-  data.setWidth(width);
-  data.setHeight(height);
-  data.setMipmapCount(num_mip);
-  data.resizeData();
-  if (num_mip == 0) {
-    data.encode(image);
-  } else {
-    printf("Width: %u, Height: %u.\n", (unsigned)width, (unsigned)height);
-    u32 size = 0;
-    for (int i = 0; i <= num_mip; ++i) {
-      size += (width >> i) * (height >> i) * 4;
-      printf("Image %i: %u, %u. -> Total Size: %u\n", i, (unsigned)(width >> i),
-             (unsigned)(height >> i), size);
-    }
-    scratch.resize(size);
-
-    u32 slide = 0;
-    for (int i = 0; i <= num_mip; ++i) {
-      librii::image::resize(scratch.data() + slide, width >> i, height >> i,
-                            image, width, height, librii::image::Lanczos);
-      slide += (width >> i) * (height >> i) * 4;
-    }
-
-    data.encode(scratch.data());
-  }
-  stbi_image_free(image);
-  return true;
-}
-static bool importTexture(libcube::Texture& data, const char* path,
-                          std::vector<u8>& scratch, bool mip_gen, int min_dim,
-                          int max_mip) {
-  int width, height, channels;
-  u8* image = stbi_load(path, &width, &height, &channels, STBI_rgb_alpha);
-  return importTexture(data, image, scratch, mip_gen, min_dim, max_mip, width,
-                       height, channels);
-}
-
-void import_texture(std::string tex, libcube::Texture* pdata,
-                    std::filesystem::path file_path) {
-  libcube::Texture& data = *pdata;
-  std::vector<u8> scratch;
-  bool mip_gen = true;
-  u32 min_dim = 64;
-  u32 max_mip = 3;
-
-  const auto alt_path =
-      (file_path.parent_path() / "textures" / (tex + ".png")).string();
-
-  if (!importTexture(data, tex.c_str(), scratch, mip_gen, min_dim, max_mip)) {
-    if (!importTexture(data, alt_path.c_str(), scratch, mip_gen, min_dim,
-                       max_mip)) {
-      printf("Cannot find texture %s\n", tex.c_str());
-      // unresolved.emplace(i, tex);
-    }
-  }
-};
-
 void RHSTReader::read(kpi::IOTransaction& transaction) {
   std::string error_msg;
   auto result = librii::rhst::ReadSceneTree(transaction.data, error_msg);
@@ -357,7 +282,6 @@ void RHSTReader::read(kpi::IOTransaction& transaction) {
   // Account for the main thread
   if (hw_threads > 1)
     --hw_threads;
-  thread_pool pool(hw_threads);
 
   std::set<std::string> textures_needed;
 
@@ -389,14 +313,18 @@ void RHSTReader::read(kpi::IOTransaction& transaction) {
   auto file_path =
       std::filesystem::path(transaction.data.getProvider()->getFilePath());
 
-  std::vector<std::future<bool>> futures;
-
+  ass::TextureImportQueue queue(/* mip_gen */ true, /* min_dim */ 64,
+                                /* max_mip */ 3);
+  queue.setNumThreads(hw_threads);
   for (int i = 0; i < scene.getTextures().size(); ++i) {
-    libcube::Texture* data = &scene.getTextures()[i];
-
-    auto task = std::bind(&import_texture, data->getName(), data, file_path);
-    futures.push_back(pool.submit(task));
+    auto& data = scene.getTextures()[i];
+    const auto alt_path =
+        (file_path.parent_path() / "textures" / (data.getName() + ".png"))
+            .string();
+    queue.add(data, {data.getName(), alt_path});
   }
+  // Meshes are compiled meanwhile
+  auto textures = std::async(std::launch::async, [&] { return queue.run(); });
 
   int i = 0;
   for (auto& mesh : result->meshes) {
@@ -414,8 +342,15 @@ void RHSTReader::read(kpi::IOTransaction& transaction) {
     }
   }
 
-  for (auto& f : futures) {
-    f.get();
+  const auto results = textures.get();
+  for (std::size_t t = 0; t < results.size(); ++t) {
+    const auto& name = scene.getTextures()[t].getName();
+    if (!results[t].imported) {
+      printf("Cannot find texture %s\n", name.c_str());
+      continue;
+    }
+    printf("Imported texture %s in %.1f ms%s\n", name.c_str(), results[t].ms,
+           results[t].shared ? " (shared)" : "");
   }
 
   transaction.state = kpi::TransactionState::Complete;
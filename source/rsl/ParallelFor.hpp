@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <rsl/ThreadPool.hpp>
+#include <thread>
+
+namespace rsl {
+
+//! @brief The process-wide worker pool, created on first use. Its workers
+//! sleep while there is no work.
+//!
+//! Long-running jobs should go through SubmitSharedJob and loops through
+//! ParallelFor, so that nested parallelism does not oversubscribe the CPU.
+inline ThreadPool& SharedThreadPool() {
+  static ThreadPool pool(std::thread::hardware_concurrency());
+  return pool;
+}
+
+namespace detail {
+//! Set on threads currently running a ParallelFor chunk or a shared pool job
+inline thread_local bool tInParallelWork = false;
+
+struct ParallelWorkScope {
+  ParallelWorkScope() : mWasSet(tInParallelWork) { tInParallelWork = true; }
+  ~ParallelWorkScope() { tInParallelWork = mWasSet; }
+  bool mWasSet;
+};
+} // namespace detail
+
+//! @brief Run `job` on the shared pool. Any ParallelFor inside it runs
+//! serially on that worker.
+template <typename F> void SubmitSharedJob(F job) {
+  SharedThreadPool().push([job = std::move(job)]() mutable {
+    detail::ParallelWorkScope scope;
+    job();
+  });
+}
+
+//! @brief Call `body(begin, end)` for consecutive ranges of at most `grain`
+//! items covering [0, count), spreading them over the shared pool.
+//!
+//! The calling thread takes part, and ranges are claimed dynamically, so a
+//! busy pool only costs speed. Runs serially for a single range, when
+//! `num_threads` is 1, or when already inside a parallel loop or shared pool
+//! job: nested loops never start more threads. `num_threads` of 0 means
+//! every hardware thread. The first exception thrown by `body` is rethrown
+//! once all started ranges have finished.
+//!
+//! Pick `grain` so one range is worth waking a thread for (tens of
+//! microseconds of work); the threshold then falls out of `count <= grain`.
+template <typename F>
+void ParallelFor(size_t count, size_t grain, F&& body, unsigned num_threads = 0) {
+  grain = std::max<size_t>(grain, 1);
+  const size_t num_ranges = (count + grain - 1) / grain;
+  if (num_threads == 0)
+    num_threads = std::thread::hardware_concurrency();
+  if (num_ranges <= 1 || num_threads <= 1 || detail::tInParallelWork) {
+    if (count != 0)
+      body(size_t(0), count);
+    return;
+  }
+
+  // Helpers that only start after the loop is done find no work left and
+  // never touch `body`; the state outlives the call for their sake.
+  struct State {
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> failed = false;
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t done = 0;
+    std::exception_ptr error;
+  };
+  auto state = std::make_shared<State>();
+  auto run_range = [&body, grain, count](size_t r) {
+    const size_t begin = r * grain;
+    body(begin, std::min(begin + grain, count));
+  };
+  auto work = [state, num_ranges, &run_range] {
+    detail::ParallelWorkScope scope;
+    size_t r;
+    while ((r = state->next++) < num_ranges) {
+      if (!state->failed) {
+        try {
+          run_range(r);
+        } catch (...) {
+          std::scoped_lock lock(state->mutex);
+          if (!state->error)
+            state->error = std::current_exception();
+          state->failed = true;
+        }
+      }
+      std::scoped_lock lock(state->mutex);
+      if (++state->done == num_ranges)
+        state->cv.notify_all();
+    }
+  };
+
+  const size_t num_helpers = std::min<size_t>(num_threads, num_ranges) - 1;
+  auto& pool = SharedThreadPool();
+  for (size_t i = 0; i < num_helpers; ++i)
+    pool.push(work);
+  work();
+
+  std::unique_lock lock(state->mutex);
+  state->cv.wait(lock, [&] { return state->done == num_ranges; });
+  if (state->error)
+    std::rethrow_exception(state->error);
+}
+
+} // namespace rsl
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rsl {
+
+//! @brief A fixed set of worker threads running queued jobs in order.
+//!
+//! Idle workers block on a condition variable rather than polling, so a pool
+//! kept for the whole session costs nothing between jobs. Destruction runs
+//! the jobs already queued, then joins the workers.
+class ThreadPool {
+public:
+  explicit ThreadPool(unsigned num_threads) {
+    num_threads = std::max(num_threads, 1u);
+    mThreads.reserve(num_threads);
+    for (unsigned i = 0; i < num_threads; ++i)
+      mThreads.emplace_back([this] { worker(); });
+  }
+  ~ThreadPool() {
+    {
+      std::scoped_lock lock(mMutex);
+      mStopping = true;
+    }
+    mCv.notify_all();
+    for (auto& thread : mThreads)
+      thread.join();
+  }
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  unsigned size() const { return static_cast<unsigned>(mThreads.size()); }
+
+  //! Queue `job` to run on the first idle worker. `job` must not throw.
+  void push(std::function<void()> job) {
+    {
+      std::scoped_lock lock(mMutex);
+      mJobs.push_back(std::move(job));
+    }
+    mCv.notify_one();
+  }
+
+private:
+  void worker() {
+    while (true) {
+      std::function<void()> job;
+      {
+        std::unique_lock lock(mMutex);
+        mCv.wait(lock, [&] { return mStopping || !mJobs.empty(); });
+        if (mJobs.empty())
+          return;
+        job = std::move(mJobs.front());
+        mJobs.pop_front();
+      }
+      job();
+    }
+  }
+
+  std::mutex mMutex;
+  std::condition_variable mCv;
+  std::deque<std::function<void()>> mJobs;
+  bool mStopping = false;
+  std::vector<std::thread> mThreads;
+};
+
+} // namespace rsl
@@ -0,0 +1,232 @@
+// Test for the bounding volume hierarchy
+//
+// bvh
+//
+// Casts random rays against random triangles and boxes through
+// librii::math::BVH and compares the closest hit with a brute-force scan,
+// after building, after moving every primitive with refit(), and after
+// moving some with update(). Boxes and rays on an integer grid, with
+// axis-parallel rays starting on box faces, cover the slab test's NaN case.
+// Returns nonzero on any mismatch.
+
+#include <librii/math/bvh.hpp>
+
+#include <array>
+#include <cstdio>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace riistudio {
+const char* translateString(std::string_view str) { return str.data(); }
+} // namespace riistudio
+
+namespace llvm {
+int DisableABIBreakingChecks;
+} // namespace llvm
+
+using librii::math::AABB;
+using librii::math::BVH;
+using Triangle = std::array<glm::vec3, 3>;
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const std::string& what) {
+  if (!ok) {
+    fprintf(stderr, "FAIL: %s\n", what.c_str());
+    ++failures;
+  }
+}
+
+struct Ray {
+  glm::vec3 origin;
+  glm::vec3 dir;
+};
+
+AABB TriangleBounds(const Triangle& tri) {
+  AABB box{tri[0], tri[0]};
+  box.expandBound({tri[1], tri[1]});
+  box.expandBound({tri[2], tri[2]});
+  return box;
+}
+
+std::vector<Triangle> RandomTriangles(u32 count, std::mt19937& rng) {
+  std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> offset(-5.0f, 5.0f);
+  std::vector<Triangle> tris(count);
+  for (auto& tri : tris) {
+    const glm::vec3 center(pos(rng), pos(rng), pos(rng));
+    for (auto& v : tri)
+      v = center + glm::vec3(offset(rng), offset(rng), offset(rng));
+  }
+  return tris;
+}
+
+std::vector<Ray> RandomRays(u32 count, std::mt19937& rng) {
+  std::uniform_real_distribution<float> pos(-120.0f, 120.0f);
+  std::normal_distribution<float> dir;
+  std::vector<Ray> rays(count);
+  for (auto& ray : rays) {
+    ray.origin = glm::vec3(pos(rng), pos(rng), pos(rng));
+    ray.dir = glm::normalize(glm::vec3(dir(rng), dir(rng), dir(rng)));
+  }
+  return rays;
+}
+
+// Closest hit of `test` over every primitive
+template <typename F>
+std::optional<float> BruteForce(std::size_t count, F&& test) {
+  std::optional<float> best;
+  for (u32 i = 0; i < count; ++i) {
+    if (auto t = test(i); t && (!best || *t < *best))
+      best = t;
+  }
+  return best;
+}
+
+void CheckTriangles(const std::string& what, const BVH& bvh,
+                    const std::vector<Triangle>& tris,
+                    const std::vector<Ray>& rays) {
+  int mismatches = 0;
+  for (const auto& ray : rays) {
+    auto test = [&](u32 prim) {
+      return librii::math::IntersectRayTriangle(ray.origin, ray.dir,
+                                                tris[prim]);
+    };
+    const auto expected = BruteForce(tris.size(), test);
+    const auto hit = bvh.rayCast(ray.origin, ray.dir,
+                                 [&](u32 prim, float) { return test(prim); });
+    // Ties may resolve to either primitive; the distance must agree
+    const bool ok = hit.has_value() == expected.has_value() &&
+                    (!hit || (hit->second == *expected &&
+                              test(hit->first) == hit->second));
+    mismatches += !ok;
+  }
+  Check(mismatches == 0,
+        what + ": " + std::to_string(mismatches) + " ray(s) disagree");
+}
+
+void TestTriangles() {
+  std::mt19937 rng(0);
+  auto tris = RandomTriangles(2000, rng);
+  const auto rays = RandomRays(2000, rng);
+  std::vector<AABB> bounds;
+  for (const auto& tri : tris)
+    bounds.push_back(TriangleBounds(tri));
+
+  BVH bvh;
+  bvh.build(bounds);
+  Check(bvh.numPrimitives() == tris.size(), "primitive count");
+  CheckTriangles("build", bvh, tris, rays);
+
+  // Move everything
+  std::uniform_real_distribution<float> nudge(-20.0f, 20.0f);
+  for (u32 i = 0; i < tris.size(); ++i) {
+    const glm::vec3 d(nudge(rng), nudge(rng), nudge(rng));
+    for (auto& v : tris[i])
+      v += d;
+    bounds[i] = TriangleBounds(tris[i]);
+  }
+  bvh.refit(bounds);
+  CheckTriangles("refit", bvh, tris, rays);
+
+  // Move a few, far out of their old leaves
+  std::uniform_int_distribution<u32> pick(0, tris.size() - 1);
+  for (int n = 0; n < 100; ++n) {
+    const u32 i = pick(rng);
+    const glm::vec3 d(nudge(rng) * 5.0f, nudge(rng) * 5.0f, nudge(rng) * 5.0f);
+    for (auto& v : tris[i])
+      v += d;
+    bvh.update(i, TriangleBounds(tris[i]));
+  }
+  CheckTriangles("update", bvh, tris, rays);
+
+  BVH empty;
+  empty.build({});
+  Check(!empty.rayCast(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f),
+                       [](u32, float) { return std::optional<float>(0.0f); }),
+        "empty BVH has no hits");
+}
+
+// Unit boxes on an integer grid, hit by rays from grid points along the axes
+void TestGridBoxes() {
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> cell(-8, 8);
+  std::vector<AABB> boxes(300);
+  for (auto& box : boxes) {
+    box.min = glm::vec3(cell(rng), cell(rng), cell(rng));
+    box.max = box.min + glm::vec3(1.0f);
+  }
+  BVH bvh;
+  bvh.build(boxes, 2);
+
+  constexpr float inf = std::numeric_limits<float>::infinity();
+  const std::array<glm::vec3, 6> axes = {
+      glm::vec3(1, 0, 0),  glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+      glm::vec3(0, -1, 0), glm::vec3(0, 0, 1),  glm::vec3(0, 0, -1)};
+  int mismatches = 0;
+  int rays = 0;
+  for (int n = 0; n < 2000; ++n) {
+    const glm::vec3 origin(cell(rng), cell(rng), cell(rng));
+    for (const auto& dir : axes) {
+      const glm::vec3 inv_dir = 1.0f / dir;
+      auto test = [&](u32 prim) {
+        return librii::math::IntersectRayAABB(boxes[prim], origin, inv_dir,
+                                              inf);
+      };
+      const auto expected = BruteForce(boxes.size(), test);
+      const auto hit =
+          bvh.rayCast(origin, dir, [&](u32 prim, float) { return test(prim); });
+      mismatches += hit.has_value() != expected.has_value() ||
+                    (hit && hit->second != *expected);
+      ++rays;
+    }
+  }
+  Check(mismatches == 0, "grid: " + std::to_string(mismatches) + " of " +
+                             std::to_string(rays) + " ray(s) disagree");
+}
+
+void TestSlabEdgeCases() {
+  using librii::math::IntersectRayAABB;
+  constexpr float inf = std::numeric_limits<float>::infinity();
+  const AABB box{glm::vec3(0.0f), glm::vec3(1.0f)};
+  auto cast = [&](glm::vec3 origin, glm::vec3 dir,
+                  float t_max = std::numeric_limits<float>::infinity()) {
+    return IntersectRayAABB(box, origin, 1.0f / dir, t_max);
+  };
+  const glm::vec3 z(0, 0, 1);
+
+  // Parallel to x, starting on a face in x: 0 * inf
+  Check(cast({0.0f, 0.5f, -1.0f}, z) == 1.0f, "origin on the min face");
+  Check(cast({1.0f, 0.5f, -1.0f}, z) == 1.0f, "origin on the max face");
+  Check(cast({0.0f, 0.0f, -1.0f}, z) == 1.0f, "origin on an edge");
+  Check(cast({0.0f, 0.0f, 0.0f}, z) == 0.0f, "origin on a corner");
+  Check(!cast({2.0f, 0.5f, -1.0f}, z), "parallel and outside");
+  Check(!cast({0.0f, 0.5f, -1.0f}, -z), "on a face, pointing away");
+  Check(!cast({0.0f, 0.5f, -1.0f}, z, 0.5f), "on a face, beyond t_max");
+  Check(cast({0.5f, 0.5f, 0.5f}, z) == 0.0f, "origin inside");
+
+  // A flat box, with the ray in its plane
+  const AABB flat{glm::vec3(0.0f), glm::vec3(1.0f, 1.0f, 0.0f)};
+  Check(IntersectRayAABB(flat, {0.5f, -1.0f, 0.0f},
+                         1.0f / glm::vec3(0, 1, 0), inf) == 1.0f,
+        "ray in the plane of a flat box");
+}
+
+} // namespace
+
+int main() {
+  TestTriangles();
+  TestGridBoxes();
+  TestSlabEdgeCases();
+
+  if (failures != 0) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("All BVH checks passed\n");
+  return 0;
+}
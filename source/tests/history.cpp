@@ -0,0 +1,274 @@
+// Test for undo history memory accounting and packed records
+//
+// history
+//
+// Commits a small document of plain records and packed arrays to a
+// kpi::History, and checks memoryUsage() after edits, removals and budget
+// evictions, and that undo and redo still restore every kept state. Also
+// checks libcube::PackedRecord on its own: compaction in the background, the
+// memory it gives back, comparison against live objects and restoring the
+// array. Returns nonzero on any mismatch.
+
+#include <core/kpi/History.hpp>
+#include <core/kpi/Node2.hpp>
+#include <plugins/gc/Export/PackedRecord.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace riistudio {
+const char* translateString(std::string_view str) { return str.data(); }
+} // namespace riistudio
+
+namespace llvm {
+int DisableABIBreakingChecks;
+} // namespace llvm
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const std::string& what) {
+  if (!ok) {
+    fprintf(stderr, "FAIL: %s\n", what.c_str());
+    ++failures;
+  }
+}
+
+struct Tag {
+  int value = 0;
+  bool operator==(const Tag&) const = default;
+};
+
+struct Blob {
+  std::string name;
+  std::vector<u8> data;
+  bool operator==(const Blob&) const = default;
+
+  using _Memento = libcube::PackedRecord<Blob, &Blob::data>;
+};
+
+// Laid out like the nodes generated by scripts/nodes.py
+class Doc : public kpi::INode {
+public:
+  Doc() : mTags(this), mBlobs(this) {}
+
+  kpi::MutCollectionRange<Tag> getTags() { return {&mTags}; }
+  kpi::ConstCollectionRange<Tag> getTags() const { return {&mTags}; }
+  kpi::MutCollectionRange<Blob> getBlobs() { return {&mBlobs}; }
+  kpi::ConstCollectionRange<Blob> getBlobs() const { return {&mBlobs}; }
+
+  std::size_t numFolders() const override { return 2; }
+  const kpi::ICollection* folderAt(std::size_t index) const override {
+    return index == 0 ? static_cast<const kpi::ICollection*>(&mTags)
+                      : index == 1 ? &mBlobs : nullptr;
+  }
+  kpi::ICollection* folderAt(std::size_t index) override {
+    return index == 0 ? static_cast<kpi::ICollection*>(&mTags)
+                      : index == 1 ? &mBlobs : nullptr;
+  }
+  const char* idAt(std::size_t index) const override {
+    return index == 0 ? typeid(Tag).name() : typeid(Blob).name();
+  }
+  std::size_t fromId(const char* id) const override {
+    return !strcmp(id, typeid(Tag).name())    ? 0
+           : !strcmp(id, typeid(Blob).name()) ? 1
+                                              : ~0;
+  }
+  kpi::IDocData* getImmediateData() override { return nullptr; }
+  const kpi::IDocData* getImmediateData() const override { return nullptr; }
+
+  struct _Memento : public kpi::IMemento {
+    kpi::ConstPersistentVec<Tag> mTags;
+    kpi::ConstPersistentVec<Blob> mBlobs;
+    _Memento(const Doc& _new, const kpi::IMemento* last = nullptr) {
+      const auto* old = last ? dynamic_cast<const _Memento*>(last) : nullptr;
+      kpi::nextFolder(mTags, _new.getTags(), old ? &old->mTags : nullptr);
+      kpi::nextFolder(mBlobs, _new.getBlobs(), old ? &old->mBlobs : nullptr);
+    }
+  };
+  std::unique_ptr<kpi::IMemento>
+  next(const kpi::IMemento* last) const override {
+    return std::make_unique<_Memento>(*this, last);
+  }
+  void from(const kpi::IMemento& _memento) override {
+    auto* in = dynamic_cast<const _Memento*>(&_memento);
+    assert(in);
+    kpi::fromFolder(getTags(), in->mTags);
+    kpi::fromFolder(getBlobs(), in->mBlobs);
+  }
+
+private:
+  kpi::CollectionImpl<Tag> mTags;
+  kpi::CollectionImpl<Blob> mBlobs;
+};
+
+std::vector<int> Values(const Doc& doc) {
+  std::vector<int> values;
+  for (const auto& tag : doc.getTags())
+    values.push_back(tag.value);
+  return values;
+}
+
+// Repeats every 251 bytes, drifting slowly: compresses well, but not to a
+// single run
+std::vector<u8> Pattern(std::size_t size, u8 seed) {
+  std::vector<u8> data(size);
+  for (std::size_t i = 0; i < size; ++i)
+    data[i] = static_cast<u8>((i % 251) * seed + i / 4096);
+  return data;
+}
+
+void CheckAccounting() {
+  constexpr std::size_t Rec = sizeof(Tag);
+  Doc doc;
+  kpi::History history;
+  for (int i = 0; i < 3; ++i)
+    doc.getTags().add().value = i;
+  history.commit(doc);
+  Check(history.memoryUsage() == 0, "a single state holds no extra memory");
+
+  // Replaces one record
+  doc.getTags()[1].value = 10;
+  history.commit(doc);
+  Check(history.memoryUsage() == Rec, "edit: one record superseded");
+
+  // Replaces two records, drops one
+  doc.getTags()[0].value = 20;
+  doc.getTags()[2].value = 30;
+  history.commit(doc);
+  doc.getTags().resize(2);
+  history.commit(doc);
+  Check(history.memoryUsage() == 4 * Rec,
+        "edits and removal: " + std::to_string(history.memoryUsage()));
+
+  // Unchanged: nothing superseded
+  history.commit(doc);
+  Check(history.memoryUsage() == 4 * Rec, "an unchanged commit is free");
+  Check(history.size() == 5, "five states");
+
+  // Dropping the first two states leaves one record, within the budget
+  history.setMemoryBudget(2 * Rec);
+  Check(history.memoryUsage() == Rec && history.size() == 3,
+        "budget drops the oldest states: " +
+            std::to_string(history.memoryUsage()) + " bytes, " +
+            std::to_string(history.size()) + " states");
+  Check(history.cursor() == 2, "cursor follows eviction");
+  for (int i = 0; i < 3; ++i)
+    history.undo(doc);
+  Check(history.cursor() == 0 && Values(doc) == std::vector<int>{20, 10, 30},
+        "undo stops at the oldest kept state");
+
+  // Committing after undo discards the redo states and their memory
+  history.setMemoryBudget(std::size_t(1) << 30);
+  doc.getTags()[0].value = 21;
+  history.commit(doc);
+  Check(history.size() == 2 && history.memoryUsage() == Rec,
+        "redo states discarded: " + std::to_string(history.memoryUsage()));
+  history.redo(doc);
+  Check(Values(doc) == std::vector<int>{21, 10, 30}, "nothing to redo");
+  history.undo(doc);
+  Check(Values(doc) == std::vector<int>{20, 10, 30}, "undo after eviction");
+}
+
+void CheckPackedRecord() {
+  using Record = Blob::_Memento;
+  constexpr std::size_t Size = 0x10000;
+  const Blob blob{"a", Pattern(Size, 3)};
+  const Record record(blob);
+  Check(!record.compacted(), "records start uncompressed");
+  Check(record == blob, "uncompressed record matches");
+  const std::size_t raw = record.memoryUsage();
+
+  auto usage = std::make_shared<std::atomic<std::size_t>>(raw);
+  record.compact(usage);
+  record.waitCompacted();
+  Check(record.compacted(), "compacted");
+  Check(record.memoryUsage() < Size / 4,
+        "compressed size " + std::to_string(record.memoryUsage()));
+  Check(*usage == record.memoryUsage(),
+        "usage lowered by the bytes saved: " + std::to_string(*usage));
+
+  Check(record == blob, "compressed record matches");
+  Blob other = blob;
+  other.data[Size / 2] ^= 1;
+  Check(!(record == other), "one byte of the array differs");
+  other = blob;
+  other.name = "b";
+  Check(!(record == other), "a field other than the array differs");
+  other = blob;
+  other.data.pop_back();
+  Check(!(record == other), "array size differs");
+
+  Blob restored{"x", {1, 2, 3}};
+  record.restore(restored);
+  Check(restored == blob, "restore expands the array");
+  Check(record == blob, "still matches after restore");
+
+  // Compacting twice does nothing
+  record.compact(usage);
+  record.waitCompacted();
+  Check(*usage == record.memoryUsage(), "second compact is a no-op");
+
+  // Small arrays stay as they are
+  const Blob small{"s", Pattern(64, 3)};
+  const Record small_record(small);
+  auto small_usage = std::make_shared<std::atomic<std::size_t>>(0);
+  small_record.compact(small_usage);
+  small_record.waitCompacted();
+  Check(!small_record.compacted(), "small arrays are not compressed");
+}
+
+void CheckPackedHistory() {
+  using Record = Blob::_Memento;
+  constexpr std::size_t Size = 0x20000;
+  Doc doc;
+  kpi::History history;
+  auto& blob = doc.getBlobs().add();
+  blob.name = "tex";
+  blob.data = Pattern(Size, 5);
+  const Blob v0 = blob;
+  history.commit(doc);
+  const auto v0_record = std::static_pointer_cast<const Record>(
+      doc.getBlobs().objectAt(0)->mRecord);
+
+  doc.getBlobs()[0].data = Pattern(Size, 7);
+  const Blob v1 = doc.getBlobs()[0];
+  history.commit(doc);
+  v0_record->waitCompacted();
+  Check(v0_record->compacted(), "superseded record compressed");
+  Check(history.memoryUsage() == v0_record->memoryUsage(),
+        "usage falls to the compressed size: " +
+            std::to_string(history.memoryUsage()));
+
+  history.undo(doc);
+  Check(doc.getBlobs()[0] == v0, "undo expands the old array");
+  history.redo(doc);
+  Check(doc.getBlobs()[0] == v1, "redo restores the new array");
+
+  // Back to v0's contents: the compressed record compares equal, so it is
+  // not superseded again
+  doc.getBlobs()[0] = v0;
+  history.commit(doc);
+  history.undo(doc);
+  history.undo(doc);
+  Check(doc.getBlobs()[0] == v0, "undo twice");
+}
+
+} // namespace
+
+int main() {
+  CheckAccounting();
+  CheckPackedRecord();
+  CheckPackedHistory();
+
+  if (failures != 0) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("All history checks passed\n");
+  return 0;
+}
@@ -0,0 +1,388 @@
+// Test for building and writing KCL collision
+//
+// kcol
+//
+// Builds collision from a random triangle soup with BuildKCollisionData,
+// writes it with WriteKCollisionData and reads it back with
+// ReadKCollisionData. Checks that every triangle comes back from its prism,
+// and that the leaf of the octree holding each point on, above or just below
+// a triangle lists that triangle's prism. Ray casts and sphere overlaps
+// through KCollisionOctree are compared with a scan over every prism.
+// Returns nonzero on any mismatch.
+
+#include <librii/kcol/Builder.hpp>
+#include <librii/kcol/Model.hpp>
+#include <librii/kcol/Octree.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace riistudio {
+const char* translateString(std::string_view str) { return str.data(); }
+} // namespace riistudio
+
+namespace llvm {
+int DisableABIBreakingChecks;
+} // namespace llvm
+
+// Normally from core/util/timestamp.cpp
+extern const char GIT_TAG[] = "test";
+
+using namespace librii::kcol;
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const std::string& what) {
+  if (!ok) {
+    fprintf(stderr, "FAIL: %s\n", what.c_str());
+    ++failures;
+  }
+}
+
+// Rolling terrain, plus walls and floating triangles at random angles
+std::vector<KCollisionTriangle> RandomSoup(std::mt19937& rng) {
+  std::uniform_real_distribution<float> height(-300.0f, 300.0f);
+  std::uniform_real_distribution<float> pos(-4000.0f, 4000.0f);
+  std::uniform_real_distribution<float> offset(-400.0f, 400.0f);
+  std::uniform_int_distribution<int> attribute(0, 0xffff);
+  std::vector<KCollisionTriangle> tris;
+
+  constexpr int Grid = 16;
+  constexpr float Cell = 500.0f;
+  std::vector<float> heights((Grid + 1) * (Grid + 1));
+  for (auto& h : heights)
+    h = height(rng);
+  auto vertex = [&](int x, int z) {
+    return glm::vec3((x - Grid / 2) * Cell, heights[z * (Grid + 1) + x],
+                     (z - Grid / 2) * Cell);
+  };
+  for (int z = 0; z < Grid; ++z) {
+    for (int x = 0; x < Grid; ++x) {
+      const u16 attr = static_cast<u16>(attribute(rng));
+      // Counter-clockwise seen from above, so the faces point up
+      tris.push_back(
+          {{vertex(x, z), vertex(x, z + 1), vertex(x + 1, z)}, attr});
+      tris.push_back(
+          {{vertex(x + 1, z), vertex(x, z + 1), vertex(x + 1, z + 1)}, attr});
+    }
+  }
+
+  for (int i = 0; i < 300; ++i) {
+    const glm::vec3 center(pos(rng), pos(rng) * 0.25f, pos(rng));
+    KCollisionTriangle tri{.attribute = static_cast<u16>(attribute(rng))};
+    for (auto& v : tri.verts)
+      v = center + glm::vec3(offset(rng), offset(rng), offset(rng));
+    tris.push_back(tri);
+  }
+  return tris;
+}
+
+float MaxError(const std::array<glm::vec3, 3>& a,
+               const std::array<glm::vec3, 3>& b) {
+  float error = 0.0f;
+  for (int i = 0; i < 3; ++i) {
+    const glm::vec3 d = glm::abs(a[i] - b[i]);
+    error = std::max({error, d.x, d.y, d.z});
+  }
+  return error;
+}
+
+// Write, then read back with the existing reader
+KCollisionData RoundTrip(const KCollisionData& built) {
+  const auto file = WriteKCollisionData(built);
+  KCollisionData read;
+  const auto err =
+      ReadKCollisionData(read, file, static_cast<u32>(file.size()));
+  Check(err.empty(), "ReadKCollisionData: " + err);
+
+  Check(read.pos_data == built.pos_data, "positions round-trip");
+  Check(read.nrm_data == built.nrm_data, "normals round-trip");
+  Check(read.block_data == built.block_data, "octree round-trips");
+  Check(read.prism_thickness == built.prism_thickness &&
+            read.sphere_radius == built.sphere_radius &&
+            read.area_min_pos == built.area_min_pos &&
+            read.area_x_width_mask == built.area_x_width_mask &&
+            read.area_y_width_mask == built.area_y_width_mask &&
+            read.area_z_width_mask == built.area_z_width_mask &&
+            read.block_width_shift == built.block_width_shift &&
+            read.area_x_blocks_shift == built.area_x_blocks_shift &&
+            read.area_xy_blocks_shift == built.area_xy_blocks_shift,
+        "header round-trips");
+  return read;
+}
+
+void CheckPrisms(const KCollisionData& data,
+                 const std::vector<KCollisionTriangle>& tris) {
+  Check(data.prism_data.size() == tris.size(), "one prism per triangle");
+  if (data.prism_data.size() != tris.size())
+    return;
+
+  const auto bulk = FromPrisms(data, 4);
+  int bad_verts = 0, bad_attrs = 0, bad_bulk = 0;
+  for (size_t i = 0; i < tris.size(); ++i) {
+    const auto verts = FromPrism(data, data.prism_data[i]);
+    // Positions are up to a few thousand units from the origin
+    bad_verts += MaxError(verts, tris[i].verts) > 0.05f;
+    bad_attrs += data.prism_data[i].attribute != tris[i].attribute;
+    bad_bulk += MaxError(bulk[i], verts) != 0.0f;
+  }
+  Check(bad_verts == 0,
+        std::to_string(bad_verts) + " triangle(s) differ from their prism");
+  Check(bad_attrs == 0, std::to_string(bad_attrs) + " attribute(s) differ");
+  Check(bad_bulk == 0,
+        std::to_string(bad_bulk) + " FromPrisms result(s) differ");
+}
+
+void CheckLeafCoverage(const KCollisionData& data,
+                       const KCollisionOctree& octree,
+                       const std::vector<KCollisionTriangle>& tris,
+                       std::mt19937& rng) {
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  int missing = 0, samples = 0;
+  for (u32 i = 0; i < tris.size(); ++i) {
+    const auto& [a, b, c] = tris[i].verts;
+    const glm::vec3 n = glm::normalize(glm::cross(b - a, c - a));
+    for (int s = 0; s < 16; ++s) {
+      float u = unit(rng), v = unit(rng);
+      if (u + v > 1.0f) {
+        u = 1.0f - u;
+        v = 1.0f - v;
+      }
+      const glm::vec3 on_face = a + (b - a) * u + (c - a) * v;
+      // Up to the sphere radius above, or inside the prism below
+      const float h = (unit(rng) * 1.9f - 0.95f) *
+                      (s % 2 ? data.sphere_radius : data.prism_thickness);
+      const glm::vec3 p = on_face + n * (s % 2 ? std::abs(h) : -std::abs(h));
+      const auto leaf = octree.prismsAt(p);
+      missing += std::find(leaf.begin(), leaf.end(), i) == leaf.end();
+      ++samples;
+    }
+  }
+  Check(missing == 0, std::to_string(missing) + " of " +
+                          std::to_string(samples) +
+                          " point(s) near a triangle miss it in their leaf");
+}
+
+// The octree's one-sided ray test, over every prism
+std::optional<KclRayHit> BruteForceRay(const KCollisionData& data,
+                                       const KclRay& ray) {
+  std::optional<KclRayHit> best;
+  for (u32 i = 0; i < data.prism_data.size(); ++i) {
+    const auto& prism = data.prism_data[i];
+    const auto verts = FromPrism(data, prism);
+    const glm::vec3 fnrm = data.nrm_data[prism.fnrm_i];
+    if (glm::dot(ray.direction, fnrm) >= 0.0f)
+      continue;
+    const glm::vec3 e1 = verts[1] - verts[0];
+    const glm::vec3 e2 = verts[2] - verts[0];
+    const glm::vec3 p = glm::cross(ray.direction, e2);
+    const float det = glm::dot(e1, p);
+    if (std::abs(det) < 1e-12f)
+      continue;
+    const glm::vec3 s = ray.origin - verts[0];
+    const float u = glm::dot(s, p) / det;
+    const glm::vec3 q = glm::cross(s, e1);
+    const float v = glm::dot(ray.direction, q) / det;
+    if (u < 0.0f || u > 1.0f || v < 0.0f || u + v > 1.0f)
+      continue;
+    const float t = glm::dot(e2, q) / det;
+    if (t < 0.0f || t > ray.max_distance || (best && best->distance <= t))
+      continue;
+    best = KclRayHit{.distance = t, .prism = i, .attribute = prism.attribute};
+  }
+  return best;
+}
+
+void CheckRays(const KCollisionData& data, const KCollisionOctree& octree,
+               std::mt19937& rng) {
+  std::uniform_real_distribution<float> pos(-4500.0f, 4500.0f);
+  std::normal_distribution<float> dir;
+  std::uniform_real_distribution<float> reach(100.0f, 3000.0f);
+  std::vector<KclRay> rays(3000);
+  for (size_t i = 0; i < rays.size(); ++i) {
+    auto& ray = rays[i];
+    ray.origin = glm::vec3(pos(rng), pos(rng) * 0.25f, pos(rng));
+    // A third straight down, as the game mostly casts
+    const glm::vec3 random_dir(dir(rng), dir(rng), dir(rng));
+    ray.direction = i % 3 == 0 ? glm::vec3(0.0f, -1.0f, 0.0f)
+                               : glm::normalize(random_dir);
+    if (i % 4 == 0)
+      ray.max_distance = reach(rng);
+  }
+
+  const auto batch = octree.rayCastBatch(rays, 4);
+  int mismatches = 0, hits = 0, batch_mismatches = 0;
+  for (size_t i = 0; i < rays.size(); ++i) {
+    const auto expected = BruteForceRay(data, rays[i]);
+    const auto hit = octree.rayCast(rays[i]);
+    // Ties between prisms sharing an edge may resolve either way
+    const bool ok =
+        hit.has_value() == expected.has_value() &&
+        (!hit ||
+         (std::abs(hit->distance - expected->distance) <= 1e-3f &&
+          hit->attribute == data.prism_data[hit->prism].attribute));
+    mismatches += !ok;
+    hits += expected.has_value();
+    batch_mismatches +=
+        batch[i].has_value() != hit.has_value() ||
+        (hit && (batch[i]->prism != hit->prism ||
+                 batch[i]->distance != hit->distance));
+  }
+  Check(hits > 500, "enough rays hit something");
+  Check(mismatches == 0, std::to_string(mismatches) + " of " +
+                             std::to_string(rays.size()) +
+                             " ray cast(s) differ from a scan");
+  Check(batch_mismatches == 0, "rayCastBatch matches rayCast");
+}
+
+glm::vec3 ClosestOnSegment(const glm::vec3& p, const glm::vec3& a,
+                           const glm::vec3& b) {
+  const glm::vec3 ab = b - a;
+  const float t =
+      std::clamp(glm::dot(p - a, ab) / glm::dot(ab, ab), 0.0f, 1.0f);
+  return a + ab * t;
+}
+
+// The game's sphere test as KCollisionOctree documents it, over every prism
+std::vector<KclSphereHit> BruteForceSphere(const KCollisionData& data,
+                                           const glm::vec3& center,
+                                           float radius) {
+  std::vector<KclSphereHit> out;
+  for (u32 i = 0; i < data.prism_data.size(); ++i) {
+    const auto& prism = data.prism_data[i];
+    const auto verts = FromPrism(data, prism);
+    const glm::vec3 rel = center - verts[0];
+    const float d1 = glm::dot(rel, data.nrm_data[prism.enrm1_i]);
+    const float d2 = glm::dot(rel, data.nrm_data[prism.enrm2_i]);
+    const float d3 = glm::dot(rel, data.nrm_data[prism.enrm3_i]) - prism.height;
+    if (d1 >= radius || d2 >= radius || d3 >= radius)
+      continue;
+    const glm::vec3 fnrm = data.nrm_data[prism.fnrm_i];
+    const float depth = radius - glm::dot(rel, fnrm);
+    if (depth <= 0.0f || depth > data.prism_thickness)
+      continue;
+    if (d1 <= 0.0f && d2 <= 0.0f && d3 <= 0.0f) {
+      out.push_back({.prism = i, .attribute = prism.attribute, .depth = depth});
+      continue;
+    }
+    float dist = std::numeric_limits<float>::infinity();
+    for (int e = 0; e < 3; ++e) {
+      const glm::vec3 closest =
+          ClosestOnSegment(center, verts[e], verts[(e + 1) % 3]);
+      dist = std::min(dist, glm::length(center - closest));
+    }
+    if (dist < radius)
+      out.push_back(
+          {.prism = i, .attribute = prism.attribute, .depth = radius - dist});
+  }
+  return out;
+}
+
+void CheckSpheres(const KCollisionData& data, const KCollisionOctree& octree,
+                  const std::vector<KCollisionTriangle>& tris,
+                  std::mt19937& rng) {
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::uniform_int_distribution<size_t> pick(0, tris.size() - 1);
+  int mismatches = 0, overlaps = 0, spheres = 0;
+  std::vector<KclSphereHit> hits;
+  for (int n = 0; n < 3000; ++n) {
+    // Near a random triangle, often past its edges
+    const auto& [a, b, c] = tris[pick(rng)].verts;
+    const glm::vec3 normal = glm::normalize(glm::cross(b - a, c - a));
+    const float u = unit(rng) * 1.4f - 0.2f, v = unit(rng) * 1.4f - 0.2f;
+    const glm::vec3 center = a + (b - a) * u + (c - a) * v +
+                             normal * (unit(rng) * 400.0f - 100.0f);
+    // Within sphere_radius the leaf of the center is enough; larger spheres
+    // gather several leaves
+    const float radius =
+        n % 4 == 0 ? data.sphere_radius + 200.0f : 20.0f + unit(rng) * 230.0f;
+
+    octree.sphereOverlap(center, radius, hits);
+    auto expected = BruteForceSphere(data, center, radius);
+    auto by_prism = [](const KclSphereHit& l, const KclSphereHit& r) {
+      return l.prism < r.prism;
+    };
+    std::sort(hits.begin(), hits.end(), by_prism);
+    std::sort(expected.begin(), expected.end(), by_prism);
+    bool ok = hits.size() == expected.size();
+    for (size_t i = 0; ok && i < hits.size(); ++i) {
+      ok = hits[i].prism == expected[i].prism &&
+           hits[i].attribute == expected[i].attribute &&
+           std::abs(hits[i].depth - expected[i].depth) <= 1e-2f;
+    }
+    mismatches += !ok;
+    overlaps += !expected.empty();
+    ++spheres;
+  }
+  Check(overlaps > 500, "enough spheres overlap something");
+  Check(mismatches == 0, std::to_string(mismatches) + " of " +
+                             std::to_string(spheres) +
+                             " sphere overlap(s) differ from a scan");
+}
+
+void TestSoup() {
+  std::mt19937 rng(0);
+  const auto tris = RandomSoup(rng);
+
+  KCollisionData built;
+  const auto err = BuildKCollisionData(built, tris, {.num_threads = 4});
+  Check(err.empty(), "BuildKCollisionData: " + err);
+  if (!err.empty())
+    return;
+
+  const auto read = RoundTrip(built);
+  CheckPrisms(read, tris);
+
+  KCollisionOctree octree;
+  const auto decode_err = octree.decode(read);
+  Check(decode_err.empty(), "KCollisionOctree::decode: " + decode_err);
+  if (decode_err.empty()) {
+    CheckLeafCoverage(read, octree, tris, rng);
+    CheckRays(read, octree, rng);
+    CheckSpheres(read, octree, tris, rng);
+  }
+
+  // The octree does not depend on the thread count
+  KCollisionData serial;
+  BuildKCollisionData(serial, tris, {.num_threads = 1});
+  Check(serial.block_data == built.block_data,
+        "octree is the same on one thread");
+}
+
+void TestDegenerate() {
+  const std::vector<KCollisionTriangle> tris{
+      {{glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f)}},
+      {{glm::vec3(0.0f), glm::vec3(1.0f), glm::vec3(2.0f)}},
+      {{glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 100.0f),
+        glm::vec3(100.0f, 0.0f, 0.0f)},
+       7},
+  };
+  KCollisionData built;
+  const auto err = BuildKCollisionData(built, tris);
+  Check(err.empty(), "BuildKCollisionData (degenerate): " + err);
+  const auto read = RoundTrip(built);
+  Check(read.prism_data.size() == 1 && read.prism_data[0].attribute == 7,
+        "degenerate triangles are dropped");
+}
+
+} // namespace
+
+int main() {
+  TestSoup();
+  TestDegenerate();
+
+  if (failures != 0) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("All KCL checks passed\n");
+  return 0;
+}
@@ -0,0 +1,150 @@
+// Round-trip test for the Yaz0 encoders
+//
+// szs
+//
+// Compresses fixed inputs with every Algo, through both encode() and
+// encodeParallel(), decodes the result and compares it with the input. The
+// inputs cover the empty and single-byte cases, an odd size just past one
+// 0x1000 window, more than 1 MiB of mixed data spanning several parallel
+// regions, and long runs straddling a region boundary. encodeParallel() must
+// also produce the same bytes on 1, 4 and 7 threads. Returns nonzero on any
+// mismatch.
+
+#include <librii/szs/SZS.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace riistudio {
+const char* translateString(std::string_view str) { return str.data(); }
+} // namespace riistudio
+
+namespace llvm {
+int DisableABIBreakingChecks;
+} // namespace llvm
+
+using librii::szs::Algo;
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const std::string& what) {
+  if (!ok) {
+    fprintf(stderr, "FAIL: %s\n", what.c_str());
+    ++failures;
+  }
+}
+
+struct Input {
+  std::string name;
+  std::vector<u8> data;
+};
+
+// Words from a small vocabulary with random bytes mixed in: matches of every
+// length and distance, and literals between them
+std::vector<u8> MixedData(std::size_t size, std::mt19937& rng) {
+  std::vector<std::vector<u8>> words(64);
+  for (auto& word : words) {
+    word.resize(3 + rng() % 20);
+    for (auto& c : word)
+      c = 'a' + rng() % 26;
+  }
+  std::vector<u8> data;
+  data.reserve(size);
+  while (data.size() < size) {
+    if (rng() % 4 == 0) {
+      data.push_back(rng());
+    } else {
+      const auto& word = words[rng() % words.size()];
+      data.insert(data.end(), word.begin(), word.end());
+    }
+  }
+  data.resize(size);
+  return data;
+}
+
+// Runs far longer than the longest match (0x111), one of them across the
+// boundary between the first two parallel regions
+std::vector<u8> RunData(std::mt19937& rng) {
+  std::vector<u8> data;
+  while (data.size() < 0x3f000)
+    data.insert(data.end(), 1 + rng() % 0x400, rng() % 4);
+  data.insert(data.end(), 0x2000, 0xaa);
+  while (data.size() < 0x50003)
+    data.insert(data.end(), 1 + rng() % 0x400, rng() % 4);
+  return data;
+}
+
+std::vector<Input> Inputs() {
+  std::mt19937 rng(0);
+  return {
+      {"empty", {}},
+      {"1 byte", {0x42}},
+      {"0x1011 bytes", MixedData(0x1011, rng)},
+      {"1 MiB + 0x35 bytes", MixedData((1 << 20) + 0x35, rng)},
+      {"runs", RunData(rng)},
+  };
+}
+
+constexpr std::array<std::pair<Algo, const char*>, 4> Algos{{
+    {Algo::Stored, "Stored"},
+    {Algo::Greedy, "Greedy"},
+    {Algo::Lazy, "Lazy"},
+    {Algo::Optimal, "Optimal"},
+}};
+
+void CheckRoundTrip(const std::string& what, const std::vector<u8>& src,
+                    const std::vector<u8>& szs) {
+  if (librii::szs::getExpandedSize(szs) != src.size()) {
+    Check(false, what + ": expanded size " +
+                     std::to_string(librii::szs::getExpandedSize(szs)));
+    return;
+  }
+  std::vector<u8> dst(src.size());
+  if (auto err = librii::szs::decode(dst, szs)) {
+    Check(false, what + ": " + llvm::toString(std::move(err)));
+    return;
+  }
+  const auto mismatch = std::mismatch(dst.begin(), dst.end(), src.begin());
+  Check(mismatch.first == dst.end(),
+        what + ": first difference at byte " +
+            std::to_string(mismatch.first - dst.begin()));
+}
+
+// The output may depend only on the input and the algorithm
+void CheckThreadCounts(const std::string& what, const std::vector<u8>& src,
+                       Algo algo) {
+  const auto serial = librii::szs::encodeParallel(src, algo, 1);
+  for (u32 num_threads : {4u, 7u}) {
+    Check(librii::szs::encodeParallel(src, algo, num_threads) == serial,
+          "encodeParallel " + what + ": " + std::to_string(num_threads) +
+              " threads differ from 1");
+  }
+}
+
+} // namespace
+
+int main() {
+  for (const auto& input : Inputs()) {
+    for (const auto& [algo, algo_name] : Algos) {
+      const auto what = std::string(algo_name) + ", " + input.name;
+      CheckRoundTrip("encode " + what, input.data,
+                     librii::szs::encode(input.data, algo));
+      CheckRoundTrip("encodeParallel " + what, input.data,
+                     librii::szs::encodeParallel(input.data, algo, 4));
+      CheckThreadCounts(what, input.data, algo);
+    }
+  }
+
+  if (failures != 0) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("All SZS round trips passed\n");
+  return 0;
+}
@@ -0,0 +1,94 @@
+// Yaz0 decoder benchmark and corruption harness
+//
+// szs_bench <file...>
+//
+// .szs inputs are decoded directly; anything else is compressed first. Each
+// input is then decoded repeatedly to measure throughput, and decoded again
+// after random truncations/bit flips, which must fail cleanly rather than
+// crash. Build with ASAN=1 to catch out-of-bounds accesses.
+
+#include <librii/szs/SZS.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace riistudio {
+const char* translateString(std::string_view str) { return str.data(); }
+} // namespace riistudio
+
+namespace llvm {
+int DisableABIBreakingChecks;
+} // namespace llvm
+
+static std::vector<u8> readFile(const char* path) {
+  std::ifstream file(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file),
+          std::istreambuf_iterator<char>()};
+}
+
+static double benchDecode(std::span<const u8> szs) {
+  std::vector<u8> dst(librii::szs::getExpandedSize(szs));
+
+  constexpr int Iterations = 20;
+  const auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < Iterations; ++i) {
+    if (auto err = librii::szs::decode(dst, szs)) {
+      fprintf(stderr, "  decode failed: %s\n",
+              llvm::toString(std::move(err)).c_str());
+      return 0.0;
+    }
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - begin;
+  return static_cast<double>(dst.size()) * Iterations / elapsed.count() /
+         (1024.0 * 1024.0);
+}
+
+// Returns the number of corrupted inputs that decoded without error
+static int fuzzDecode(std::span<const u8> szs, std::mt19937& rng) {
+  constexpr int Trials = 200;
+  int accepted = 0;
+  std::vector<u8> dst(librii::szs::getExpandedSize(szs));
+  for (int i = 0; i < Trials; ++i) {
+    std::vector<u8> bad(szs.begin(), szs.end());
+    if (i % 2 == 0) {
+      bad.resize(rng() % bad.size());
+    } else {
+      for (int j = 0; j < 8; ++j)
+        bad[16 + rng() % (bad.size() - 16)] ^= 1 << (rng() % 8);
+    }
+    if (auto err = librii::szs::decode(dst, bad))
+      llvm::consumeError(std::move(err));
+    else
+      ++accepted;
+  }
+  return accepted;
+}
+
+int main(int argc, const char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Error: Too few arguments:\nszs_bench <file...>\n");
+    return 1;
+  }
+
+  std::mt19937 rng(0);
+  for (int i = 1; i < argc; ++i) {
+    auto file = readFile(argv[i]);
+    if (file.empty()) {
+      fprintf(stderr, "Cannot read %s\n", argv[i]);
+      continue;
+    }
+    if (librii::szs::getExpandedSize(file) == 0)
+      file = librii::szs::encode(file);
+    if (file.size() <= 16)
+      continue;
+
+    printf("%s\n", argv[i]);
+    printf("  decode: %.1f MB/s\n", benchDecode(file));
+    printf("  corrupted inputs accepted: %d\n", fuzzDecode(file, rng));
+  }
+}
@@ -0,0 +1,145 @@
+// Test for the U8 archive path index
+//
+// u8_index
+//
+// Builds a small archive, round-trips it through SaveU8Archive and
+// LoadU8Archive, and checks path lookup, folder child ranges, node paths and
+// file contents against the known layout. Also checks that a folder whose
+// sibling_next points past its parent is clamped. Returns nonzero on any
+// mismatch.
+
+#include <librii/u8/U8.hpp>
+
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace riistudio {
+const char* translateString(std::string_view str) { return str.data(); }
+} // namespace riistudio
+
+namespace llvm {
+int DisableABIBreakingChecks;
+} // namespace llvm
+
+using librii::U8::U8Archive;
+using librii::U8::U8PathIndex;
+
+namespace {
+
+int failures = 0;
+
+void Check(bool ok, const char* what) {
+  if (!ok) {
+    fprintf(stderr, "FAIL: %s\n", what);
+    ++failures;
+  }
+}
+
+U8Archive::Node Folder(std::string name, u32 parent, u32 sibling_next) {
+  U8Archive::Node node{.is_folder = true, .name = std::move(name)};
+  node.folder.parent = parent;
+  node.folder.sibling_next = sibling_next;
+  return node;
+}
+U8Archive::Node File(std::string name, u32 offset, u32 size) {
+  U8Archive::Node node{.is_folder = false, .name = std::move(name)};
+  node.file.offset = offset;
+  node.file.size = size;
+  return node;
+}
+
+// 0 <root>
+// 1   .
+// 2     course_model.brres
+// 3     dir
+// 4       a.bin
+// 5       sub
+// 6         b.bin
+// 7     z.bin
+U8Archive MakeArchive() {
+  U8Archive arc{};
+  arc.nodes = {
+      Folder("", 0, 8),
+      Folder(".", 0, 8),
+      File("course_model.brres", 0, 3),
+      Folder("dir", 1, 7),
+      File("a.bin", 3, 2),
+      Folder("sub", 3, 7),
+      File("b.bin", 5, 1),
+      File("z.bin", 6, 4),
+  };
+  arc.file_data = {'b', 'r', 's', 'a', 'a', 'b', 'z', 'z', 'z', 'z'};
+  return arc;
+}
+
+bool Children(const U8PathIndex& index, u32 folder, std::vector<u32> expected) {
+  const auto children = index.children(folder);
+  return std::vector<u32>(children.begin(), children.end()) == expected;
+}
+
+void CheckLookup() {
+  U8Archive arc;
+  Check(librii::U8::LoadU8Archive(arc,
+                                  librii::U8::SaveU8Archive(MakeArchive())),
+        "archive round-trips");
+  Check(arc.nodes.size() == 8, "node count");
+  if (arc.nodes.size() != 8)
+    return;
+  const U8PathIndex index(arc);
+
+  Check(index.find("") == 0u, "empty path is the root");
+  Check(index.find(".") == 0u, "\".\" is the root");
+  Check(index.find("./course_model.brres") == 2u, "leading \"./\"");
+  Check(index.find("course_model.brres") == 2u, "without \"./\"");
+  Check(index.find("dir") == 3u, "folder");
+  Check(index.find("dir//sub/") == 5u, "empty components");
+  Check(index.find(".\\dir\\a.bin") == 4u, "backslashes");
+  Check(index.find("dir/sub/b.bin") == 6u, "nested file");
+  Check(index.find("./z.bin") == 7u, "file after a folder");
+  Check(!index.find("b.bin").has_value(), "file in the wrong folder");
+  Check(!index.find("dir/missing").has_value(), "missing file");
+  Check(!index.find("course_model.brres/x").has_value(), "path under a file");
+
+  Check(Children(index, 0, {1}), "children of the root");
+  Check(Children(index, 1, {2, 3, 7}), "children of \".\"");
+  Check(Children(index, 3, {4, 5}), "children of dir");
+  Check(Children(index, 5, {6}), "children of dir/sub");
+  Check(Children(index, 2, {}), "files have no children");
+
+  Check(index.path(1).empty(), "\".\" has an empty path");
+  Check(index.path(6) == "dir/sub/b.bin", "path of a nested file");
+
+  const auto b = librii::U8::GetFileData(arc, 6);
+  Check(b.size() == 1 && b[0] == 'b', "contents of dir/sub/b.bin");
+  const auto z = librii::U8::GetFileData(arc, 7);
+  Check(std::string(z.begin(), z.end()) == "zzzz", "contents of z.bin");
+}
+
+void CheckMalformed() {
+  auto arc = MakeArchive();
+  // Past the end of ".": clamped, so z.bin lands in dir
+  arc.nodes[3].folder.sibling_next = 100;
+  const U8PathIndex index(arc);
+
+  Check(Children(index, 1, {2, 3}), "clamped: children of \".\"");
+  Check(Children(index, 3, {4, 5, 7}), "clamped: children of dir");
+  Check(index.find("dir/z.bin") == 7u, "clamped: z.bin in dir");
+}
+
+} // namespace
+
+int main() {
+  CheckLookup();
+  CheckMalformed();
+
+  if (failures != 0) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("All U8 index checks passed\n");
+  return 0;
+}